@@ -0,0 +1,208 @@
+#include "AudioAnalysis.h"
+#include "SampleBuffer.h"
+#include "ThreadPool.h"
+#include "PeakPyramid.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// BS.1770 measures 400 ms blocks overlapping by 75%, i.e. four 100 ms steps
+static const size_t kStepsPerBlock = 4;
+static const double kAbsoluteGate = -70.0;
+static const double kRelativeGate = -10.0;
+
+// Second-order IIR section, transposed direct form II
+struct Biquad
+{
+    double b0, b1, b2, a1, a2;
+    double z1 = 0.0, z2 = 0.0;
+
+    double Process(double x)
+    {
+        double y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        return y;
+    }
+};
+
+// K-weighting: head-related high shelf followed by the RLB high-pass, designed for any sample rate
+struct KWeighting
+{
+    Biquad shelf;
+    Biquad highPass;
+
+    explicit KWeighting(uint32_t sampleRate)
+    {
+        const double pi = 3.14159265358979323846;
+
+        double k = std::tan(pi * 1681.974450955533 / sampleRate);
+        double q = 0.7071752369554196;
+        double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+        double vb = std::pow(vh, 0.4996667741545416);
+        double a0 = 1.0 + k / q + k * k;
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+        k = std::tan(pi * 38.13547087602444 / sampleRate);
+        q = 0.5003270373238773;
+        a0 = 1.0 + k / q + k * k;
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    double Process(double x) { return highPass.Process(shelf.Process(x)); }
+};
+
+// BS.1770 channel weights. Without a speaker mask, 5 and 6 channels are taken as
+// L R C Ls Rs and L R C LFE Ls Rs; the LFE is not measured and surrounds count +1.5 dB.
+static double ChannelWeight(uint16_t channel, uint16_t numChannels)
+{
+    if (numChannels == 6)
+    {
+        static const double weights[6] = { 1.0, 1.0, 1.0, 0.0, 1.41, 1.41 };
+        return weights[channel];
+    }
+    if (numChannels == 5)
+    {
+        return channel >= 3 ? 1.41 : 1.0;
+    }
+    return 1.0;
+}
+
+static double EnergyToLoudness(double energy)
+{
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+std::shared_ptr<AudioAnalysis> AudioAnalysis::Analyze(const SampleBuffer& buffer, std::shared_ptr<const PeakPyramid> peaks)
+{
+    auto analysis = std::make_shared<AudioAnalysis>();
+    const uint32_t numFrames = buffer.GetNumFrames();
+    const uint16_t channels = buffer.GetNumChannels();
+    if (numFrames == 0 || channels == 0 || buffer.GetSampleRate() == 0)
+    {
+        return analysis;
+    }
+
+    // Per channel: peak, sum of squares and K-weighted energy of every 100 ms step
+    struct ChannelResult
+    {
+        float peak = 0.0f;
+        double sumSquares = 0.0;
+        std::vector<double> stepEnergy;
+    };
+
+    const uint32_t stepFrames = std::max(1u, buffer.GetSampleRate() / 10);
+    const size_t numSteps = numFrames / stepFrames;
+    std::vector<ChannelResult> results(channels);
+
+    ThreadPool::GetShared().ParallelFor(channels, [&](size_t channel)
+    {
+        ChannelResult& result = results[channel];
+        result.stepEnergy.assign(numSteps, 0.0);
+        KWeighting filter(buffer.GetSampleRate());
+        size_t step = 0;
+        uint32_t stepFill = 0;
+
+        buffer.VisitChannel(static_cast<uint16_t>(channel), 0, numFrames, [&](const float* samples, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                float x = samples[i];
+                result.peak = std::max(result.peak, std::abs(x));
+                result.sumSquares += static_cast<double>(x) * x;
+
+                double y = filter.Process(x);
+                if (step < numSteps)
+                {
+                    result.stepEnergy[step] += y * y;
+                    if (++stepFill == stepFrames)
+                    {
+                        ++step;
+                        stepFill = 0;
+                    }
+                }
+            }
+        });
+    });
+
+    double sumSquares = 0.0;
+    for (const ChannelResult& result : results)
+    {
+        analysis->peak = std::max(analysis->peak, result.peak);
+        sumSquares += result.sumSquares;
+    }
+    analysis->rms = static_cast<float>(std::sqrt(sumSquares / buffer.GetNumSamples()));
+
+    // Gated integrated loudness over 400 ms blocks
+    if (numSteps >= kStepsPerBlock)
+    {
+        std::vector<double> stepTotal(numSteps, 0.0);
+        for (uint16_t ch = 0; ch < channels; ++ch)
+        {
+            double weight = ChannelWeight(ch, channels);
+            for (size_t i = 0; i < numSteps; ++i)
+            {
+                stepTotal[i] += weight * results[ch].stepEnergy[i];
+            }
+        }
+
+        std::vector<double> blockEnergy;
+        blockEnergy.reserve(numSteps - kStepsPerBlock + 1);
+        for (size_t i = 0; i + kStepsPerBlock <= numSteps; ++i)
+        {
+            double energy = 0.0;
+            for (size_t j = 0; j < kStepsPerBlock; ++j)
+            {
+                energy += stepTotal[i + j];
+            }
+            energy /= static_cast<double>(kStepsPerBlock) * stepFrames;
+            if (energy > 0.0 && EnergyToLoudness(energy) > kAbsoluteGate)
+            {
+                blockEnergy.push_back(energy);
+            }
+        }
+
+        if (!blockEnergy.empty())
+        {
+            double mean = 0.0;
+            for (double energy : blockEnergy)
+            {
+                mean += energy;
+            }
+            double relativeGate = EnergyToLoudness(mean / blockEnergy.size()) + kRelativeGate;
+
+            double gatedSum = 0.0;
+            size_t gatedCount = 0;
+            for (double energy : blockEnergy)
+            {
+                if (EnergyToLoudness(energy) > relativeGate)
+                {
+                    gatedSum += energy;
+                    ++gatedCount;
+                }
+            }
+            if (gatedCount > 0)
+            {
+                analysis->loudness = static_cast<float>(EnergyToLoudness(gatedSum / gatedCount));
+            }
+        }
+    }
+
+    if (peaks && peaks->IsComplete() && peaks->GetNumFrames() == numFrames && peaks->GetNumChannels() == channels)
+    {
+        analysis->peaks = std::move(peaks);
+    }
+    else
+    {
+        analysis->peaks = PeakPyramid::Build(buffer);
+    }
+    return analysis;
+}
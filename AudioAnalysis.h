@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+
+class SampleBuffer;
+class PeakPyramid;
+
+// Audio Analysis - whole-file measurements derived from a decoded SampleBuffer.
+// Computed once by the loader and attached to the buffer, so every track and player
+// sharing the samples shares the numbers too, and stored alongside them in DecodeCache.
+struct AudioAnalysis
+{
+    float peak = 0.0f;         // Largest absolute sample over all channels
+    float rms = 0.0f;          // Over all samples of all channels
+    float loudness = kSilence; // Integrated loudness in LUFS (ITU-R BS.1770 gated, K-weighted)
+
+    // Per-channel min/max/RMS at every power-of-two zoom, for waveform drawing
+    std::shared_ptr<const PeakPyramid> peaks;
+
+    // Loudness of silence or of material too short to measure
+    static constexpr float kSilence = -144.0f;
+
+    // Analyze every sample of buffer, channels in parallel on the shared ThreadPool.
+    // A complete pyramid built while the buffer was filled is adopted instead of rebuilt.
+    static std::shared_ptr<AudioAnalysis> Analyze(const SampleBuffer& buffer,
+                                                  std::shared_ptr<const PeakPyramid> peaks = nullptr);
+};
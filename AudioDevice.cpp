@@ -0,0 +1,408 @@
+#include "AudioDevice.h"
+#include <chrono>
+#include <cstdio>
+
+#ifdef EXEDAW_HAS_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+// Anything outside these is treated as a configuration mistake rather than negotiated
+static const uint32_t kMinSampleRate = 8000;
+static const uint32_t kMaxSampleRate = 384000;
+static const uint32_t kMinBufferFrames = 16;
+static const uint32_t kMaxBufferFrames = 16384;
+
+// Hardware buffer of the ALSA backend, in periods
+static const unsigned int kAlsaPeriods = 3;
+
+static void UpdateMax(std::atomic<uint64_t>& maxValue, uint64_t value)
+{
+    if (value > maxValue.load(std::memory_order_relaxed))
+    {
+        maxValue.store(value, std::memory_order_relaxed); // Single writer, no CAS needed
+    }
+}
+
+std::unique_ptr<AudioDevice> AudioDevice::Create(Backend backend, const std::string& target)
+{
+    switch (backend)
+    {
+    case BACKEND_NULL:
+        return std::make_unique<NullAudioDevice>(true);
+    case BACKEND_NULL_FREE_RUNNING:
+        return std::make_unique<NullAudioDevice>(false);
+    case BACKEND_WAV_FILE:
+        return target.empty() ? nullptr : std::make_unique<WavFileAudioDevice>(target);
+#ifdef EXEDAW_HAS_ALSA
+    case BACKEND_ALSA:
+        return std::make_unique<AlsaAudioDevice>(target.empty() ? "default" : target);
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+bool AudioDevice::IsBackendAvailable(Backend backend)
+{
+#ifndef EXEDAW_HAS_ALSA
+    if (backend == BACKEND_ALSA)
+    {
+        return false;
+    }
+#endif
+    return backend >= BACKEND_NULL && backend < BACKEND_COUNT;
+}
+
+const char* AudioDevice::GetBackendName(Backend backend)
+{
+    switch (backend)
+    {
+    case BACKEND_NULL: return "Null";
+    case BACKEND_NULL_FREE_RUNNING: return "Null (free-running)";
+    case BACKEND_WAV_FILE: return "WAV File";
+    case BACKEND_ALSA: return "ALSA";
+    default: return "Unknown";
+    }
+}
+
+AudioDevice::AudioDevice()
+    : running_(false)
+    , stopRequested_(false)
+    , buffersRendered_(0)
+    , open_(false)
+    , xruns_(0)
+    , callbackNanosTotal_(0)
+    , callbackNanosMax_(0)
+    , jitterNanosTotal_(0)
+    , jitterNanosMax_(0)
+    , jitterSamples_(0)
+{
+}
+
+AudioDevice::~AudioDevice()
+{
+}
+
+bool AudioDevice::Open(const Config& config)
+{
+    Close();
+    if (config.sampleRate < kMinSampleRate || config.sampleRate > kMaxSampleRate ||
+        config.bufferFrames < kMinBufferFrames || config.bufferFrames > kMaxBufferFrames || config.channels == 0)
+    {
+        return false;
+    }
+
+    // The backend may settle on a different rate, buffer size or channel count
+    Config negotiated = config;
+    if (!OpenDevice(negotiated))
+    {
+        printf("Audio device %s: could not open\n", GetName());
+        return false;
+    }
+    if (negotiated.sampleRate == 0 || negotiated.bufferFrames == 0 || negotiated.channels == 0)
+    {
+        CloseDevice();
+        return false;
+    }
+    config_ = negotiated;
+    buffer_.assign(static_cast<size_t>(config_.bufferFrames) * config_.channels, 0.0f);
+
+    buffersRendered_ = 0;
+    xruns_ = 0;
+    callbackNanosTotal_ = 0;
+    callbackNanosMax_ = 0;
+    jitterNanosTotal_ = 0;
+    jitterNanosMax_ = 0;
+    jitterSamples_ = 0;
+    open_ = true;
+
+    printf("Audio device %s: %u Hz, %u frames, %u channels", GetName(), config_.sampleRate,
+        config_.bufferFrames, config_.channels);
+    if (config_.sampleRate != config.sampleRate || config_.bufferFrames != config.bufferFrames ||
+        config_.channels != config.channels)
+    {
+        printf(" (asked for %u Hz, %u frames, %u channels)", config.sampleRate, config.bufferFrames, config.channels);
+    }
+    printf("\n");
+    return true;
+}
+
+bool AudioDevice::Start(RenderCallback callback)
+{
+    if (!open_ || !callback || renderThread_.joinable())
+    {
+        return false;
+    }
+
+    callback_ = std::move(callback);
+    stopRequested_ = false;
+    running_ = true;
+    renderThread_ = std::thread(&AudioDevice::RenderThreadMain, this);
+    return true;
+}
+
+void AudioDevice::Stop()
+{
+    stopRequested_ = true;
+    if (renderThread_.joinable())
+    {
+        renderThread_.join();
+    }
+    running_ = false;
+    callback_ = nullptr;
+}
+
+void AudioDevice::Close()
+{
+    Stop();
+    if (open_)
+    {
+        CloseDevice();
+        open_ = false;
+    }
+}
+
+AudioDevice::Stats AudioDevice::GetStats() const
+{
+    Stats stats;
+    stats.buffers = buffersRendered_.load(std::memory_order_relaxed);
+    stats.xruns = xruns_.load(std::memory_order_relaxed);
+    if (!open_)
+    {
+        return stats;
+    }
+
+    stats.periodMicros = config_.bufferFrames * 1e6 / config_.sampleRate;
+    const uint64_t jitterSamples = jitterSamples_.load(std::memory_order_relaxed);
+    if (stats.buffers > 0)
+    {
+        stats.meanCallbackMicros = callbackNanosTotal_.load(std::memory_order_relaxed) / 1e3 / stats.buffers;
+    }
+    if (jitterSamples > 0)
+    {
+        stats.meanJitterMicros = jitterNanosTotal_.load(std::memory_order_relaxed) / 1e3 / jitterSamples;
+    }
+    stats.maxCallbackMicros = callbackNanosMax_.load(std::memory_order_relaxed) / 1e3;
+    stats.maxJitterMicros = jitterNanosMax_.load(std::memory_order_relaxed) / 1e3;
+    stats.meanLoad = stats.meanCallbackMicros / stats.periodMicros;
+    stats.peakLoad = stats.maxCallbackMicros / stats.periodMicros;
+    stats.headroom = 1.0 - stats.peakLoad;
+    return stats;
+}
+
+void AudioDevice::RenderThreadMain()
+{
+    typedef std::chrono::steady_clock Clock;
+    const int64_t periodNanos = static_cast<int64_t>(config_.bufferFrames) * 1000000000 / config_.sampleRate;
+    Clock::time_point lastStart;
+    bool first = true;
+
+    while (!stopRequested_.load(std::memory_order_acquire))
+    {
+        const Clock::time_point start = Clock::now();
+        callback_(buffer_.data(), config_.bufferFrames);
+        const Clock::time_point rendered = Clock::now();
+
+        const uint64_t callbackNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(rendered - start).count();
+        callbackNanosTotal_.fetch_add(callbackNanos, std::memory_order_relaxed);
+        UpdateMax(callbackNanosMax_, callbackNanos);
+        if (!first)
+        {
+            const int64_t interval = std::chrono::duration_cast<std::chrono::nanoseconds>(start - lastStart).count();
+            const uint64_t jitter = static_cast<uint64_t>(interval > periodNanos ? interval - periodNanos : periodNanos - interval);
+            jitterNanosTotal_.fetch_add(jitter, std::memory_order_relaxed);
+            jitterSamples_.fetch_add(1, std::memory_order_relaxed);
+            UpdateMax(jitterNanosMax_, jitter);
+        }
+        lastStart = start;
+        first = false;
+
+        if (!Deliver(buffer_.data(), config_.bufferFrames))
+        {
+            break;
+        }
+        buffersRendered_.fetch_add(1, std::memory_order_relaxed);
+    }
+    running_.store(false, std::memory_order_release);
+}
+
+NullAudioDevice::NullAudioDevice(bool clocked)
+    : clocked_(clocked)
+{
+}
+
+NullAudioDevice::~NullAudioDevice()
+{
+    Close();
+}
+
+bool NullAudioDevice::OpenDevice(Config& config)
+{
+    (void)config;
+    nextDeadline_ = std::chrono::steady_clock::time_point();
+    return true;
+}
+
+bool NullAudioDevice::Deliver(const float* frames, uint32_t numFrames)
+{
+    (void)frames;
+    if (!clocked_)
+    {
+        return true;
+    }
+
+    // Deadlines follow an ideal clock from the first buffer, so sleep overshoot does not accumulate
+    const std::chrono::nanoseconds period(static_cast<int64_t>(numFrames) * 1000000000 / GetConfig().sampleRate);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (nextDeadline_ == std::chrono::steady_clock::time_point() || now - nextDeadline_ > period * 4)
+    {
+        nextDeadline_ = now; // First buffer, or too far behind to catch up
+    }
+    nextDeadline_ += period;
+    std::this_thread::sleep_until(nextDeadline_);
+    return true;
+}
+
+void NullAudioDevice::CloseDevice()
+{
+}
+
+WavFileAudioDevice::WavFileAudioDevice(const std::string& filePath, WavWriter::SampleFormat format)
+    : filePath_(filePath)
+    , format_(format)
+{
+}
+
+WavFileAudioDevice::~WavFileAudioDevice()
+{
+    Close();
+}
+
+bool WavFileAudioDevice::OpenDevice(Config& config)
+{
+    return writer_.Open(filePath_, config.sampleRate, config.channels, format_);
+}
+
+bool WavFileAudioDevice::Deliver(const float* frames, uint32_t numFrames)
+{
+    return writer_.Write(frames, numFrames);
+}
+
+void WavFileAudioDevice::CloseDevice()
+{
+    writer_.Close();
+}
+
+#ifdef EXEDAW_HAS_ALSA
+AlsaAudioDevice::AlsaAudioDevice(const std::string& deviceName)
+    : deviceName_(deviceName)
+    , pcm_(nullptr)
+    , format_(WavWriter::FORMAT_FLOAT32)
+{
+}
+
+AlsaAudioDevice::~AlsaAudioDevice()
+{
+    Close();
+}
+
+bool AlsaAudioDevice::OpenDevice(Config& config)
+{
+    int err = snd_pcm_open(&pcm_, deviceName_.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0)
+    {
+        printf("ALSA: could not open %s: %s\n", deviceName_.c_str(), snd_strerror(err));
+        pcm_ = nullptr;
+        return false;
+    }
+
+    snd_pcm_hw_params_t* hw = nullptr;
+    snd_pcm_hw_params_alloca(&hw);
+    snd_pcm_hw_params_any(pcm_, hw);
+
+    // Each setter takes the nearest value the hardware supports and reports it back
+    unsigned int rate = config.sampleRate;
+    unsigned int channels = config.channels;
+    snd_pcm_uframes_t period = config.bufferFrames;
+    snd_pcm_uframes_t bufferSize = period * kAlsaPeriods;
+    format_ = WavWriter::FORMAT_FLOAT32;
+    bool ok = snd_pcm_hw_params_set_access(pcm_, hw, SND_PCM_ACCESS_RW_INTERLEAVED) >= 0;
+    if (ok && snd_pcm_hw_params_set_format(pcm_, hw, SND_PCM_FORMAT_FLOAT_LE) < 0)
+    {
+        format_ = WavWriter::FORMAT_PCM16;
+        ok = snd_pcm_hw_params_set_format(pcm_, hw, SND_PCM_FORMAT_S16_LE) >= 0;
+    }
+    ok = ok && snd_pcm_hw_params_set_channels_near(pcm_, hw, &channels) >= 0;
+    ok = ok && snd_pcm_hw_params_set_rate_near(pcm_, hw, &rate, nullptr) >= 0;
+    ok = ok && snd_pcm_hw_params_set_period_size_near(pcm_, hw, &period, nullptr) >= 0;
+    ok = ok && snd_pcm_hw_params_set_buffer_size_near(pcm_, hw, &bufferSize) >= 0;
+    ok = ok && snd_pcm_hw_params(pcm_, hw) >= 0;
+    if (ok)
+    {
+        snd_pcm_hw_params_get_period_size(hw, &period, nullptr);
+        ok = snd_pcm_prepare(pcm_) >= 0;
+    }
+    if (!ok)
+    {
+        printf("ALSA: %s does not support a usable configuration\n", deviceName_.c_str());
+        CloseDevice();
+        return false;
+    }
+
+    config.sampleRate = rate;
+    config.channels = static_cast<uint16_t>(channels);
+    config.bufferFrames = static_cast<uint32_t>(period);
+    return true;
+}
+
+bool AlsaAudioDevice::Deliver(const float* frames, uint32_t numFrames)
+{
+    const uint16_t channels = GetConfig().channels;
+    const void* data = frames;
+    if (format_ == WavWriter::FORMAT_PCM16)
+    {
+        packed_.resize(static_cast<size_t>(numFrames) * channels);
+        for (size_t i = 0; i < packed_.size(); ++i)
+        {
+            float value = frames[i] * 32768.0f;
+            value = value > 32767.0f ? 32767.0f : (value < -32768.0f ? -32768.0f : value);
+            packed_[i] = static_cast<int16_t>(value);
+        }
+        data = packed_.data();
+    }
+
+    const size_t frameBytes = static_cast<size_t>(channels) * (format_ == WavWriter::FORMAT_PCM16 ? 2 : 4);
+    uint32_t written = 0;
+    while (written < numFrames)
+    {
+        snd_pcm_sframes_t result = snd_pcm_writei(pcm_, static_cast<const uint8_t*>(data) + written * frameBytes,
+            numFrames - written);
+        if (result < 0)
+        {
+            // Underrun or suspend - recover and rewrite the rest of the buffer
+            if (result == -EPIPE)
+            {
+                ReportXrun();
+            }
+            if (snd_pcm_recover(pcm_, static_cast<int>(result), 1) < 0)
+            {
+                printf("ALSA: write failed: %s\n", snd_strerror(static_cast<int>(result)));
+                return false;
+            }
+            continue;
+        }
+        written += static_cast<uint32_t>(result);
+    }
+    return true;
+}
+
+void AlsaAudioDevice::CloseDevice()
+{
+    if (pcm_)
+    {
+        snd_pcm_drop(pcm_);
+        snd_pcm_close(pcm_);
+        pcm_ = nullptr;
+    }
+}
+#endif
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include "WavWriter.h"
+
+// ALSA output is built on Linux wherever its headers are installed (link with -lasound)
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<alsa/asoundlib.h>)
+#define EXEDAW_HAS_ALSA 1
+#endif
+#endif
+
+// Audio Device - where the mix goes. A device owns the render thread: once started it asks the
+// render callback for one buffer of interleaved frames at a time and hands each to the backend,
+// whose Deliver() blocks until the hardware (or a clock, or a file) has taken it.
+// Open() negotiates: the backend may settle on another rate, buffer size or channel count,
+// and GetConfig() reports what it settled on.
+class AudioDevice
+{
+public:
+    enum Backend
+    {
+        BACKEND_NULL,              // Discards audio, clocked to the sample rate
+        BACKEND_NULL_FREE_RUNNING, // Discards audio as fast as it renders
+        BACKEND_WAV_FILE,          // Writes a WAV file, free-running
+        BACKEND_ALSA,              // Linux sound card
+        BACKEND_COUNT
+    };
+
+    // Fill numFrames interleaved frames of GetConfig().channels channels (render thread)
+    typedef std::function<void(float* output, uint32_t numFrames)> RenderCallback;
+
+    struct Config
+    {
+        uint32_t sampleRate = 44100;
+        uint32_t bufferFrames = 512;
+        uint16_t channels = 2;
+    };
+
+    // Render thread timing since Open(). Jitter is how far the gap between two callbacks strays
+    // from the period (only meaningful for clocked backends); load is callback time over the
+    // period, and headroom is 1 - peak load.
+    struct Stats
+    {
+        uint64_t buffers = 0;
+        uint64_t xruns = 0;           // Buffers the backend reported late (underruns)
+        double periodMicros = 0.0;
+        double meanCallbackMicros = 0.0;
+        double maxCallbackMicros = 0.0;
+        double meanJitterMicros = 0.0;
+        double maxJitterMicros = 0.0;
+        double meanLoad = 0.0;
+        double peakLoad = 0.0;
+        double headroom = 0.0;
+    };
+
+    // Backend factory - target is the file for BACKEND_WAV_FILE and the PCM name for BACKEND_ALSA
+    // ("default" if empty). Returns nullptr for a backend this build lacks.
+    static std::unique_ptr<AudioDevice> Create(Backend backend, const std::string& target = std::string());
+    static bool IsBackendAvailable(Backend backend);
+    static const char* GetBackendName(Backend backend);
+
+    AudioDevice();
+    virtual ~AudioDevice(); // Derived destructors must call Close()
+
+    AudioDevice(const AudioDevice&) = delete;
+    AudioDevice& operator=(const AudioDevice&) = delete;
+
+    virtual const char* GetName() const = 0;
+    virtual std::string GetTarget() const { return std::string(); } // File or PCM the device opens
+
+    bool Open(const Config& config);
+    bool Start(RenderCallback callback);
+    void Stop();
+    void Close();
+
+    bool IsOpen() const { return open_; }
+    bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+    const Config& GetConfig() const { return config_; }
+    uint64_t GetBuffersRendered() const { return buffersRendered_.load(std::memory_order_relaxed); }
+    Stats GetStats() const;
+
+protected:
+    // config holds the request on entry and what the backend settled on when it returns true
+    virtual bool OpenDevice(Config& config) = 0;
+    virtual bool Deliver(const float* frames, uint32_t numFrames) = 0; // false stops the render thread
+    virtual void CloseDevice() = 0;
+
+    void ReportXrun() { xruns_.fetch_add(1, std::memory_order_relaxed); } // From Deliver()
+
+private:
+    Config config_;
+    RenderCallback callback_;
+    std::thread renderThread_;
+    std::atomic<bool> running_;
+    std::atomic<bool> stopRequested_;
+    std::atomic<uint64_t> buffersRendered_;
+    std::vector<float> buffer_;
+    bool open_;
+
+    // Timing, written by the render thread only
+    std::atomic<uint64_t> xruns_;
+    std::atomic<uint64_t> callbackNanosTotal_;
+    std::atomic<uint64_t> callbackNanosMax_;
+    std::atomic<uint64_t> jitterNanosTotal_;
+    std::atomic<uint64_t> jitterNanosMax_;
+    std::atomic<uint64_t> jitterSamples_;
+
+    void RenderThreadMain();
+};
+
+// Null Device - discards the audio. Clocked, it paces buffers like a sound card of the opened
+// rate would; free-running, it renders as fast as the callback allows, for benchmarks.
+class NullAudioDevice : public AudioDevice
+{
+public:
+    explicit NullAudioDevice(bool clocked = true);
+    ~NullAudioDevice() override;
+
+    const char* GetName() const override { return "Null"; }
+
+protected:
+    bool OpenDevice(Config& config) override;
+    bool Deliver(const float* frames, uint32_t numFrames) override;
+    void CloseDevice() override;
+
+private:
+    bool clocked_;
+    std::chrono::steady_clock::time_point nextDeadline_;
+};
+
+// WAV File Device - writes everything it renders to a WAV file, free-running, for headless capture
+class WavFileAudioDevice : public AudioDevice
+{
+public:
+    explicit WavFileAudioDevice(const std::string& filePath, WavWriter::SampleFormat format = WavWriter::FORMAT_FLOAT32);
+    ~WavFileAudioDevice() override;
+
+    const char* GetName() const override { return "WAV File"; }
+    std::string GetTarget() const override { return filePath_; }
+
+protected:
+    bool OpenDevice(Config& config) override;
+    bool Deliver(const float* frames, uint32_t numFrames) override;
+    void CloseDevice() override;
+
+private:
+    std::string filePath_;
+    WavWriter::SampleFormat format_;
+    WavWriter writer_;
+};
+
+#ifdef EXEDAW_HAS_ALSA
+struct _snd_pcm;
+
+// ALSA Device - interleaved writes to a PCM, in float or, where the PCM takes nothing else, 16-bit.
+// The period is the negotiated buffer size, with three periods of hardware buffer.
+class AlsaAudioDevice : public AudioDevice
+{
+public:
+    explicit AlsaAudioDevice(const std::string& deviceName = "default");
+    ~AlsaAudioDevice() override;
+
+    const char* GetName() const override { return "ALSA"; }
+    std::string GetTarget() const override { return deviceName_; }
+
+protected:
+    bool OpenDevice(Config& config) override;
+    bool Deliver(const float* frames, uint32_t numFrames) override;
+    void CloseDevice() override;
+
+private:
+    std::string deviceName_;
+    _snd_pcm* pcm_;
+    WavWriter::SampleFormat format_; // Sample format the PCM accepted
+    std::vector<int16_t> packed_;    // 16-bit samples on their way to the PCM
+};
+#endif
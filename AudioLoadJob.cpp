@@ -0,0 +1,95 @@
+#include "AudioLoadJob.h"
+#include <chrono>
+#include <cstdio>
+
+AudioLoadJob::AudioLoadJob(const std::shared_ptr<AudioTrack>& target, const std::string& filePath)
+    : target_(target)
+    , filePath_(filePath)
+    , staging_(std::make_unique<AudioTrack>())
+    , status_(LOADING)
+{
+}
+
+AudioLoadJob::~AudioLoadJob()
+{
+    // The loader still references staging_ and progress_ - stop it and wait
+    if (result_.valid())
+    {
+        Cancel();
+        result_.wait();
+    }
+}
+
+std::shared_ptr<AudioLoadJob> AudioLoadJob::Start(const std::shared_ptr<AudioTrack>& target,
+                                                  const std::string& filePath,
+                                                  AudioTrack::LoadMode mode)
+{
+    std::shared_ptr<AudioLoadJob> job(new AudioLoadJob(target, filePath));
+
+    // A dedicated thread per file so a slow disk never holds up the shared decode pool;
+    // the decode itself still fans out across the pool
+    AudioTrack* staging = job->staging_.get();
+    LoadProgress* progress = &job->progress_;
+    job->result_ = std::async(std::launch::async, [staging, filePath, mode, progress]()
+    {
+        return staging->LoadFromFile(filePath, mode, progress);
+    });
+
+    return job;
+}
+
+AudioLoadJob::Status AudioLoadJob::Poll()
+{
+    if (status_ != LOADING)
+    {
+        return status_;
+    }
+
+    if (result_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return status_;
+    }
+
+    bool loaded = result_.get();
+    std::shared_ptr<AudioTrack> target = target_.lock();
+
+    if (progress_.cancelRequested.load())
+    {
+        status_ = CANCELLED;
+    }
+    else if (!loaded || !target)
+    {
+        // A target deleted mid-load simply drops the result
+        status_ = FAILED;
+    }
+    else
+    {
+        target->AdoptAudio(*staging_);
+        status_ = SUCCEEDED;
+        printf("Loaded %s: %u frames, %u Hz, %u channels\n", filePath_.c_str(),
+               target->GetNumSamples(), target->GetSampleRate(), target->GetNumChannels());
+    }
+
+    staging_.reset();
+    return status_;
+}
+
+void AudioLoadJob::Cancel()
+{
+    progress_.cancelRequested.store(true);
+}
+
+float AudioLoadJob::GetFraction() const
+{
+    if (status_ == SUCCEEDED)
+    {
+        return 1.0f;
+    }
+
+    uint64_t total = GetBytesTotal();
+    if (total == 0)
+    {
+        return 0.0f;
+    }
+    return static_cast<float>(static_cast<double>(GetBytesRead()) / static_cast<double>(total));
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "AudioTrack.h"
+#include <string>
+#include <memory>
+#include <future>
+#include <cstdint>
+
+// Audio Load Job - loads a file into a staging track on a background thread and
+// hands the result to the target track once it is done
+class AudioLoadJob
+{
+public:
+    enum Status
+    {
+        LOADING,
+        SUCCEEDED,
+        FAILED,
+        CANCELLED
+    };
+
+    // Start loading filePath for target. The target is untouched until Poll() sees the load finish.
+    static std::shared_ptr<AudioLoadJob> Start(const std::shared_ptr<AudioTrack>& target,
+                                               const std::string& filePath,
+                                               AudioTrack::LoadMode mode = AudioTrack::LOAD_EAGER);
+
+    ~AudioLoadJob();
+
+    AudioLoadJob(const AudioLoadJob&) = delete;
+    AudioLoadJob& operator=(const AudioLoadJob&) = delete;
+
+    // Call from the thread that owns the target track. Never blocks; once the
+    // load has finished the decoded audio is swapped into the target in one step.
+    Status Poll();
+
+    // Ask the loader to stop - Poll() reports CANCELLED once it has
+    void Cancel();
+
+    Status GetStatus() const { return status_; }
+    bool IsFinished() const { return status_ != LOADING; }
+    bool IsCancelRequested() const { return progress_.cancelRequested.load(); }
+
+    // Progress
+    uint64_t GetBytesTotal() const { return progress_.bytesTotal.load(std::memory_order_relaxed); }
+    uint64_t GetBytesRead() const { return progress_.bytesRead.load(std::memory_order_relaxed); }
+    uint64_t GetSamplesDecoded() const { return progress_.samplesDecoded.load(std::memory_order_relaxed); }
+    float GetFraction() const; // 0.0 to 1.0
+    std::shared_ptr<const PeakPyramid> GetPeaks() const { return progress_.GetPeaks(); } // Of the part decoded so far
+
+    const std::string& GetFilePath() const { return filePath_; }
+    std::shared_ptr<AudioTrack> GetTarget() const { return target_.lock(); }
+
+private:
+    AudioLoadJob(const std::shared_ptr<AudioTrack>& target, const std::string& filePath);
+
+    std::weak_ptr<AudioTrack> target_;
+    std::string filePath_;
+    std::unique_ptr<AudioTrack> staging_; // Only touched by the loader until result_ is ready
+    LoadProgress progress_;
+    std::future<bool> result_;
+    Status status_;
+};
@@ -1,35 +1,64 @@
 #include "AudioPlayer.h"
+#include "AudioTrack.h"
 #include <cstring>
+#include <cmath>
+#include <chrono>
 #include <algorithm>
 #include <fstream>
 
 AudioPlayer::AudioPlayer() 
-    : state_(STOPPED), currentPosition_(0), volume_(1.0f)
+    : state_(STOPPED), currentPosition_(0), durationFrames_(0), volume_(1.0f),
+    sourceMode_(SOURCE_MEMORY), stopStreaming_(false), seekTarget_(0),
+    seekGeneration_(0), servedGeneration_(0), underruns_(0), underrunFrames_(0),
+    framesStreamed_(0), seeks_(0)
 {
 }
 
 AudioPlayer::~AudioPlayer()
 {
+    CloseStream();
 }
 
-bool AudioPlayer::LoadAudioFile(const std::string& filePath)
+bool AudioPlayer::LoadAudioFile(const std::string& filePath, SourceMode mode)
 {
+    CloseStream();
+    currentPosition_ = 0;
+
+    if (mode == SOURCE_STREAMING)
+    {
+        return OpenStream(filePath);
+    }
     return ParseAudioFile(filePath);
 }
 
+bool AudioPlayer::LoadAudioData(AudioData&& data)
+{
+    if (data.channels == 0)
+    {
+        return false;
+    }
+
+    CloseStream();
+    currentPosition_ = 0;
+
+    audioData_ = std::move(data);
+    durationFrames_ = audioData_.GetNumFrames();
+    return true;
+}
+
 void AudioPlayer::Play()
 {
     state_ = PLAYING;
     if (currentPosition_ >= GetDuration())
     {
-        currentPosition_ = 0; // Restart from beginning if at the end
+        SetPosition(0); // Restart from beginning if at the end
     }
 }
 
 void AudioPlayer::Stop()
 {
     state_ = STOPPED;
-    currentPosition_ = 0;
+    SetPosition(0);
 }
 
 void AudioPlayer::Pause()
@@ -53,6 +82,15 @@ void AudioPlayer::SetPosition(uint32_t sampleIndex)
     if (sampleIndex <= GetDuration())
     {
         currentPosition_ = sampleIndex;
+
+        if (sourceMode_ == SOURCE_STREAMING)
+        {
+            // The I/O thread flushes the ring and refills from the new position right away
+            seekTarget_.store(sampleIndex, std::memory_order_relaxed);
+            seekGeneration_.fetch_add(1, std::memory_order_release);
+            seeks_.fetch_add(1, std::memory_order_relaxed);
+            streamWake_.notify_one();
+        }
     }
 }
 
@@ -63,7 +101,7 @@ uint32_t AudioPlayer::GetPosition() const
 
 uint32_t AudioPlayer::GetDuration() const
 {
-    return static_cast<uint32_t>(audioData_.samples.size() / audioData_.channels);
+    return durationFrames_;
 }
 
 const AudioData& AudioPlayer::GetAudioData() const
@@ -78,40 +116,176 @@ AudioPlayer::PlaybackState AudioPlayer::GetState() const
 
 void AudioPlayer::SetVolume(float volume)
 {
-    volume_ = std::max(0.0f, std::min(1.0f, volume));
+    volume_.store(std::max(0.0f, std::min(1.0f, volume)), std::memory_order_relaxed);
 }
 
 float AudioPlayer::GetVolume() const
 {
-    return volume_;
+    return volume_.load(std::memory_order_relaxed);
 }
 
 bool AudioPlayer::ParseAudioFile(const std::string& filePath)
 {
-    // This is a simplified implementation
-    // In a real application, you would use libraries like JUCE, PortAudio, or FMOD
-    
+    // The track is only used as a decoder - players of the same file share its pooled buffer.
+    // Unreadable files fall back to the track's test tone.
+    AudioTrack track;
+    if (!track.LoadFromFile(filePath) || !track.GetBuffer())
+    {
+        return false;
+    }
+
+    audioData_.buffer = track.GetBuffer();
     audioData_.filePath = filePath;
-    audioData_.sampleRate = 44100;
-    audioData_.channels = 2;
-  audioData_.bitDepth = 16;
+    audioData_.sampleRate = track.GetSampleRate();
+    audioData_.channels = track.GetNumChannels();
+    audioData_.bitDepth = track.GetBitsPerSample();
+    durationFrames_ = track.GetNumSamples();
+
+    return true;
+}
+
+uint32_t AudioPlayer::ReadFrames(float* dest, uint32_t numFrames)
+{
+    const uint16_t channels = audioData_.channels;
+    uint32_t position = currentPosition_.load(std::memory_order_acquire);
+    uint32_t framesRead = 0;
+
+    if (state_ == PLAYING && position < durationFrames_)
+    {
+        if (sourceMode_ == SOURCE_STREAMING)
+        {
+            uint32_t generation = seekGeneration_.load(std::memory_order_acquire);
+            bool seekPending = servedGeneration_.load(std::memory_order_acquire) != generation;
+
+            if (!seekPending)
+            {
+                framesRead = ringBuffer_.Read(dest, numFrames);
+            }
+
+            // Position only advances if no seek landed while we were reading
+            if (framesRead > 0 && seekGeneration_.load(std::memory_order_acquire) == generation)
+            {
+                currentPosition_.compare_exchange_strong(position, position + framesRead);
+            }
 
-    // Simulate loading audio data (create dummy waveform)
-    // In production, parse actual audio files (WAV, MP3, FLAC, etc.)
-    uint32_t durationSamples = audioData_.sampleRate * 10; // 10 seconds
-    audioData_.samples.resize(durationSamples * audioData_.channels);
+            uint32_t expected = std::min(numFrames, durationFrames_ - position);
+            if (!seekPending && framesRead < expected)
+            {
+                underruns_.fetch_add(1, std::memory_order_relaxed);
+                underrunFrames_.fetch_add(expected - framesRead, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            framesRead = audioData_.buffer->ReadInterleaved(position, numFrames, dest);
+            currentPosition_.compare_exchange_strong(position, position + framesRead);
+        }
+    }
+
+    std::fill(dest + static_cast<size_t>(framesRead) * channels,
+        dest + static_cast<size_t>(numFrames) * channels, 0.0f);
+    return framesRead;
+}
 
-    // Generate a simple sine wave for demonstration
-    for (uint32_t i = 0; i < durationSamples; ++i)
+AudioPlayer::StreamStats AudioPlayer::GetStreamStats() const
+{
+    StreamStats stats;
+    stats.underruns = underruns_.load(std::memory_order_relaxed);
+    stats.underrunFrames = underrunFrames_.load(std::memory_order_relaxed);
+    stats.framesStreamed = framesStreamed_.load(std::memory_order_relaxed);
+    stats.seeks = seeks_.load(std::memory_order_relaxed);
+    stats.bufferedFrames = sourceMode_ == SOURCE_STREAMING ? ringBuffer_.GetReadableFrames() : 0;
+    return stats;
+}
+
+bool AudioPlayer::OpenStream(const std::string& filePath)
+{
+    // The mapped track is only used as a decoder - samples go straight to the ring buffer
+    auto source = std::make_unique<AudioTrack>();
+    if (!source->LoadFromFile(filePath, AudioTrack::LOAD_MAPPED))
     {
-        float frequency = 440.0f; // A4 note
-        float amplitude = 0.8f;
-      float sample = amplitude * std::sin(2.0f * 3.14159f * frequency * i / audioData_.sampleRate);
-        
-        // Fill both channels with the same signal
-        audioData_.samples[i * 2] = sample;
- audioData_.samples[i * 2 + 1] = sample;
- }
+        return false;
+    }
+
+    audioData_.buffer.reset();
+    audioData_.filePath = filePath;
+    audioData_.sampleRate = source->GetSampleRate();
+    audioData_.channels = source->GetNumChannels();
+    audioData_.bitDepth = source->GetBitsPerSample();
+    durationFrames_ = source->GetNumSamples();
+
+    streamSource_ = std::move(source);
+    ringBuffer_.Allocate(kStreamBufferFrames, audioData_.channels);
+    underruns_ = 0;
+    underrunFrames_ = 0;
+    framesStreamed_ = 0;
+    seeks_ = 0;
 
+    // Generation mismatch makes the I/O thread prefetch from frame 0 immediately
+    seekTarget_ = 0;
+    servedGeneration_ = seekGeneration_.load() - 1;
+    stopStreaming_ = false;
+    sourceMode_ = SOURCE_STREAMING;
+    streamThread_ = std::thread(&AudioPlayer::StreamThreadMain, this);
     return true;
 }
+
+void AudioPlayer::CloseStream()
+{
+    if (streamThread_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(streamMutex_);
+            stopStreaming_ = true;
+        }
+        streamWake_.notify_one();
+        streamThread_.join();
+    }
+
+    streamSource_.reset();
+    sourceMode_ = SOURCE_MEMORY;
+    durationFrames_ = 0;
+}
+
+void AudioPlayer::StreamThreadMain()
+{
+    const uint16_t channels = audioData_.channels;
+    std::vector<float> chunk(static_cast<size_t>(kStreamChunkFrames) * channels);
+    uint32_t readPosition = 0;
+    uint32_t served = servedGeneration_.load();
+
+    while (!stopStreaming_)
+    {
+        uint32_t generation = seekGeneration_.load(std::memory_order_acquire);
+        if (generation != served)
+        {
+            readPosition = seekTarget_.load(std::memory_order_relaxed);
+            ringBuffer_.Flush();
+            currentPosition_.store(readPosition, std::memory_order_release);
+
+            // Prime one chunk before releasing the consumer so the first pull after a seek has data
+            uint32_t frames = streamSource_->ReadFrames(readPosition, kStreamChunkFrames, chunk.data());
+            readPosition += ringBuffer_.Write(chunk.data(), frames);
+            framesStreamed_.fetch_add(frames, std::memory_order_relaxed);
+
+            served = generation;
+            servedGeneration_.store(served, std::memory_order_release);
+            continue;
+        }
+
+        if (readPosition < durationFrames_ && ringBuffer_.GetWritableFrames() >= kStreamChunkFrames)
+        {
+            uint32_t frames = streamSource_->ReadFrames(readPosition, kStreamChunkFrames, chunk.data());
+            readPosition += ringBuffer_.Write(chunk.data(), frames);
+            framesStreamed_.fetch_add(frames, std::memory_order_relaxed);
+            continue;
+        }
+
+        // Ring is full or the file is exhausted - the render thread never signals, so poll
+        std::unique_lock<std::mutex> lock(streamMutex_);
+        streamWake_.wait_for(lock, std::chrono::milliseconds(5), [this, served]()
+        {
+            return stopStreaming_ || seekGeneration_.load(std::memory_order_acquire) != served;
+        });
+    }
+}
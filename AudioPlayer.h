@@ -4,20 +4,31 @@
 #include <vector>
 #include <memory>
 #include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "AudioRingBuffer.h"
+#include "SampleBuffer.h"
 
 // Forward declarations
 class SequencerChannel;
+class AudioTrack;
 
 // Audio data structure for waveform representation
+// Copies are cheap - the samples are a shared, immutable SamplePool buffer
 struct AudioData
 {
-    std::vector<float> samples;
+    std::shared_ptr<const SampleBuffer> buffer; // Planar samples, nullptr when empty
     uint32_t sampleRate;
   uint16_t channels;
   uint16_t bitDepth;
     std::string filePath;
 
     AudioData() : sampleRate(44100), channels(2), bitDepth(16) {}
+
+    size_t GetNumSamples() const { return buffer ? buffer->GetNumSamples() : 0; }
+    uint32_t GetNumFrames() const { return buffer ? buffer->GetNumFrames() : 0; }
 };
 
 // Audio Player - Can be used on multiple channels
@@ -32,11 +43,42 @@ PLAYING,
     RECORDING
 };
 
+    // Where playback reads its samples from
+    enum SourceMode
+    {
+        SOURCE_MEMORY,    // Whole file decoded into a pooled AudioData::buffer
+        SOURCE_STREAMING  // File stays on disk, a background thread reads ahead into a ring buffer
+    };
+
+    // Streaming counters - underruns are render pulls the ring could not satisfy
+    struct StreamStats
+    {
+        uint64_t underruns = 0;
+        uint64_t underrunFrames = 0;
+        uint64_t framesStreamed = 0;
+        uint64_t seeks = 0;
+        uint32_t bufferedFrames = 0;
+    };
+
+    // Streaming read-ahead sizes
+    static constexpr uint32_t kStreamBufferFrames = 131072;
+    static constexpr uint32_t kStreamChunkFrames = 8192;
+
     AudioPlayer();
     ~AudioPlayer();
 
     // Load audio file
-    bool LoadAudioFile(const std::string& filePath);
+    bool LoadAudioFile(const std::string& filePath, SourceMode mode = SOURCE_MEMORY);
+    SourceMode GetSourceMode() const { return sourceMode_; }
+    bool IsStreaming() const { return sourceMode_ == SOURCE_STREAMING; }
+
+    // Play samples that were decoded elsewhere (SOURCE_MEMORY), taking ownership of them
+    bool LoadAudioData(AudioData&& data);
+
+    // Pull interleaved frames at the current position and advance it (render thread).
+    // Frames that are not available are filled with silence; returns frames taken from the source.
+    uint32_t ReadFrames(float* dest, uint32_t numFrames);
+    StreamStats GetStreamStats() const;
 
   // Playback control
     void Play();
@@ -59,10 +101,30 @@ PLAYING,
 
 private:
     AudioData audioData_;
-    PlaybackState state_;
-    uint32_t currentPosition_;
-    float volume_;
+    std::atomic<PlaybackState> state_;
+    std::atomic<uint32_t> currentPosition_;
+    uint32_t durationFrames_;
+    std::atomic<float> volume_; // Read by the mix engine
+
+    // Streaming source (SOURCE_STREAMING only)
+    SourceMode sourceMode_;
+    std::unique_ptr<AudioTrack> streamSource_;
+    AudioRingBuffer ringBuffer_;
+    std::thread streamThread_;
+    std::mutex streamMutex_;
+    std::condition_variable streamWake_;
+    std::atomic<bool> stopStreaming_;
+    std::atomic<uint32_t> seekTarget_;
+    std::atomic<uint32_t> seekGeneration_;   // Bumped by SetPosition
+    std::atomic<uint32_t> servedGeneration_; // Last seek the I/O thread has refilled for
+    std::atomic<uint64_t> underruns_;
+    std::atomic<uint64_t> underrunFrames_;
+    std::atomic<uint64_t> framesStreamed_;
+    std::atomic<uint64_t> seeks_;
 
-    // Helper function to parse audio file (simplified)
+    // Decode (or share) the whole file through the sample pool
     bool ParseAudioFile(const std::string& filePath);
+    bool OpenStream(const std::string& filePath);
+    void CloseStream();
+    void StreamThreadMain();
 };
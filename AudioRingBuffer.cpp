@@ -0,0 +1,88 @@
+#include "AudioRingBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer()
+    : capacity_(0), channels_(0), writeIndex_(0), readIndex_(0)
+{
+}
+
+void AudioRingBuffer::Allocate(uint32_t capacityFrames, uint16_t channels)
+{
+    capacity_ = capacityFrames;
+    channels_ = channels;
+    buffer_.assign(static_cast<size_t>(capacityFrames) * channels, 0.0f);
+    writeIndex_.store(0, std::memory_order_relaxed);
+    readIndex_.store(0, std::memory_order_relaxed);
+}
+
+uint32_t AudioRingBuffer::GetReadableFrames() const
+{
+    uint64_t write = writeIndex_.load(std::memory_order_acquire);
+    uint64_t read = readIndex_.load(std::memory_order_acquire);
+    return static_cast<uint32_t>(write - read);
+}
+
+uint32_t AudioRingBuffer::GetWritableFrames() const
+{
+    return capacity_ - GetReadableFrames();
+}
+
+uint32_t AudioRingBuffer::Write(const float* src, uint32_t numFrames)
+{
+    uint64_t write = writeIndex_.load(std::memory_order_relaxed);
+    uint64_t read = readIndex_.load(std::memory_order_acquire);
+    uint32_t frames = std::min(numFrames, capacity_ - static_cast<uint32_t>(write - read));
+
+    CopyIn(write, src, frames);
+    writeIndex_.store(write + frames, std::memory_order_release);
+    return frames;
+}
+
+void AudioRingBuffer::Flush()
+{
+    // Any consumer Read() that started before this point fails its CAS and drops its copy
+    readIndex_.store(writeIndex_.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+uint32_t AudioRingBuffer::Read(float* dest, uint32_t numFrames)
+{
+    uint64_t read = readIndex_.load(std::memory_order_acquire);
+    uint64_t write = writeIndex_.load(std::memory_order_acquire);
+    uint32_t frames = std::min(numFrames, static_cast<uint32_t>(write - read));
+    if (frames == 0)
+    {
+        return 0;
+    }
+
+    CopyOut(read, dest, frames);
+
+    // A flush moved the read index while we were copying - the data may be stale or overwritten
+    if (!readIndex_.compare_exchange_strong(read, read + frames, std::memory_order_acq_rel))
+    {
+        return 0;
+    }
+    return frames;
+}
+
+void AudioRingBuffer::CopyIn(uint64_t index, const float* src, uint32_t numFrames)
+{
+    uint32_t slot = static_cast<uint32_t>(index % capacity_);
+    uint32_t firstPart = std::min(numFrames, capacity_ - slot);
+
+    std::memcpy(&buffer_[static_cast<size_t>(slot) * channels_], src,
+        static_cast<size_t>(firstPart) * channels_ * sizeof(float));
+    std::memcpy(buffer_.data(), src + static_cast<size_t>(firstPart) * channels_,
+        static_cast<size_t>(numFrames - firstPart) * channels_ * sizeof(float));
+}
+
+void AudioRingBuffer::CopyOut(uint64_t index, float* dest, uint32_t numFrames) const
+{
+    uint32_t slot = static_cast<uint32_t>(index % capacity_);
+    uint32_t firstPart = std::min(numFrames, capacity_ - slot);
+
+    std::memcpy(dest, &buffer_[static_cast<size_t>(slot) * channels_],
+        static_cast<size_t>(firstPart) * channels_ * sizeof(float));
+    std::memcpy(dest + static_cast<size_t>(firstPart) * channels_, buffer_.data(),
+        static_cast<size_t>(numFrames - firstPart) * channels_ * sizeof(float));
+}
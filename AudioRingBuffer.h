@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free ring of interleaved float frames between one producer (I/O thread)
+// and one consumer (render thread). The producer may also Flush() unread frames
+// after a seek; a consumer Read() that races a flush returns 0 frames.
+class AudioRingBuffer
+{
+public:
+    AudioRingBuffer();
+
+    // Not thread safe - call before either side starts
+    void Allocate(uint32_t capacityFrames, uint16_t channels);
+
+    uint32_t GetCapacity() const { return capacity_; }
+    uint32_t GetReadableFrames() const;
+    uint32_t GetWritableFrames() const;
+
+    // Producer side
+    uint32_t Write(const float* src, uint32_t numFrames);
+    void Flush();
+
+    // Consumer side
+    uint32_t Read(float* dest, uint32_t numFrames);
+
+private:
+    std::vector<float> buffer_;
+    uint32_t capacity_;
+    uint16_t channels_;
+
+    // Monotonic frame counters - the slot is index % capacity_
+    std::atomic<uint64_t> writeIndex_;
+    std::atomic<uint64_t> readIndex_;
+
+    void CopyIn(uint64_t index, const float* src, uint32_t numFrames);
+    void CopyOut(uint64_t index, float* dest, uint32_t numFrames) const;
+};
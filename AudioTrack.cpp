@@ -1,12 +1,128 @@
 #include "AudioTrack.h"
+#include "MappedFile.h"
+#include "SampleConvert.h"
+#include "ThreadPool.h"
+#include "SamplePool.h"
+#include "FlacDecoder.h"
+#include "DecodeCache.h"
+#include "AudioAnalysis.h"
+#include "PeakPyramid.h"
 #include <algorithm>
 #include <cmath>
 #include <cstring>
 
+// Source bytes per parallel decode task - large enough to amortize scheduling, small enough to balance
+static const size_t kDecodeChunkBytes = 4 * 1024 * 1024;
+static const uint32_t kScanFrames = 4096; // Frames read at a time by range scans
+
+// Frame indices are 32-bit - anything past that is unreachable
+static uint32_t ClampFrameCount(uint64_t frames)
+{
+    return frames > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(frames);
+}
+
+// Convert numFrames interleaved packed frames into the channel arrays of buffer, starting at firstFrame.
+// Compact buffers hold the source encoding, so their samples are only split per channel.
+static void ConvertFrames(SampleConvert::Format format, const uint8_t* src, SampleBuffer& buffer, size_t firstFrame, size_t numFrames)
+{
+    if (buffer.IsCompact())
+    {
+        const size_t bytesPerSample = SampleBuffer::GetBytesPerSample(buffer.GetStorage());
+        std::vector<uint8_t*> dest(buffer.GetNumChannels());
+        for (uint16_t ch = 0; ch < buffer.GetNumChannels(); ++ch)
+        {
+            dest[ch] = buffer.GetWritableChannelBytes(ch) + firstFrame * bytesPerSample;
+        }
+        SampleConvert::DeinterleavePacked(src, dest.data(), buffer.GetNumChannels(), bytesPerSample, numFrames);
+        return;
+    }
+    
+    std::vector<float*> dest(buffer.GetNumChannels());
+    for (uint16_t ch = 0; ch < buffer.GetNumChannels(); ++ch)
+    {
+        dest[ch] = buffer.GetWritableChannel(ch) + firstFrame;
+    }
+    SampleConvert::ToFloatPlanar(format, src, dest.data(), buffer.GetNumChannels(), numFrames);
+}
+
+// Track name is the file name without directory or extension
+static std::string TrackNameFromPath(const std::string& filePath)
+{
+    size_t lastSlash = filePath.find_last_of("/\\");
+    size_t lastDot = filePath.find_last_of('.');
+    if (lastSlash != std::string::npos && lastDot != std::string::npos && lastDot > lastSlash)
+    {
+        return filePath.substr(lastSlash + 1, lastDot - lastSlash - 1);
+    }
+    return filePath;
+}
+
+// Let progress watchers draw the pyramid being built, unless peaks kept from an earlier load already show the whole file
+static void PublishPeaks(LoadProgress* progress, const PeakBuilder& peaks)
+{
+    if (progress && !progress->GetPeaks())
+    {
+        progress->SetPeaks(peaks.GetPyramid());
+    }
+}
+
+// True if the file starts like a WAV (RIFF/RF64/BW64) or FLAC stream, i.e. one of the decoders claims it
+static bool IsRecognisedAudioFile(const std::string& filePath)
+{
+    MappedFile mapping;
+    if (!mapping.Open(filePath) || mapping.GetSize() > SIZE_MAX)
+    {
+        return false;
+    }
+    
+    const uint8_t* data = mapping.GetData();
+    const size_t size = static_cast<size_t>(mapping.GetSize());
+    if (FlacDecoder::IsFlac(data, size))
+    {
+        return true;
+    }
+    return size >= 12 && std::memcmp(data + 8, "WAVE", 4) == 0 &&
+        (std::memcmp(data, "RIFF", 4) == 0 || std::memcmp(data, "RF64", 4) == 0 || std::memcmp(data, "BW64", 4) == 0);
+}
+
+// Read-only seekable stream over a file image in memory, so the header parser can run on it
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+    MemoryStreamBuf(const uint8_t* data, size_t size)
+    {
+        char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? gptr() - eback() : egptr() - eback();
+        return seekpos(pos_type(base + offset), which);
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode) override
+    {
+        off_type offset = static_cast<off_type>(position);
+        if (offset < 0 || offset > egptr() - eback())
+        {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + offset, egptr());
+        return position;
+    }
+};
+
 AudioTrack::AudioTrack()
     : sampleRate_(44100)
     , numChannels_(2)
     , bitsPerSample_(16)
+    , numFrames_(0)
+    , sampleFormat_(SampleConvert::FLOAT32)
+    , loadMode_(LOAD_EAGER)
+    , dataOffset_(0)
+    , dataSize_(0)
     , volume_(1.0f)
     , pan_(0.0f)
     , muted_(false)
@@ -16,32 +132,77 @@ AudioTrack::AudioTrack()
 
 AudioTrack::~AudioTrack()
 {
+    ReleaseMapping();
 }
 
-bool AudioTrack::LoadFromFile(const std::string& filePath)
+bool AudioTrack::LoadFromFile(const std::string& filePath, LoadMode mode, LoadProgress* progress)
 {
+    ReleaseMapping();
+    buffer_.reset();
+    numFrames_ = 0;
     filePath_ = filePath;
     
-    // Extract name from file path
-    size_t lastSlash = filePath.find_last_of("/\\");
-  size_t lastDot = filePath.find_last_of('.');
-    if (lastSlash != std::string::npos && lastDot != std::string::npos)
+    name_ = TrackNameFromPath(filePath);
+    
+    // Already decoded for another track and unchanged on disk - share it
+    if (mode != LOAD_MAPPED)
     {
-        name_ = filePath.substr(lastSlash + 1, lastDot - lastSlash - 1);
+        std::shared_ptr<const SampleBuffer> pooled = SamplePool::GetShared().FindFile(filePath, mode == LOAD_COMPACT);
+        if (!pooled)
+        {
+            // Decoded in an earlier session - map the samples back in from the decode cache
+            std::unique_ptr<SampleBuffer> cached = DecodeCache::GetShared().Find(filePath, mode == LOAD_COMPACT);
+            if (cached)
+            {
+                pooled = SamplePool::GetShared().Intern(std::move(cached), filePath);
+            }
+        }
+        if (pooled)
+        {
+            buffer_ = pooled;
+            sampleRate_ = pooled->GetSampleRate();
+            numChannels_ = pooled->GetNumChannels();
+            bitsPerSample_ = pooled->GetBitsPerSample();
+            numFrames_ = pooled->GetNumFrames();
+            if (progress)
+            {
+                progress->bytesTotal.store(pooled->GetSizeBytes());
+                progress->bytesRead.store(pooled->GetSizeBytes());
+                progress->samplesDecoded.store(pooled->GetNumSamples());
+            }
+            return true;
+        }
+        
+        // Peaks kept from an earlier load draw the whole waveform while the samples decode
+        if (progress)
+        {
+            progress->SetPeaks(DecodeCache::GetShared().FindPeaks(filePath));
+        }
     }
-    else
-    {
-        name_ = filePath;
- }
     
-    // Try to load as WAV
-    if (LoadWAV(filePath))
+    // Try to load as WAV, then FLAC
+    if (LoadWAV(filePath, mode, progress) || LoadFLAC(filePath, mode, progress))
     {
         return true;
     }
     
-    // If WAV loading failed, generate test tone
-    printf("WAV loading failed, generating test tone for: %s\n", filePath.c_str());
+    if (progress && progress->cancelRequested.load())
+    {
+        printf("Load cancelled: %s\n", filePath.c_str());
+        Clear();
+        return false;
+    }
+    
+    // A WAV or FLAC that does not decode is an error - never stand a tone in for a broken file
+    if (IsRecognisedAudioFile(filePath))
+    {
+        printf("Failed to decode audio file: %s\n", filePath.c_str());
+        Clear();
+        return false;
+    }
+    
+    // Not a format we read, generate test tone
+    printf("Unrecognised audio file, generating test tone for: %s\n", filePath.c_str());
     
     // Generate 5 second test tone at 440Hz
     sampleRate_ = 44100;
@@ -49,7 +210,9 @@ bool AudioTrack::LoadFromFile(const std::string& filePath)
     bitsPerSample_ = 16;
     
     uint32_t numSamples = sampleRate_ * 5; // 5 seconds
-    samples_.resize(numSamples * numChannels_);
+    auto buffer = std::make_unique<SampleBuffer>(numSamples, sampleRate_, numChannels_, bitsPerSample_);
+    float* left = buffer->GetWritableChannel(0);
+    float* right = buffer->GetWritableChannel(1);
     
   const float frequency = 440.0f; // A4
     const float amplitude = 0.5f;
@@ -71,24 +234,102 @@ bool AudioTrack::LoadFromFile(const std::string& filePath)
         }
     
         float sample = value * envelope;
-        samples_[i * numChannels_] = sample;
-        samples_[i * numChannels_ + 1] = sample;
+        left[i] = sample;
+        right[i] = sample;
     }
     
+    // Not registered under the path - the file may become readable later
+    SetBuffer(std::move(buffer), std::string());
     return true;
 }
 
 bool AudioTrack::LoadFromMemory(const float* samples, uint32_t numSamples, uint32_t sampleRate, uint16_t channels)
 {
+    ReleaseMapping();
     sampleRate_ = sampleRate;
     numChannels_ = channels;
     bitsPerSample_ = 32; // Float
     
-    samples_.assign(samples, samples + numSamples * channels);
+    auto buffer = std::make_unique<SampleBuffer>(numSamples, sampleRate, channels, bitsPerSample_);
+    std::vector<float*> dest(channels);
+    for (uint16_t ch = 0; ch < channels; ++ch)
+    {
+        dest[ch] = buffer->GetWritableChannel(ch);
+    }
+    SampleConvert::Deinterleave(samples, dest.data(), channels, numSamples);
+    
+    SetBuffer(std::move(buffer), std::string());
     return true;
 }
 
-bool AudioTrack::LoadWAV(const std::string& filePath)
+bool AudioTrack::LoadFromEncoded(const std::string& filePath, const uint8_t* data, size_t size, LoadProgress* progress)
+{
+    ReleaseMapping();
+    buffer_.reset();
+    numFrames_ = 0;
+    filePath_ = filePath;
+    name_ = TrackNameFromPath(filePath);
+    
+    if (FlacDecoder::IsFlac(data, size))
+    {
+        return DecodeFLAC(data, size, LOAD_EAGER, false, progress);
+    }
+    
+    MemoryStreamBuf streamBuf(data, size);
+    std::istream stream(&streamBuf);
+    
+    WAVInfo info;
+    SampleConvert::Format format;
+    if (!ParseWAVHeader(stream, info) || !ResolveSampleFormat(info, format) || info.numChannels == 0)
+    {
+        return false;
+    }
+    
+    const size_t bytesPerSample = SampleConvert::GetBytesPerSample(format);
+    const uint64_t frameBytes = static_cast<uint64_t>(info.numChannels) * bytesPerSample;
+    if (info.dataSize < frameBytes)
+    {
+        return false;
+    }
+    
+    sampleRate_ = info.sampleRate;
+    numChannels_ = info.numChannels;
+    bitsPerSample_ = info.bitsPerSample;
+    sampleFormat_ = format;
+    const uint32_t numFrames = ClampFrameCount(info.dataSize / frameBytes);
+    auto buffer = std::make_unique<SampleBuffer>(numFrames, sampleRate_, numChannels_, bitsPerSample_);
+    PeakBuilder peaks(*buffer);
+    
+    if (progress)
+    {
+        progress->bytesTotal.store(numFrames * frameBytes);
+    }
+    PublishPeaks(progress, peaks);
+    
+    const size_t chunkFrames = std::max<size_t>(1, kDecodeChunkBytes / frameBytes);
+    const uint8_t* source = data + info.dataOffset;
+    for (size_t first = 0; first < numFrames; first += chunkFrames)
+    {
+        if (progress && progress->cancelRequested.load())
+        {
+            return false;
+        }
+        
+        size_t count = std::min<size_t>(chunkFrames, numFrames - first);
+        ConvertFrames(format, source + first * frameBytes, *buffer, first, count);
+        peaks.MarkDecoded(static_cast<uint32_t>(first), static_cast<uint32_t>(count));
+        if (progress)
+        {
+            progress->bytesRead.fetch_add(count * frameBytes);
+            progress->samplesDecoded.fetch_add(count * numChannels_);
+        }
+    }
+    
+    SetBuffer(std::move(buffer), filePath_, peaks.GetPyramid());
+    return true;
+}
+
+bool AudioTrack::LoadWAV(const std::string& filePath, LoadMode mode, LoadProgress* progress)
 {
     std::ifstream file(filePath, std::ios::binary);
     if (!file.is_open())
@@ -96,141 +337,487 @@ bool AudioTrack::LoadWAV(const std::string& filePath)
      return false;
     }
     
-    WAVHeader header;
-    WAVFormat format;
-    WAVData dataChunk;
-  
-    if (!ParseWAVHeader(file, header, format, dataChunk))
+    WAVInfo info;
+    SampleConvert::Format format;
+    if (!ParseWAVHeader(file, info) || !ResolveSampleFormat(info, format) || info.numChannels == 0)
     {
         return false;
     }
     
     // Store format info
-    sampleRate_ = format.sampleRate;
-    numChannels_ = format.numChannels;
-    bitsPerSample_ = format.bitsPerSample;
+    sampleRate_ = info.sampleRate;
+    numChannels_ = info.numChannels;
+    bitsPerSample_ = info.bitsPerSample;
+    sampleFormat_ = format;
+    
+    const uint64_t frameBytes = static_cast<uint64_t>(numChannels_) * SampleConvert::GetBytesPerSample(format);
+    if (info.dataSize < frameBytes)
+    {
+        return false;
+    }
     
-    // Read raw audio data
-    std::vector<uint8_t> rawData(dataChunk.dataSize);
-    file.read(reinterpret_cast<char*>(rawData.data()), dataChunk.dataSize);
+    if (progress)
+    {
+        progress->bytesTotal.store(info.dataSize - info.dataSize % frameBytes);
+    }
+    
+    if (mode == LOAD_MAPPED)
+    {
+        file.close();
+        
+        auto mapping = std::make_unique<MappedFile>();
+        if (!mapping->Open(filePath) || info.dataOffset + info.dataSize > mapping->GetSize())
+        {
+            return false;
+        }
+        
+        numFrames_ = ClampFrameCount(info.dataSize / frameBytes);
+        dataOffset_ = info.dataOffset;
+        dataSize_ = numFrames_ * frameBytes;
+        mappedFile_ = std::move(mapping);
+        mappedFile_->Prefetch(dataOffset_, kMappedBlockFrames * frameBytes);
+        loadMode_ = LOAD_MAPPED;
+        
+        // A peak file from an earlier load gives the mapping a waveform without reading its samples
+        std::shared_ptr<const PeakPyramid> stored = DecodeCache::GetShared().FindPeaks(filePath);
+        if (stored && stored->GetNumFrames() == numFrames_ && stored->GetNumChannels() == numChannels_)
+        {
+            mappedPeaks_ = std::move(stored);
+        }
+        
+        // Nothing is decoded up front - the mapping is all there is to wait for
+        if (progress)
+        {
+            progress->bytesTotal.store(dataSize_);
+            progress->bytesRead.store(dataSize_);
+            progress->SetPeaks(mappedPeaks_);
+        }
+        return true;
+    }
+    
+    // Decode in parallel straight out of a mapping of the file
+    {
+        MappedFile mapping;
+        if (mapping.Open(filePath) && info.dataOffset + info.dataSize <= mapping.GetSize())
+        {
+            return DecodeParallel(mapping, info, ResolveStorage(format, mode), progress);
+        }
+    }
     
-    if (!file)
+    // Mapping failed (e.g. no address space on 32-bit) - single-threaded read
+    if (info.dataSize > SIZE_MAX)
     {
         return false;
     }
     
-    // Convert to float
-    ConvertToFloat(rawData, bitsPerSample_);
+    const uint32_t numFrames = ClampFrameCount(info.dataSize / frameBytes);
+    auto buffer = std::make_unique<SampleBuffer>(numFrames, sampleRate_, numChannels_, bitsPerSample_,
+        ResolveStorage(format, mode));
+    PeakBuilder peaks(*buffer);
+    PublishPeaks(progress, peaks);
+    file.seekg(static_cast<std::streamoff>(info.dataOffset));
+    
+    // Read and convert whole-frame chunks so progress and cancellation stay responsive
+    const size_t chunkFrames = std::max<size_t>(1, kDecodeChunkBytes / frameBytes);
+    std::vector<uint8_t> rawData(std::min<size_t>(chunkFrames, numFrames) * frameBytes);
+    
+    for (size_t first = 0; first < numFrames; first += chunkFrames)
+    {
+        if (progress && progress->cancelRequested.load())
+        {
+            return false;
+        }
+        
+        size_t count = std::min<size_t>(chunkFrames, numFrames - first);
+        file.read(reinterpret_cast<char*>(rawData.data()), count * frameBytes);
+        if (!file)
+        {
+            return false;
+        }
+        
+        ConvertFrames(sampleFormat_, rawData.data(), *buffer, first, count);
+        peaks.MarkDecoded(static_cast<uint32_t>(first), static_cast<uint32_t>(count));
+        if (progress)
+        {
+            progress->bytesRead.fetch_add(count * frameBytes);
+            progress->samplesDecoded.fetch_add(count * numChannels_);
+        }
+    }
  
+    SetBuffer(std::move(buffer), filePath_, peaks.GetPyramid());
     return true;
 }
 
-bool AudioTrack::ParseWAVHeader(std::ifstream& file, WAVHeader& header, WAVFormat& format, WAVData& dataChunk)
+bool AudioTrack::DecodeParallel(const MappedFile& mapping, const WAVInfo& info, SampleBuffer::Storage storage, LoadProgress* progress)
 {
-  // Read RIFF header
-    file.read(reinterpret_cast<char*>(&header), sizeof(WAVHeader));
-    if (std::strncmp(header.riff, "RIFF", 4) != 0 || std::strncmp(header.wave, "WAVE", 4) != 0)
+    const size_t frameBytes = numChannels_ * SampleConvert::GetBytesPerSample(sampleFormat_);
+    const uint32_t numFrames = ClampFrameCount(info.dataSize / frameBytes);
+    auto buffer = std::make_unique<SampleBuffer>(numFrames, sampleRate_, numChannels_, bitsPerSample_, storage);
+    PeakBuilder peaks(*buffer);
+    PublishPeaks(progress, peaks);
+    
+    // Whole-frame chunks, each converted straight into its final slot in every channel.
+    // Chunk edges fall on cache lines for any storage width, so neighbouring tasks never write the same line.
+    const size_t lineFrames = SampleBuffer::kAlignment;
+    const size_t chunkFrames = std::max(lineFrames, kDecodeChunkBytes / frameBytes / lineFrames * lineFrames);
+    const size_t numChunks = (numFrames + chunkFrames - 1) / chunkFrames;
+    const uint8_t* data = mapping.GetData() + info.dataOffset;
+    const SampleConvert::Format format = sampleFormat_;
+    
+    ThreadPool::GetShared().ParallelFor(numChunks, [&](size_t chunk)
     {
-    return false;
+        // Chunks still queued when a cancel arrives are skipped
+        if (progress && progress->cancelRequested.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        
+        size_t first = chunk * chunkFrames;
+        size_t count = std::min<size_t>(chunkFrames, numFrames - first);
+        mapping.Prefetch(info.dataOffset + first * frameBytes, count * frameBytes);
+        ConvertFrames(format, data + first * frameBytes, *buffer, first, count);
+        peaks.MarkDecoded(static_cast<uint32_t>(first), static_cast<uint32_t>(count));
+        
+        if (progress)
+        {
+            progress->bytesRead.fetch_add(count * frameBytes, std::memory_order_relaxed);
+            progress->samplesDecoded.fetch_add(count * numChannels_, std::memory_order_relaxed);
+        }
+    });
+    
+    if (progress && progress->cancelRequested.load())
+    {
+        return false;
     }
     
-    // Read fmt chunk
- file.read(reinterpret_cast<char*>(&format), sizeof(WAVFormat));
-    if (std::strncmp(format.fmt, "fmt ", 4) != 0)
+    SetBuffer(std::move(buffer), filePath_, peaks.GetPyramid());
+    return true;
+}
+
+bool AudioTrack::LoadFLAC(const std::string& filePath, LoadMode mode, LoadProgress* progress)
+{
+    MappedFile mapping;
+    if (!mapping.Open(filePath) || mapping.GetSize() > SIZE_MAX ||
+        !FlacDecoder::IsFlac(mapping.GetData(), static_cast<size_t>(mapping.GetSize())))
     {
         return false;
     }
     
-    // Skip any extra format bytes
-    if (format.chunkSize > 16)
+    // The frame scan reads the whole file front to back - start paging it in now
+    mapping.Prefetch(0, mapping.GetSize());
+    return DecodeFLAC(mapping.GetData(), static_cast<size_t>(mapping.GetSize()), mode, true, progress);
+}
+
+bool AudioTrack::DecodeFLAC(const uint8_t* data, size_t size, LoadMode mode, bool parallel, LoadProgress* progress)
+{
+    FlacDecoder decoder;
+    if (!decoder.Open(data, size))
     {
-        file.seekg(format.chunkSize - 16, std::ios::cur);
+        return false;
     }
     
-    // Find data chunk
-    char chunkID[4];
-    uint32_t chunkSize;
+    // Compressed frames cannot be converted lazily, so LOAD_MAPPED decodes up front as well
+    const FlacDecoder::StreamInfo& info = decoder.GetStreamInfo();
+    sampleRate_ = info.sampleRate;
+    numChannels_ = info.numChannels;
+    bitsPerSample_ = info.bitsPerSample;
+    sampleFormat_ = info.bitsPerSample == 16 ? SampleConvert::PCM_S16 :
+        info.bitsPerSample == 24 ? SampleConvert::PCM_S24 : SampleConvert::PCM_S32;
     
-    while (file.read(chunkID, 4))
+    auto buffer = std::make_unique<SampleBuffer>(decoder.GetNumSamples(), sampleRate_, numChannels_, bitsPerSample_,
+        ResolveStorage(sampleFormat_, mode));
+    PeakBuilder peaks(*buffer);
+    PublishPeaks(progress, peaks);
+    if (!decoder.Decode(*buffer, parallel ? &ThreadPool::GetShared() : nullptr, progress, &peaks))
     {
-        file.read(reinterpret_cast<char*>(&chunkSize), sizeof(uint32_t));
+        return false;
+    }
+    
+    SetBuffer(std::move(buffer), filePath_, peaks.GetPyramid());
+    return true;
+}
+
+bool AudioTrack::ParseWAVHeader(std::istream& file, WAVInfo& info)
+{
+    file.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+    
+    // Read RIFF / RF64 / BW64 header
+    WAVHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(WAVHeader)) || std::strncmp(header.wave, "WAVE", 4) != 0)
+    {
+        return false;
+    }
+    
+    if (std::strncmp(header.riff, "RF64", 4) == 0 || std::strncmp(header.riff, "BW64", 4) == 0)
+    {
+        info.is64Bit = true;
+    }
+    else if (std::strncmp(header.riff, "RIFF", 4) != 0)
+    {
+        return false;
+    }
+    
+    // 64-bit sizes from ds64 - the data size plus any table entries for other big chunks
+    uint64_t dataSize64 = 0;
+    std::vector<std::pair<std::string, uint64_t>> sizeTable;
+    bool haveFormat = false;
+    
+    WAVChunkHeader chunk;
+    while (file.read(reinterpret_cast<char*>(&chunk), sizeof(WAVChunkHeader)))
+    {
+        const uint64_t chunkStart = static_cast<uint64_t>(file.tellg());
+        uint64_t chunkSize = chunk.size;
+        
+        if (info.is64Bit && chunk.size == 0xFFFFFFFF)
+        {
+            for (const auto& entry : sizeTable)
+            {
+                if (std::strncmp(entry.first.c_str(), chunk.id, 4) == 0)
+                {
+                    chunkSize = entry.second;
+                }
+            }
+        }
         
-        if (std::strncmp(chunkID, "data", 4) == 0)
+        if (std::strncmp(chunk.id, "ds64", 4) == 0)
         {
-            std::memcpy(dataChunk.data, chunkID, 4);
-      dataChunk.dataSize = chunkSize;
-      return true;
+            WAVDataSize64 ds64;
+            if (!info.is64Bit || chunk.size < sizeof(ds64) || !file.read(reinterpret_cast<char*>(&ds64), sizeof(ds64)))
+            {
+                return false;
+            }
+            dataSize64 = ds64.dataSize;
+            
+            for (uint32_t i = 0; i < ds64.tableLength && i < 64; ++i)
+            {
+                char id[4];
+                uint64_t size;
+                if (!file.read(id, 4) || !file.read(reinterpret_cast<char*>(&size), sizeof(size)))
+                {
+                    return false;
+                }
+                sizeTable.emplace_back(std::string(id, 4), size);
+            }
         }
-      
-        // Skip this chunk
-        file.seekg(chunkSize, std::ios::cur);
+        else if (std::strncmp(chunk.id, "fmt ", 4) == 0)
+        {
+            WAVFormat format;
+            if (chunk.size < sizeof(WAVFormat) || !file.read(reinterpret_cast<char*>(&format), sizeof(WAVFormat)))
+            {
+                return false;
+            }
+            
+            info.formatTag = format.audioFormat;
+            info.numChannels = format.numChannels;
+            info.sampleRate = format.sampleRate;
+            info.bitsPerSample = format.bitsPerSample;
+            info.validBitsPerSample = format.bitsPerSample;
+            
+            if (format.audioFormat == WAVE_FORMAT_EXTENSIBLE)
+            {
+                WAVFormatExtensible extensible;
+                if (chunk.size < sizeof(WAVFormat) + sizeof(WAVFormatExtensible) ||
+                    !file.read(reinterpret_cast<char*>(&extensible), sizeof(WAVFormatExtensible)))
+                {
+                    return false;
+                }
+                
+                // KSDATAFORMAT_SUBTYPE_* GUIDs are {tag-0000-0010-8000-00AA00389B71}
+                static const uint8_t kSubFormatSuffix[14] = {
+                    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+                if (std::memcmp(extensible.subFormat + 2, kSubFormatSuffix, sizeof(kSubFormatSuffix)) != 0)
+                {
+                    return false;
+                }
+                
+                info.formatTag = static_cast<uint16_t>(extensible.subFormat[0] | (extensible.subFormat[1] << 8));
+                info.channelMask = extensible.channelMask;
+                if (extensible.validBitsPerSample != 0)
+                {
+                    info.validBitsPerSample = extensible.validBitsPerSample;
+                }
+            }
+            haveFormat = true;
+        }
+        else if (std::strncmp(chunk.id, "data", 4) == 0)
+        {
+            if (!haveFormat)
+            {
+                return false;
+            }
+            
+            info.dataOffset = chunkStart;
+            info.dataSize = (info.is64Bit && chunk.size == 0xFFFFFFFF) ? dataSize64 : chunkSize;
+            
+            // Truncated files or writers that never patched the size: stop at end of file
+            info.dataSize = std::min(info.dataSize, fileSize - chunkStart);
+            return true;
+        }
+        
+        // Skip to the next chunk - chunks are word aligned
+        uint64_t nextChunk = chunkStart + chunkSize + (chunkSize & 1);
+        if (nextChunk >= fileSize)
+        {
+            break;
+        }
+        file.seekg(static_cast<std::streamoff>(nextChunk));
     }
     
     return false;
 }
 
-void AudioTrack::ConvertToFloat(const std::vector<uint8_t>& rawData, uint16_t bitsPerSample)
+bool AudioTrack::ResolveSampleFormat(const WAVInfo& info, SampleConvert::Format& format)
 {
-    uint32_t numSamples = static_cast<uint32_t>(rawData.size()) / (bitsPerSample / 8);
-    samples_.resize(numSamples);
+    if (info.formatTag == WAVE_FORMAT_PCM)
+    {
+        switch (info.bitsPerSample)
+        {
+        case 8: format = SampleConvert::PCM_U8; return true;
+        case 16: format = SampleConvert::PCM_S16; return true;
+        case 24: format = SampleConvert::PCM_S24; return true;
+        case 32: format = SampleConvert::PCM_S32; return true;
+        default: return false;
+        }
+    }
+    
+    if (info.formatTag == WAVE_FORMAT_IEEE_FLOAT)
+    {
+        switch (info.bitsPerSample)
+        {
+        case 32: format = SampleConvert::FLOAT32; return true;
+        case 64: format = SampleConvert::FLOAT64; return true;
+        default: return false;
+        }
+    }
     
-    if (bitsPerSample == 8)
+    // Compressed or vendor formats
+    return false;
+}
+
+SampleBuffer::Storage AudioTrack::ResolveStorage(SampleConvert::Format format, LoadMode mode)
+{
+    // Only integer sources the float kernels can decode losslessly on every read
+    if (mode == LOAD_COMPACT)
     {
-        // 8-bit: unsigned, 128 = center
- for (uint32_t i = 0; i < numSamples; ++i)
-   {
-            samples_[i] = (static_cast<float>(rawData[i]) - 128.0f) / 128.0f;
+        if (format == SampleConvert::PCM_S16)
+        {
+            return SampleBuffer::STORAGE_INT16;
+        }
+        if (format == SampleConvert::PCM_S24)
+        {
+            return SampleBuffer::STORAGE_INT24;
         }
     }
-    else if (bitsPerSample == 16)
+    return SampleBuffer::STORAGE_FLOAT32;
+}
+
+void AudioTrack::VisitSampleBlocks(const std::function<void(uint16_t, const float*, size_t)>& visitor) const
+{
+    if (loadMode_ != LOAD_MAPPED)
     {
-    // 16-bit: signed
-        const int16_t* data = reinterpret_cast<const int16_t*>(rawData.data());
-        for (uint32_t i = 0; i < numSamples; ++i)
+        for (uint16_t ch = 0; buffer_ && ch < numChannels_; ++ch)
         {
-            samples_[i] = static_cast<float>(data[i]) / 32768.0f;
-      }
+            buffer_->VisitChannel(ch, 0, numFrames_, [&visitor, ch](const float* samples, size_t count)
+            {
+                visitor(ch, samples, count);
+            });
+        }
+        return;
     }
-    else if (bitsPerSample == 24)
+    
+    // One block at a time through a scratch buffer, so a scan never holds a float copy of the file
+    const size_t frameBytes = numChannels_ * SampleConvert::GetBytesPerSample(sampleFormat_);
+    const uint64_t blockBytes = static_cast<uint64_t>(kMappedBlockFrames) * frameBytes;
+    std::vector<float> block(static_cast<size_t>(kMappedBlockFrames) * numChannels_);
+    std::vector<float*> dest(numChannels_);
+    for (uint16_t ch = 0; ch < numChannels_; ++ch)
     {
-      // 24-bit: signed, stored in 3 bytes
-      for (uint32_t i = 0; i < numSamples; ++i)
- {
-          int32_t value = (rawData[i * 3 + 2] << 16) | (rawData[i * 3 + 1] << 8) | rawData[i * 3];
-            
-            // Sign extend
-            if (value & 0x800000)
-         {
-        value |= 0xFF000000;
-            }
-        
-      samples_[i] = static_cast<float>(value) / 8388608.0f;
-   }
- }
-    else if (bitsPerSample == 32)
-    {
-        // 32-bit: could be int or float
-        const int32_t* dataInt = reinterpret_cast<const int32_t*>(rawData.data());
-      const float* dataFloat = reinterpret_cast<const float*>(rawData.data());
-        
-        // Heuristic: if first sample is between -1 and 1, assume float
-        if (dataFloat[0] >= -1.0f && dataFloat[0] <= 1.0f)
+        dest[ch] = block.data() + static_cast<size_t>(ch) * kMappedBlockFrames;
+    }
+    
+    for (uint32_t firstFrame = 0; firstFrame < numFrames_; firstFrame += kMappedBlockFrames)
     {
-  samples_.assign(dataFloat, dataFloat + numSamples);
+        // Start paging in the next block while this one is converted and visited
+        const uint64_t offset = dataOffset_ + static_cast<uint64_t>(firstFrame) * frameBytes;
+        if (numFrames_ - firstFrame > kMappedBlockFrames)
+        {
+            mappedFile_->Prefetch(offset + blockBytes, blockBytes);
+        }
+        
+        uint32_t frames = std::min(kMappedBlockFrames, numFrames_ - firstFrame);
+        SampleConvert::ToFloatPlanar(sampleFormat_, mappedFile_->GetData() + offset, dest.data(), numChannels_, frames);
+        for (uint16_t ch = 0; ch < numChannels_; ++ch)
+        {
+            visitor(ch, dest[ch], frames);
+        }
+    }
 }
-else
-  {
-        for (uint32_t i = 0; i < numSamples; ++i)
-          {
-       samples_[i] = static_cast<float>(dataInt[i]) / 2147483648.0f;
-      }
+
+void AudioTrack::ScanFrames(uint32_t startFrame, uint32_t endFrame, uint32_t channelMask, std::vector<float>& scratch,
+                            float& minValue, float& maxValue, double& sumSquares) const
+{
+    // Through ReadFrames, which converts into scratch - mapped tracks keep nothing converted
+    const uint32_t chunkFrames = static_cast<uint32_t>(scratch.size() / numChannels_);
+    for (uint32_t first = startFrame; first < endFrame; )
+    {
+        uint32_t count = ReadFrames(first, std::min(chunkFrames, endFrame - first), scratch.data());
+        if (count == 0)
+        {
+            return;
+        }
+        
+        const float* frame = scratch.data();
+        for (uint32_t i = 0; i < count; ++i, frame += numChannels_)
+        {
+            for (uint16_t ch = 0; ch < numChannels_; ++ch)
+            {
+                if (ch < 32 ? (channelMask & (1u << ch)) != 0 : channelMask == PeakPyramid::kAllChannels)
+                {
+                    minValue = std::min(minValue, frame[ch]);
+                    maxValue = std::max(maxValue, frame[ch]);
+                    sumSquares += static_cast<double>(frame[ch]) * frame[ch];
+                }
+            }
         }
+        first += count;
+    }
+}
+
+void AudioTrack::ReleaseMapping()
+{
+    mappedFile_.reset();
+    mappedPeaks_.reset();
+    dataOffset_ = 0;
+    dataSize_ = 0;
+    std::atomic_store(&mappedStats_, std::shared_ptr<const MappedStatistics>());
+    loadMode_ = LOAD_EAGER;
+}
+
+uint32_t AudioTrack::ReadFrames(uint32_t startFrame, uint32_t numFrames, float* dest) const
+{
+    if (startFrame >= numFrames_)
+    {
+        return 0;
     }
+    
+    if (loadMode_ != LOAD_MAPPED)
+    {
+        return buffer_->ReadInterleaved(startFrame, numFrames, dest);
+    }
+    
+    // The file is interleaved already - convert straight into dest, nothing is cached
+    numFrames = std::min(numFrames, numFrames_ - startFrame);
+    size_t firstSample = static_cast<size_t>(startFrame) * numChannels_;
+    const uint8_t* src = mappedFile_->GetData() + dataOffset_ + firstSample * SampleConvert::GetBytesPerSample(sampleFormat_);
+    SampleConvert::ToFloat(sampleFormat_, src, dest, static_cast<size_t>(numFrames) * numChannels_);
+    return numFrames;
 }
 
 double AudioTrack::GetDurationSeconds() const
 {
-    if (samples_.empty() || sampleRate_ == 0)
+    if (numFrames_ == 0 || sampleRate_ == 0)
     {
         return 0.0;
   }
@@ -239,18 +826,21 @@ double AudioTrack::GetDurationSeconds() const
 
 float AudioTrack::GetSample(uint32_t index, uint16_t channel) const
 {
-    if (channel >= numChannels_ || samples_.empty())
+    if (channel >= numChannels_ || index >= numFrames_)
     {
         return 0.0f;
     }
     
-    uint32_t sampleIndex = index * numChannels_ + channel;
-    if (sampleIndex >= samples_.size())
+    if (loadMode_ == LOAD_MAPPED)
     {
-  return 0.0f;
+        const size_t sampleIndex = static_cast<size_t>(index) * numChannels_ + channel;
+        float sample = 0.0f;
+        SampleConvert::ToFloat(sampleFormat_, mappedFile_->GetData() + dataOffset_ +
+            sampleIndex * SampleConvert::GetBytesPerSample(sampleFormat_), &sample, 1);
+        return sample;
     }
     
-    return samples_[sampleIndex];
+    return buffer_->GetSample(index, channel);
 }
 
 void AudioTrack::SetVolume(float volume)
@@ -264,11 +854,17 @@ void AudioTrack::SetPan(float pan)
 }
 
 void AudioTrack::GetPeakAmplitudes(std::vector<float>& minValues, std::vector<float>& maxValues, uint32_t numPoints) const
+{
+    GetPeakAmplitudes(0, numFrames_, numPoints, PeakPyramid::kAllChannels, minValues, maxValues);
+}
+
+void AudioTrack::GetPeakAmplitudes(uint32_t startFrame, uint32_t endFrame, uint32_t numPoints, uint32_t channelMask,
+                                   std::vector<float>& minValues, std::vector<float>& maxValues) const
 {
     minValues.clear();
     maxValues.clear();
     
-    if (samples_.empty() || numPoints == 0)
+    if (numFrames_ == 0 || numPoints == 0 || startFrame >= endFrame)
     {
         return;
     }
@@ -276,64 +872,229 @@ void AudioTrack::GetPeakAmplitudes(std::vector<float>& minValues, std::vector<fl
     minValues.resize(numPoints, 0.0f);
     maxValues.resize(numPoints, 0.0f);
     
-    uint32_t numSamples = GetNumSamples();
-    uint32_t samplesPerPoint = std::max(1u, numSamples / numPoints);
+    // Answered from the peak pyramid in O(points * levels), plus the few frames at each bin edge.
+    // Channels are drawn as their common envelope - averaging them would hide out-of-phase content.
+    // Without a buffer the pyramid rounds bin edges to its entries, so mapped tracks only use it for wide bins.
+    std::shared_ptr<const PeakPyramid> peaks = GetPeakPyramid();
+    if (peaks && (buffer_ || (endFrame - startFrame) / numPoints >= PeakPyramid::kExactEdgeFrames))
+    {
+        peaks->GetRangePeaks(buffer_.get(), startFrame, endFrame, numPoints, channelMask, minValues.data(), maxValues.data());
+        return;
+    }
     
+    // Mapped tracks without a peak file, or zoomed in - read the frames of the range directly
+    std::vector<float> scratch(static_cast<size_t>(kScanFrames) * numChannels_);
     for (uint32_t i = 0; i < numPoints; ++i)
     {
-        uint32_t startSample = i * samplesPerPoint;
-        uint32_t endSample = std::min(startSample + samplesPerPoint, numSamples);
+        uint32_t startSample = PeakPyramid::GetBinStart(startFrame, endFrame, numPoints, i);
+        uint32_t endSample = std::max(startSample + 1, PeakPyramid::GetBinStart(startFrame, endFrame, numPoints, i + 1));
+        endSample = std::min(endSample, numFrames_);
     
         float minVal = 0.0f;
-float maxVal = 0.0f;
-    
-        for (uint32_t j = startSample; j < endSample; ++j)
-        {
-      // Average all channels for simplicity
-            float avgSample = 0.0f;
-       for (uint16_t ch = 0; ch < numChannels_; ++ch)
-            {
-   avgSample += GetSample(j, ch);
-            }
-            avgSample /= numChannels_;
-  
-            minVal = std::min(minVal, avgSample);
-       maxVal = std::max(maxVal, avgSample);
-        }
+        float maxVal = 0.0f;
+        double sumSquares = 0.0;
+        ScanFrames(startSample, endSample, channelMask, scratch, minVal, maxVal, sumSquares);
         
-   minValues[i] = minVal;
-     maxValues[i] = maxVal;
+        minValues[i] = minVal;
+        maxValues[i] = maxVal;
     }
 }
 
-float AudioTrack::GetPeakAmplitude() const
+std::shared_ptr<const PeakPyramid> AudioTrack::GetPeakPyramid() const
 {
-    float peak = 0.0f;
-    for (float sample : samples_)
+    if (buffer_ && buffer_->GetAnalysis())
+    {
+        return buffer_->GetAnalysis()->peaks;
+    }
+    return mappedPeaks_;
+}
+
+float AudioTrack::GetPeakAmplitude() const
 {
-        peak = std::max(peak, std::abs(sample));
+    if (buffer_ && buffer_->GetAnalysis())
+    {
+        return buffer_->GetAnalysis()->peak;
     }
-    return peak;
+    if (numFrames_ == 0)
+    {
+        return 0.0f;
+    }
+    return GetMappedStatistics()->peak;
 }
 
 float AudioTrack::GetRMSAmplitude() const
 {
-    if (samples_.empty())
+    if (buffer_ && buffer_->GetAnalysis())
+    {
+        return buffer_->GetAnalysis()->rms;
+    }
+    if (numFrames_ == 0)
     {
         return 0.0f;
     }
+    return GetMappedStatistics()->rms;
+}
+
+void AudioTrack::GetRangeStatistics(uint32_t startFrame, uint32_t endFrame, float& peak, float& rms) const
+{
+    peak = 0.0f;
+    rms = 0.0f;
+    endFrame = std::min(endFrame, numFrames_);
+    if (startFrame >= endFrame)
+    {
+        return;
+    }
+    
+    std::shared_ptr<const PeakPyramid> peaks = GetPeakPyramid();
+    if (peaks && buffer_)
+    {
+        PeakPyramid::Statistics stats = peaks->GetRangeStatistics(buffer_.get(), startFrame, endFrame);
+        peak = stats.peak;
+        rms = stats.rms;
+        return;
+    }
+    
+    // Mapped tracks read the frames outside whole level-0 entries, and take the entries from a peak file if there is one
+    uint32_t innerStart = endFrame;
+    uint32_t innerEnd = endFrame;
+    double sumSquares = 0.0;
+    if (peaks)
+    {
+        innerStart = std::min(endFrame, (startFrame + PeakPyramid::kBaseFrames - 1) / PeakPyramid::kBaseFrames * PeakPyramid::kBaseFrames);
+        innerEnd = endFrame == numFrames_ ? endFrame : endFrame / PeakPyramid::kBaseFrames * PeakPyramid::kBaseFrames;
+        innerEnd = std::max(innerStart, innerEnd);
+        if (innerStart < innerEnd)
+        {
+            PeakPyramid::Statistics stats = peaks->GetRangeStatistics(nullptr, innerStart, innerEnd);
+            peak = stats.peak;
+            sumSquares = static_cast<double>(stats.rms) * stats.rms * (static_cast<double>(innerEnd - innerStart) * numChannels_);
+        }
+    }
+    std::vector<float> scratch(static_cast<size_t>(kScanFrames) * numChannels_);
+    float minValue = 0.0f;
+    float maxValue = 0.0f;
+    ScanFrames(startFrame, innerStart, PeakPyramid::kAllChannels, scratch, minValue, maxValue, sumSquares);
+    ScanFrames(innerEnd, endFrame, PeakPyramid::kAllChannels, scratch, minValue, maxValue, sumSquares);
+    peak = std::max(peak, std::max(-minValue, maxValue));
+    rms = static_cast<float>(std::sqrt(sumSquares / (static_cast<double>(endFrame - startFrame) * numChannels_)));
+}
+
+std::shared_ptr<const AudioTrack::MappedStatistics> AudioTrack::GetMappedStatistics() const
+{
+    std::shared_ptr<const MappedStatistics> stats = std::atomic_load(&mappedStats_);
+    if (stats)
+    {
+        return stats;
+    }
     
-    float sumSquares = 0.0f;
-    for (float sample : samples_)
+    auto computed = std::make_shared<MappedStatistics>();
+    if (mappedPeaks_)
+    {
+        // A peak file holds both already
+        PeakPyramid::Statistics stored = mappedPeaks_->GetStatistics();
+        computed->peak = stored.peak;
+        computed->rms = stored.rms;
+    }
+    else
     {
-        sumSquares += sample * sample;
+        // One pass for both; blocks are summed in float and added up in double, so long files keep their precision
+        float peak = 0.0f;
+        double sumSquares = 0.0;
+        VisitSampleBlocks([&peak, &sumSquares](uint16_t, const float* samples, size_t count)
+        {
+            float minValue = 0.0f;
+            float maxValue = 0.0f;
+            float blockSum = 0.0f;
+            SampleConvert::ReducePeaks(samples, count, &minValue, &maxValue, &blockSum);
+            peak = std::max(peak, std::max(-minValue, maxValue));
+            sumSquares += blockSum;
+        });
+        computed->peak = peak;
+        computed->rms = static_cast<float>(std::sqrt(sumSquares / (static_cast<double>(numFrames_) * numChannels_)));
     }
     
-    return std::sqrt(sumSquares / samples_.size());
+    stats = computed;
+    std::atomic_store(&mappedStats_, stats);
+    return stats;
+}
+
+float AudioTrack::GetLoudness() const
+{
+    if (buffer_ && buffer_->GetAnalysis())
+    {
+        return buffer_->GetAnalysis()->loudness;
+    }
+    return AudioAnalysis::kSilence;
+}
+
+void AudioTrack::AdoptAudio(AudioTrack& loaded)
+{
+    ReleaseMapping();
+    
+    name_ = loaded.name_;
+    filePath_ = loaded.filePath_;
+    buffer_ = std::move(loaded.buffer_);
+    sampleRate_ = loaded.sampleRate_;
+    numChannels_ = loaded.numChannels_;
+    bitsPerSample_ = loaded.bitsPerSample_;
+    numFrames_ = loaded.numFrames_;
+    sampleFormat_ = loaded.sampleFormat_;
+    
+    // The peak file belongs to the mapping, so both move together
+    loadMode_ = loaded.loadMode_;
+    mappedFile_ = std::move(loaded.mappedFile_);
+    dataOffset_ = loaded.dataOffset_;
+    dataSize_ = loaded.dataSize_;
+    mappedPeaks_ = std::move(loaded.mappedPeaks_);
+    
+    loaded.Clear();
 }
 
 void AudioTrack::Clear()
 {
-    samples_.clear();
+    ReleaseMapping();
+    buffer_.reset();
     filePath_.clear();
+    numFrames_ = 0;
+}
+
+SampleSpan AudioTrack::GetChannel(uint16_t channel) const
+{
+    if (!buffer_ || channel >= numChannels_)
+    {
+        return SampleSpan();
+    }
+    return buffer_->GetChannel(channel);
+}
+
+void AudioTrack::SetBuffer(std::unique_ptr<SampleBuffer> buffer, const std::string& sourcePath,
+                           std::shared_ptr<const PeakPyramid> peaks)
+{
+    if (!buffer->GetAnalysis())
+    {
+        // Peaks go on disk and are mapped back rather than held on the heap - kept from an earlier load, or stored now
+        if (!sourcePath.empty())
+        {
+            std::shared_ptr<const PeakPyramid> stored = DecodeCache::GetShared().FindPeaks(sourcePath);
+            if (stored && stored->GetNumFrames() == buffer->GetNumFrames() && stored->GetNumChannels() == buffer->GetNumChannels())
+            {
+                peaks = std::move(stored);
+            }
+            else
+            {
+                peaks = DecodeCache::GetShared().StorePeaks(sourcePath, std::move(peaks));
+            }
+        }
+        buffer->SetAnalysis(AudioAnalysis::Analyze(*buffer, std::move(peaks)));
+    }
+    
+    // Decoded file data is registered under its path so the next load of it is free,
+    // in this session through the pool and in the next through the decode cache. The cache
+    // writes it out in the background - the track is ready now.
+    buffer_ = SamplePool::GetShared().Intern(std::move(buffer), sourcePath);
+    numFrames_ = buffer_->GetNumFrames();
+    if (!sourcePath.empty() && !buffer_->IsMapped())
+    {
+        DecodeCache::GetShared().StoreAsync(sourcePath, buffer_);
+    }
 }
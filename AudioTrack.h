@@ -5,56 +5,141 @@
 #include <cstdint>
 #include <memory>
 #include <fstream>
+#include <istream>
+#include <atomic>
+#include <functional>
+#include "SampleConvert.h"
+#include "SampleBuffer.h"
+
+class MappedFile;
+class PeakPyramid;
+
+// WAV format tags
+enum WAVFormatTag : uint16_t
+{
+    WAVE_FORMAT_PCM = 0x0001,
+    WAVE_FORMAT_IEEE_FLOAT = 0x0003,
+    WAVE_FORMAT_EXTENSIBLE = 0xFFFE
+};
 
 // WAV file header structures
 #pragma pack(push, 1)
 struct WAVHeader
 {
-    char riff[4]; // "RIFF"
-    uint32_t fileSize;      // File size - 8
+    char riff[4]; // "RIFF", or "RF64" / "BW64" when sizes live in the ds64 chunk
+    uint32_t fileSize;      // File size - 8 (0xFFFFFFFF for RF64/BW64)
     char wave[4];           // "WAVE"
 };
 
+struct WAVChunkHeader
+{
+    char id[4];
+    uint32_t size;          // 0xFFFFFFFF for RF64 chunks sized by ds64
+};
+
 struct WAVFormat
 {
-    char fmt[4];     // "fmt "
-    uint32_t chunkSize; // 16 for PCM
-    uint16_t audioFormat;   // 1 for PCM
+    uint16_t audioFormat;   // WAVFormatTag
     uint16_t numChannels;   // 1 = mono, 2 = stereo
     uint32_t sampleRate;    // 44100, 48000, etc.
     uint32_t byteRate;      // sampleRate * numChannels * bitsPerSample/8
     uint16_t blockAlign;    // numChannels * bitsPerSample/8
-    uint16_t bitsPerSample; // 8, 16, 24, 32
+    uint16_t bitsPerSample; // 8, 16, 24, 32, 64 (container size)
 };
 
-struct WAVData
+struct WAVFormatExtensible
 {
-    char data[4];           // "data"
-    uint32_t dataSize;      // Size of data section
+    uint16_t extensionSize;      // 22
+    uint16_t validBitsPerSample; // May be less than the container size
+    uint32_t channelMask;        // Speaker positions
+    uint8_t subFormat[16];       // GUID - first two bytes hold the real format tag
+};
+
+struct WAVDataSize64
+{
+    uint64_t riffSize;
+    uint64_t dataSize;
+    uint64_t sampleCount;
+    uint32_t tableLength;        // Entries of other 64-bit chunk sizes that follow
 };
 #pragma pack(pop)
 
+// Everything the loader needs from a parsed WAV/RF64/BW64 header
+struct WAVInfo
+{
+    uint16_t formatTag = 0;          // Resolved - EXTENSIBLE is replaced by its sub-format
+    uint16_t numChannels = 0;
+    uint32_t sampleRate = 0;
+    uint16_t bitsPerSample = 0;      // Container bits
+    uint16_t validBitsPerSample = 0;
+    uint32_t channelMask = 0;
+    uint64_t dataOffset = 0;         // Byte offset of the first sample in the file
+    uint64_t dataSize = 0;           // Clamped to what the file actually holds
+    bool is64Bit = false;            // RF64 or BW64
+};
+
+// Shared between a background load and whoever watches it
+struct LoadProgress
+{
+    std::atomic<uint64_t> bytesTotal{ 0 };     // Sample data bytes, known once the header is parsed
+    std::atomic<uint64_t> bytesRead{ 0 };
+    std::atomic<uint64_t> samplesDecoded{ 0 };
+    std::atomic<bool> cancelRequested{ false };
+
+    // Peaks of the part decoded so far, so the waveform can be drawn while it loads
+    void SetPeaks(std::shared_ptr<const PeakPyramid> peaks) { std::atomic_store(&peaks_, std::move(peaks)); }
+    std::shared_ptr<const PeakPyramid> GetPeaks() const { return std::atomic_load(&peaks_); }
+
+private:
+    std::shared_ptr<const PeakPyramid> peaks_;
+};
+
 // Audio track class - represents a single audio track with WAV data
 class AudioTrack
 {
 public:
+    // How LoadFromFile brings sample data into memory
+    enum LoadMode
+    {
+        LOAD_EAGER,   // Convert the whole file into a pooled SampleBuffer up front
+        LOAD_MAPPED,  // Keep PCM in the page cache, convert to float on every read - nothing converted is kept
+        LOAD_COMPACT  // Like LOAD_EAGER, but 16/24-bit PCM stays native and is decoded per block on read
+    };
+
+    // Frames converted (and prefetched) at a time when a whole LOAD_MAPPED track is scanned
+    static constexpr uint32_t kMappedBlockFrames = 16384;
+
     AudioTrack();
     ~AudioTrack();
 
-    // Load WAV file
-    bool LoadFromFile(const std::string& filePath);
+    // Load WAV or FLAC file. progress is optional; a cancelled load returns false and leaves the track empty.
+    // A WAV or FLAC file that fails to decode (bad frames, CRC errors, unsupported formats) returns false too;
+    // only files neither decoder recognises fall back to a test tone.
+    bool LoadFromFile(const std::string& filePath, LoadMode mode = LOAD_EAGER, LoadProgress* progress = nullptr);
   bool LoadFromMemory(const float* samples, uint32_t numSamples, uint32_t sampleRate, uint16_t channels);
     
+    // Decode a WAV or FLAC file image that was already read into memory, single-threaded on the
+    // calling thread. Unlike LoadFromFile there is no test tone fallback.
+    bool LoadFromEncoded(const std::string& filePath, const uint8_t* data, size_t size, LoadProgress* progress = nullptr);
+    
     // Audio properties
     uint32_t GetSampleRate() const { return sampleRate_; }
     uint16_t GetNumChannels() const { return numChannels_; }
     uint16_t GetBitsPerSample() const { return bitsPerSample_; }
-    uint32_t GetNumSamples() const { return static_cast<uint32_t>(samples_.size() / numChannels_); }
+    uint32_t GetNumSamples() const { return numFrames_; }
     double GetDurationSeconds() const;
     
-    // Sample access
-  const std::vector<float>& GetSamples() const { return samples_; }
+    // Sample access - storage is planar, one contiguous array per channel.
+    // GetChannel() is empty for mapped and compact tracks - use GetSample() or ReadFrames() to reach every sample
+    SampleSpan GetChannel(uint16_t channel) const;
+    std::shared_ptr<const SampleBuffer> GetBuffer() const { return buffer_; } // nullptr for mapped tracks
     float GetSample(uint32_t index, uint16_t channel) const;
+    bool IsMapped() const { return loadMode_ == LOAD_MAPPED; }
+    bool IsCompact() const { return buffer_ && buffer_->IsCompact(); }
+
+    // Copy interleaved frames into dest (device/file boundary), returns the number of frames copied.
+    // Mapped tracks decode straight from the mapping without caching the result.
+    uint32_t ReadFrames(uint32_t startFrame, uint32_t numFrames, float* dest) const;
     
     // Track properties
     const std::string& GetName() const { return name_; }
@@ -74,24 +159,56 @@ public:
     bool IsSoloed() const { return soloed_; }
     void SetSoloed(bool soloed) { soloed_ = soloed; }
   
-    // Waveform analysis
+    // Waveform analysis. GetPeakAmplitudes() gives the envelope of all channels over the whole track.
     void GetPeakAmplitudes(std::vector<float>& minValues, std::vector<float>& maxValues, uint32_t numPoints) const;
+    // Envelope of the channels in channelMask over [startFrame, endFrame) in numPoints bins with fractional
+    // edges (see PeakPyramid::GetRangePeaks). Only frames inside the range are read.
+    void GetPeakAmplitudes(uint32_t startFrame, uint32_t endFrame, uint32_t numPoints, uint32_t channelMask,
+                           std::vector<float>& minValues, std::vector<float>& maxValues) const;
+    std::shared_ptr<const PeakPyramid> GetPeakPyramid() const; // Mapped tracks only have one from a peak file
+    // Whole-track statistics are computed once per buffer - by the loader, or for mapped tracks on first use
     float GetPeakAmplitude() const;
     float GetRMSAmplitude() const;
+    float GetLoudness() const; // Integrated LUFS, AudioAnalysis::kSilence if not analyzed (mapped tracks)
+    // Peak and RMS of every channel over [startFrame, endFrame), from the peak pyramid plus the frames at its
+    // edges. Mapped tracks read the range, or only its edges if they have a peak file.
+    void GetRangeStatistics(uint32_t startFrame, uint32_t endFrame, float& peak, float& rms) const;
+    
+    // Take over the audio data, format and file of a track loaded elsewhere.
+    // Mix settings (volume, pan, mute, solo) stay as they are.
+    void AdoptAudio(AudioTrack& loaded);
+
     
     // Clear audio data
     void Clear();
-    bool IsEmpty() const { return samples_.empty(); }
+    bool IsEmpty() const { return numFrames_ == 0; }
 
 private:
     std::string name_;
     std::string filePath_;
     
     // Audio data
-    std::vector<float> samples_; // Normalized float samples [-1.0, 1.0]
+    std::shared_ptr<const SampleBuffer> buffer_; // Normalized float samples [-1.0, 1.0], shared via SamplePool
     uint32_t sampleRate_;
     uint16_t numChannels_;
     uint16_t bitsPerSample_;
+    uint32_t numFrames_;
+    SampleConvert::Format sampleFormat_; // Packed encoding of the source data
+    
+    // Memory-mapped source (LOAD_MAPPED only)
+    LoadMode loadMode_;
+    std::unique_ptr<MappedFile> mappedFile_;
+    uint64_t dataOffset_;
+    uint64_t dataSize_;
+    struct MappedStatistics
+    {
+        float peak;
+        float rms;
+    };
+    // Statistics of the mapping, computed on first use. Accessed with std::atomic_load/atomic_store, so
+    // concurrent const readers are safe; they may both compute it, and either result is kept.
+    mutable std::shared_ptr<const MappedStatistics> mappedStats_;
+    std::shared_ptr<const PeakPyramid> mappedPeaks_; // From a peak file of an earlier load, if there is one
     
     // Track properties
     float volume_;  // 0.0 to 1.0
@@ -100,7 +217,18 @@ private:
     bool soloed_;
     
 // Helper methods
-    bool LoadWAV(const std::string& filePath);
-    bool ParseWAVHeader(std::ifstream& file, WAVHeader& header, WAVFormat& format, WAVData& dataChunk);
-    void ConvertToFloat(const std::vector<uint8_t>& rawData, uint16_t bitsPerSample);
+    bool LoadWAV(const std::string& filePath, LoadMode mode, LoadProgress* progress);
+    bool DecodeParallel(const MappedFile& mapping, const WAVInfo& info, SampleBuffer::Storage storage, LoadProgress* progress);
+    bool LoadFLAC(const std::string& filePath, LoadMode mode, LoadProgress* progress);
+    bool DecodeFLAC(const uint8_t* data, size_t size, LoadMode mode, bool parallel, LoadProgress* progress);
+    static bool ParseWAVHeader(std::istream& file, WAVInfo& info);
+    static bool ResolveSampleFormat(const WAVInfo& info, SampleConvert::Format& format);
+    static SampleBuffer::Storage ResolveStorage(SampleConvert::Format format, LoadMode mode);
+    void ScanFrames(uint32_t startFrame, uint32_t endFrame, uint32_t channelMask, std::vector<float>& scratch,
+                    float& minValue, float& maxValue, double& sumSquares) const;
+    void VisitSampleBlocks(const std::function<void(uint16_t, const float*, size_t)>& visitor) const; // (channel, samples, count)
+    void ReleaseMapping();
+    std::shared_ptr<const MappedStatistics> GetMappedStatistics() const;
+    void SetBuffer(std::unique_ptr<SampleBuffer> buffer, const std::string& sourcePath,
+                   std::shared_ptr<const PeakPyramid> peaks = nullptr);
 };
@@ -0,0 +1,468 @@
+#include "BatchImporter.h"
+#include "AudioTrack.h"
+#include "SequencerEngine.h"
+#include "SamplePool.h"
+#include "DecodeCache.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+
+// Bytes per read call - big enough for sequential throughput, small enough for live statistics
+static const size_t kReadBlockBytes = 1024 * 1024;
+
+static int64_t NanosecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+BatchImporter::BatchImporter()
+    : nextFile_(0)
+    , cancelled_(false)
+    , activeReaders_(0)
+    , activeDecoders_(0)
+    , queuedBytes_(0)
+    , finishNanoseconds_(0)
+    , filesRead_(0)
+    , filesDecoded_(0)
+    , filesFailed_(0)
+    , filesShared_(0)
+    , bytesRead_(0)
+    , samplesDecoded_(0)
+    , readNanoseconds_(0)
+    , decodeNanoseconds_(0)
+{
+}
+
+BatchImporter::~BatchImporter()
+{
+    Cancel();
+    JoinWorkers();
+}
+
+bool BatchImporter::FindAudioFiles(const std::string& directory, std::vector<std::string>& files)
+{
+    std::error_code error;
+    std::filesystem::directory_iterator it(directory, error);
+    if (error)
+    {
+        printf("Cannot open directory: %s\n", directory.c_str());
+        return false;
+    }
+
+    for (; it != std::filesystem::directory_iterator(); it.increment(error))
+    {
+        if (error)
+        {
+            break;
+        }
+        if (!it->is_regular_file(error))
+        {
+            continue;
+        }
+
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension == ".wav" || extension == ".flac")
+        {
+            files.push_back(it->path().string());
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+    return true;
+}
+
+bool BatchImporter::Start(const std::vector<std::string>& files, const Settings& settings)
+{
+    if (IsRunning())
+    {
+        return false;
+    }
+    JoinWorkers();
+
+    settings_ = settings;
+    settings_.maxConcurrentReads = std::max(1u, settings_.maxConcurrentReads);
+    if (settings_.maxConcurrentDecodes == 0)
+    {
+        settings_.maxConcurrentDecodes = std::max(1u, std::thread::hardware_concurrency());
+    }
+    settings_.maxQueuedFiles = std::max(1u, settings_.maxQueuedFiles);
+    settings_.maxQueuedBytes = std::max<uint64_t>(1, settings_.maxQueuedBytes);
+
+    files_ = files;
+    readQueue_.clear();
+    queuedBytes_ = 0;
+    nextFile_ = 0;
+    cancelled_ = false;
+    finishNanoseconds_ = files_.empty() ? 1 : 0;
+    filesRead_ = 0;
+    filesDecoded_ = 0;
+    filesFailed_ = 0;
+    filesShared_ = 0;
+    bytesRead_ = 0;
+    samplesDecoded_ = 0;
+    readNanoseconds_ = 0;
+    decodeNanoseconds_ = 0;
+    startTime_ = std::chrono::steady_clock::now();
+
+    if (files_.empty())
+    {
+        return true;
+    }
+
+    // No point in more workers than files
+    uint32_t numFiles = static_cast<uint32_t>(std::min<size_t>(files_.size(), UINT32_MAX));
+    uint32_t numReaders = std::min(settings_.maxConcurrentReads, numFiles);
+    uint32_t numDecoders = std::min(settings_.maxConcurrentDecodes, numFiles);
+
+    printf("Importing %zu files (%u readers, %u decoders)\n", files_.size(), numReaders, numDecoders);
+
+    activeReaders_ = numReaders;
+    activeDecoders_ = numDecoders;
+    for (uint32_t i = 0; i < numReaders; ++i)
+    {
+        readers_.emplace_back(&BatchImporter::ReaderMain, this);
+    }
+    for (uint32_t i = 0; i < numDecoders; ++i)
+    {
+        decoders_.emplace_back(&BatchImporter::DecoderMain, this);
+    }
+    return true;
+}
+
+bool BatchImporter::StartDirectory(const std::string& directory, const Settings& settings)
+{
+    std::vector<std::string> files;
+    if (!FindAudioFiles(directory, files))
+    {
+        return false;
+    }
+    return Start(files, settings);
+}
+
+uint32_t BatchImporter::Poll(SequencerEngine& engine)
+{
+    std::deque<DecodedFile> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished.swap(decoded_);
+    }
+
+    uint32_t created = 0;
+    for (DecodedFile& file : finished)
+    {
+        auto player = std::make_shared<AudioPlayer>();
+        if (!player->LoadAudioData(std::move(file.data)))
+        {
+            continue;
+        }
+
+        auto channel = engine.CreateChannel(file.name);
+        engine.AssignPlayerToChannel(channel->GetChannelId(), player);
+        ++created;
+    }
+    return created;
+}
+
+void BatchImporter::Cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        for (const ReadFile& file : readQueue_)
+        {
+            queuedBytes_ -= file.reservedBytes;
+        }
+        readQueue_.clear();
+        decoded_.clear();
+    }
+    queueChanged_.notify_all();
+}
+
+bool BatchImporter::IsRunning() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return activeReaders_ > 0 || activeDecoders_ > 0 || !decoded_.empty();
+}
+
+BatchImporter::Stats BatchImporter::GetStats() const
+{
+    Stats stats;
+    stats.filesTotal = static_cast<uint32_t>(files_.size());
+    stats.filesRead = filesRead_.load();
+    stats.filesDecoded = filesDecoded_.load();
+    stats.filesFailed = filesFailed_.load();
+    stats.filesShared = filesShared_.load();
+    stats.bytesRead = bytesRead_.load();
+    stats.samplesDecoded = samplesDecoded_.load();
+    stats.readBusySeconds = readNanoseconds_.load() * 1e-9;
+    stats.decodeBusySeconds = decodeNanoseconds_.load() * 1e-9;
+
+    int64_t finish = finishNanoseconds_.load();
+    stats.elapsedSeconds = (finish != 0 ? finish : NanosecondsSince(startTime_)) * 1e-9;
+    if (stats.elapsedSeconds > 0.0)
+    {
+        stats.readMegabytesPerSecond = stats.bytesRead / (1024.0 * 1024.0) / stats.elapsedSeconds;
+        stats.decodeMegasamplesPerSecond = stats.samplesDecoded / 1e6 / stats.elapsedSeconds;
+        stats.filesPerSecond = stats.filesDecoded / stats.elapsedSeconds;
+    }
+    return stats;
+}
+
+void BatchImporter::PrintStats() const
+{
+    Stats stats = GetStats();
+    printf("Batch import: %u/%u files decoded, %u shared from the sample pool, %u failed, %.2fs\n",
+        stats.filesDecoded, stats.filesTotal, stats.filesShared, stats.filesFailed, stats.elapsedSeconds);
+    printf("  Read:   %.1f MB, %.1f MB/s, %.2fs busy\n",
+        stats.bytesRead / (1024.0 * 1024.0), stats.readMegabytesPerSecond, stats.readBusySeconds);
+    printf("  Decode: %.1f Msamples, %.1f Msamples/s, %.2fs busy\n",
+        stats.samplesDecoded / 1e6, stats.decodeMegasamplesPerSecond, stats.decodeBusySeconds);
+    printf("  %.1f files/s\n", stats.filesPerSecond);
+}
+
+void BatchImporter::ReaderMain()
+{
+    for (;;)
+    {
+        // Wait for room before claiming a file; ReserveBytes() may still hold it back for memory
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queueChanged_.wait(lock, [this]()
+            {
+                return cancelled_ || readQueue_.size() < settings_.maxQueuedFiles;
+            });
+        }
+
+        size_t index = nextFile_.fetch_add(1);
+        if (cancelled_ || index >= files_.size())
+        {
+            break;
+        }
+
+        // Files already in the sample pool or the decode cache skip both stages
+        std::shared_ptr<const SampleBuffer> pooled = SamplePool::GetShared().FindFile(files_[index], false);
+        if (!pooled)
+        {
+            std::unique_ptr<SampleBuffer> cached = DecodeCache::GetShared().Find(files_[index], false);
+            if (cached)
+            {
+                pooled = SamplePool::GetShared().Intern(std::move(cached), files_[index]);
+            }
+        }
+        if (pooled)
+        {
+            DecodedFile shared;
+            shared.name = std::filesystem::path(files_[index]).stem().string();
+            shared.data.buffer = pooled;
+            shared.data.filePath = files_[index];
+            shared.data.sampleRate = pooled->GetSampleRate();
+            shared.data.channels = pooled->GetNumChannels();
+            shared.data.bitDepth = pooled->GetBitsPerSample();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (cancelled_)
+                {
+                    break;
+                }
+                decoded_.push_back(std::move(shared));
+            }
+            filesShared_.fetch_add(1);
+            filesDecoded_.fetch_add(1);
+            continue;
+        }
+
+        ReadFile file;
+        file.path = files_[index];
+
+        std::error_code error;
+        file.reservedBytes = std::filesystem::file_size(file.path, error);
+        if (error)
+        {
+            printf("Failed to read: %s\n", file.path.c_str());
+            filesFailed_.fetch_add(1);
+            continue;
+        }
+        if (!ReserveBytes(file.reservedBytes))
+        {
+            break;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = ReadWholeFile(file.path, file.data);
+        readNanoseconds_.fetch_add(NanosecondsSince(start));
+
+        if (!ok)
+        {
+            ReleaseBytes(file.reservedBytes);
+            if (cancelled_)
+            {
+                break;
+            }
+            printf("Failed to read: %s\n", file.path.c_str());
+            filesFailed_.fetch_add(1);
+            continue;
+        }
+
+        filesRead_.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cancelled_)
+            {
+                queuedBytes_ -= file.reservedBytes;
+                break;
+            }
+            readQueue_.push_back(std::move(file));
+        }
+        queueChanged_.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --activeReaders_;
+    }
+    queueChanged_.notify_all();
+}
+
+void BatchImporter::DecoderMain()
+{
+    AudioTrack track;
+
+    for (;;)
+    {
+        ReadFile file;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queueChanged_.wait(lock, [this]()
+            {
+                return cancelled_ || !readQueue_.empty() || activeReaders_ == 0;
+            });
+            if (cancelled_ || readQueue_.empty())
+            {
+                break;
+            }
+            file = std::move(readQueue_.front());
+            readQueue_.pop_front();
+        }
+        queueChanged_.notify_all(); // Room for a reader
+
+        auto start = std::chrono::steady_clock::now();
+        DecodedFile decoded;
+        bool ok = track.LoadFromEncoded(file.path, file.data.data(), file.data.size());
+        if (ok)
+        {
+            decoded.name = track.GetName();
+            decoded.data.filePath = file.path;
+            decoded.data.sampleRate = track.GetSampleRate();
+            decoded.data.channels = track.GetNumChannels();
+            decoded.data.bitDepth = track.GetBitsPerSample();
+            decoded.data.buffer = track.GetBuffer();
+            track.Clear();
+        }
+        file.data.clear();
+        file.data.shrink_to_fit();
+        ReleaseBytes(file.reservedBytes);
+        decodeNanoseconds_.fetch_add(NanosecondsSince(start));
+
+        if (!ok)
+        {
+            printf("Failed to decode: %s\n", file.path.c_str());
+            filesFailed_.fetch_add(1);
+            continue;
+        }
+
+        samplesDecoded_.fetch_add(decoded.data.GetNumSamples());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cancelled_)
+            {
+                break; // Cancel() has already dropped everything Poll() had not collected
+            }
+            decoded_.push_back(std::move(decoded));
+        }
+        filesDecoded_.fetch_add(1);
+    }
+
+    // The last decoder out stamps the end time so rates stop decaying afterwards
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--activeDecoders_ == 0)
+    {
+        finishNanoseconds_.store(std::max<int64_t>(1, NanosecondsSince(startTime_)));
+    }
+}
+
+// Waits until bytes fit in maxQueuedBytes alongside the files already being read, queued or
+// decoded. Nothing held means nothing to wait for, so one oversized file still gets through.
+bool BatchImporter::ReserveBytes(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    queueChanged_.wait(lock, [this, bytes]()
+    {
+        return cancelled_ || queuedBytes_ == 0 || queuedBytes_ + bytes <= settings_.maxQueuedBytes;
+    });
+    if (cancelled_)
+    {
+        return false;
+    }
+    queuedBytes_ += bytes;
+    return true;
+}
+
+void BatchImporter::ReleaseBytes(uint64_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queuedBytes_ -= bytes;
+    }
+    queueChanged_.notify_all();
+}
+
+bool BatchImporter::ReadWholeFile(const std::string& path, std::vector<uint8_t>& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::streamoff size = file.tellg();
+    if (size <= 0 || static_cast<uint64_t>(size) > SIZE_MAX)
+    {
+        return false;
+    }
+    file.seekg(0, std::ios::beg);
+    data.resize(static_cast<size_t>(size));
+
+    for (size_t offset = 0; offset < data.size(); offset += kReadBlockBytes)
+    {
+        if (cancelled_)
+        {
+            return false;
+        }
+
+        size_t count = std::min(kReadBlockBytes, data.size() - offset);
+        if (!file.read(reinterpret_cast<char*>(data.data() + offset), count))
+        {
+            return false;
+        }
+        bytesRead_.fetch_add(count);
+    }
+    return true;
+}
+
+void BatchImporter::JoinWorkers()
+{
+    for (std::thread& reader : readers_)
+    {
+        reader.join();
+    }
+    for (std::thread& decoder : decoders_)
+    {
+        decoder.join();
+    }
+    readers_.clear();
+    decoders_.clear();
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "AudioPlayer.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+class SequencerEngine;
+
+// Batch Importer - reads and decodes many audio files at once. Disk reads and decode
+// work have separate concurrency limits so a spinning disk is not made to seek between
+// many files while a fast SSD can still be kept busy.
+class BatchImporter
+{
+public:
+    struct Settings
+    {
+        uint32_t maxConcurrentReads;   // 1-2 for spinning disks, 8+ for NVMe
+        uint32_t maxConcurrentDecodes; // 0 = one per hardware thread
+        uint32_t maxQueuedFiles;       // Files read but not yet decoded
+        uint64_t maxQueuedBytes;       // Raw file bytes being read, queued or decoded - bounds memory use.
+                                       // A single file larger than this is still imported, on its own.
+
+        Settings() : maxConcurrentReads(2), maxConcurrentDecodes(0), maxQueuedFiles(8),
+                     maxQueuedBytes(256ull * 1024 * 1024) {}
+    };
+
+    struct Stats
+    {
+        uint32_t filesTotal = 0;
+        uint32_t filesRead = 0;
+        uint32_t filesDecoded = 0;
+        uint32_t filesFailed = 0;
+        uint32_t filesShared = 0;       // Already in the sample pool - neither read nor decoded
+        uint64_t bytesRead = 0;
+        uint64_t samplesDecoded = 0;
+        double elapsedSeconds = 0.0;
+        double readBusySeconds = 0.0;   // Summed over all reader threads
+        double decodeBusySeconds = 0.0; // Summed over all decoder threads
+        double readMegabytesPerSecond = 0.0;
+        double decodeMegasamplesPerSecond = 0.0;
+        double filesPerSecond = 0.0;
+    };
+
+    BatchImporter();
+    ~BatchImporter();
+
+    BatchImporter(const BatchImporter&) = delete;
+    BatchImporter& operator=(const BatchImporter&) = delete;
+
+    // WAV and FLAC files directly inside directory, sorted by name
+    static bool FindAudioFiles(const std::string& directory, std::vector<std::string>& files);
+
+    // Begin importing - fails if a batch is still running
+    bool Start(const std::vector<std::string>& files, const Settings& settings = Settings());
+    bool StartDirectory(const std::string& directory, const Settings& settings = Settings());
+
+    // Call from the thread that owns engine: creates a channel for every file
+    // decoded since the last call and returns how many were created
+    uint32_t Poll(SequencerEngine& engine);
+
+    // Stop after the files currently being read or decoded. Files already decoded but
+    // not yet collected by Poll() are dropped.
+    void Cancel();
+
+    // Workers still busy or decoded files waiting for Poll()
+    bool IsRunning() const;
+
+    Stats GetStats() const;
+    void PrintStats() const;
+
+private:
+    struct ReadFile
+    {
+        std::string path;
+        std::vector<uint8_t> data;
+        uint64_t reservedBytes = 0; // Held against maxQueuedBytes until decoded
+    };
+
+    struct DecodedFile
+    {
+        std::string name;
+        AudioData data;
+    };
+
+    Settings settings_;
+    std::vector<std::string> files_;
+    std::atomic<size_t> nextFile_;
+    std::atomic<bool> cancelled_;
+    std::vector<std::thread> readers_;
+    std::vector<std::thread> decoders_;
+
+    // Read -> decode hand-off and decode -> Poll() results
+    mutable std::mutex mutex_;
+    std::condition_variable queueChanged_;
+    std::deque<ReadFile> readQueue_;
+    std::deque<DecodedFile> decoded_;
+    uint32_t activeReaders_;
+    uint32_t activeDecoders_;
+    uint64_t queuedBytes_;
+
+    // Statistics
+    std::chrono::steady_clock::time_point startTime_;
+    std::atomic<int64_t> finishNanoseconds_; // 0 while running
+    std::atomic<uint32_t> filesRead_;
+    std::atomic<uint32_t> filesDecoded_;
+    std::atomic<uint32_t> filesFailed_;
+    std::atomic<uint32_t> filesShared_;
+    std::atomic<uint64_t> bytesRead_;
+    std::atomic<uint64_t> samplesDecoded_;
+    std::atomic<int64_t> readNanoseconds_;
+    std::atomic<int64_t> decodeNanoseconds_;
+
+    void ReaderMain();
+    void DecoderMain();
+    bool ReserveBytes(uint64_t bytes);
+    void ReleaseBytes(uint64_t bytes);
+    bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& data);
+    void JoinWorkers();
+};
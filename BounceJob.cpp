@@ -0,0 +1,370 @@
+#include "BounceJob.h"
+#include "SequencerChannel.h"
+#include "AudioPlayer.h"
+#include "AudioTrack.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+// Mixed chunks in flight between the mixer and the writer thread
+static const size_t kWriteBuffers = 3;
+
+// Master frames summed per task when the channel groups are added together
+static const uint32_t kReduceSliceFrames = 2048;
+
+BounceJob::BounceJob(const std::string& filePath, const Settings& settings)
+    : filePath_(filePath)
+    , settings_(settings)
+    , framesRendered_(0)
+    , framesTotal_(0)
+    , cancelRequested_(false)
+    , status_(RENDERING)
+{
+}
+
+BounceJob::~BounceJob()
+{
+    // The bounce still references tracks_ and the counters - stop it and wait
+    if (done_.valid())
+    {
+        Cancel();
+        done_.wait();
+    }
+}
+
+std::shared_ptr<BounceJob> BounceJob::Start(const std::vector<MixEngine::Source>& sources,
+                                            const std::string& filePath,
+                                            const Settings& settings)
+{
+    std::shared_ptr<BounceJob> job(new BounceJob(filePath, settings));
+
+    // Snapshot what is audible now, the same way the mix engine decides it
+    bool anySolo = false;
+    for (const MixEngine::Source& source : sources)
+    {
+        anySolo = anySolo || source.channel->IsSolo();
+    }
+    for (const MixEngine::Source& source : sources)
+    {
+        const SequencerChannel& channel = *source.channel;
+        if (!source.player || channel.IsMuted() || (anySolo && !channel.IsSolo()))
+        {
+            continue;
+        }
+
+        const AudioData& data = source.player->GetAudioData();
+        Track track;
+        track.channels = data.channels;
+        track.gain = channel.GetVolume() * source.player->GetVolume();
+        track.pan = channel.GetPan();
+        if (source.player->IsStreaming())
+        {
+            track.streamPath = data.filePath;
+            track.numFrames = source.player->GetDuration();
+        }
+        else
+        {
+            track.buffer = data.buffer;
+            track.numFrames = data.GetNumFrames();
+        }
+        if (track.numFrames > 0 && track.channels > 0 && track.channels <= MixEngine::kMaxSourceChannels)
+        {
+            job->tracks_.push_back(std::move(track));
+        }
+    }
+
+    // A dedicated thread drives the bounce; the mixing itself fans out across the pool
+    BounceJob* raw = job.get();
+    job->done_ = std::async(std::launch::async, [raw]()
+    {
+        return raw->Run();
+    });
+    return job;
+}
+
+BounceJob::Status BounceJob::Poll()
+{
+    if (status_ != RENDERING)
+    {
+        return status_;
+    }
+    if (done_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return status_;
+    }
+
+    bool succeeded = done_.get();
+    if (cancelRequested_.load())
+    {
+        status_ = CANCELLED;
+    }
+    else
+    {
+        status_ = succeeded ? SUCCEEDED : FAILED;
+    }
+    tracks_.clear();
+    return status_;
+}
+
+void BounceJob::Cancel()
+{
+    cancelRequested_.store(true);
+}
+
+float BounceJob::GetFraction() const
+{
+    if (status_ == SUCCEEDED)
+    {
+        return 1.0f;
+    }
+
+    uint64_t total = framesTotal_.load(std::memory_order_relaxed);
+    if (total == 0)
+    {
+        return 0.0f;
+    }
+    return static_cast<float>(static_cast<double>(framesRendered_.load(std::memory_order_relaxed)) / total);
+}
+
+bool BounceJob::Run()
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Streaming players keep their own decoder busy - give the bounce its own view of the file
+    uint64_t totalFrames = 0;
+    for (Track& track : tracks_)
+    {
+        if (!track.buffer)
+        {
+            track.stream = std::make_unique<AudioTrack>();
+            if (!track.stream->LoadFromFile(track.streamPath, AudioTrack::LOAD_MAPPED))
+            {
+                printf("Bounce: could not open %s\n", track.streamPath.c_str());
+                return false;
+            }
+            track.numFrames = track.stream->GetNumSamples();
+        }
+        totalFrames = std::max<uint64_t>(totalFrames, track.numFrames);
+    }
+    framesTotal_ = totalFrames;
+
+    WavWriter writer;
+    if (!writer.Open(filePath_, settings_.sampleRate, MixEngine::kOutputChannels, settings_.format))
+    {
+        return false;
+    }
+
+    // Channel t is always mixed by group t % numGroups, into that group's partial sum
+    ThreadPool& pool = ThreadPool::GetShared();
+    const uint32_t chunkFrames = settings_.chunkFrames > 0 ? settings_.chunkFrames : 16384;
+    const size_t chunkSamples = static_cast<size_t>(chunkFrames) * MixEngine::kOutputChannels;
+    const size_t numGroups = std::max<size_t>(1, std::min<size_t>(tracks_.size(), pool.GetThreadCount() + 1));
+    std::vector<std::vector<float>> partials(numGroups, std::vector<float>(chunkSamples));
+    std::vector<std::vector<float>> scratch(numGroups,
+        std::vector<float>(static_cast<size_t>(chunkFrames) * MixEngine::kMaxSourceChannels));
+
+    // Writer thread - mixed chunks go out through a small ring of buffers, so the disk and the
+    // mixer overlap and neither waits unless the other falls a full ring behind
+    std::vector<std::vector<float>> buffers(kWriteBuffers, std::vector<float>(chunkSamples));
+    std::vector<uint32_t> bufferFrames(kWriteBuffers, 0);
+    std::deque<size_t> freeBuffers;
+    std::deque<size_t> filledBuffers;
+    for (size_t i = 0; i < kWriteBuffers; ++i)
+    {
+        freeBuffers.push_back(i);
+    }
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    bool mixingDone = false;
+    std::atomic<bool> writeFailed(false);
+
+    std::thread writerThread([&]()
+    {
+        for (;;)
+        {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueChanged.wait(lock, [&]() { return !filledBuffers.empty() || mixingDone; });
+                if (filledBuffers.empty())
+                {
+                    return;
+                }
+                index = filledBuffers.front();
+                filledBuffers.pop_front();
+            }
+
+            if (!writeFailed.load() && !writer.Write(buffers[index].data(), bufferFrames[index]))
+            {
+                writeFailed = true;
+            }
+
+            std::lock_guard<std::mutex> lock(queueMutex);
+            freeBuffers.push_back(index);
+            queueChanged.notify_all();
+        }
+    });
+
+    float peak = 0.0f;
+    std::vector<float> slicePeaks;
+    for (uint64_t chunkStart = 0; chunkStart < totalFrames; chunkStart += chunkFrames)
+    {
+        if (cancelRequested_.load() || writeFailed.load())
+        {
+            break;
+        }
+
+        const uint32_t start = static_cast<uint32_t>(chunkStart);
+        const uint32_t numFrames = static_cast<uint32_t>(std::min<uint64_t>(chunkFrames, totalFrames - chunkStart));
+
+        pool.ParallelFor(numGroups, [&](size_t group)
+        {
+            float* partial = partials[group].data();
+            float* block = scratch[group].data();
+            std::fill(partial, partial + static_cast<size_t>(numFrames) * MixEngine::kOutputChannels, 0.0f);
+            for (size_t t = group; t < tracks_.size(); t += numGroups)
+            {
+                const Track& track = tracks_[t];
+                if (start >= track.numFrames)
+                {
+                    continue;
+                }
+                uint32_t frames = std::min(numFrames, track.numFrames - start);
+                frames = track.buffer ? track.buffer->ReadInterleaved(start, frames, block) :
+                                        track.stream->ReadFrames(start, frames, block);
+                MixEngine::MixSource(block, track.channels, frames, track.gain, track.pan, partial);
+            }
+        });
+
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [&]() { return !freeBuffers.empty(); });
+            index = freeBuffers.front();
+            freeBuffers.pop_front();
+        }
+
+        // Sum the groups into the master, a slice of frames per task
+        float* master = buffers[index].data();
+        const size_t numSlices = (numFrames + kReduceSliceFrames - 1) / kReduceSliceFrames;
+        slicePeaks.assign(numSlices, 0.0f);
+        pool.ParallelFor(numSlices, [&](size_t slice)
+        {
+            const size_t begin = slice * kReduceSliceFrames * MixEngine::kOutputChannels;
+            const size_t end = std::min<size_t>(begin + kReduceSliceFrames * MixEngine::kOutputChannels,
+                                                static_cast<size_t>(numFrames) * MixEngine::kOutputChannels);
+            std::copy(partials[0].begin() + begin, partials[0].begin() + end, master + begin);
+            for (size_t group = 1; group < numGroups; ++group)
+            {
+                const float* partial = partials[group].data();
+                for (size_t i = begin; i < end; ++i)
+                {
+                    master[i] += partial[i];
+                }
+            }
+            float slicePeak = 0.0f;
+            for (size_t i = begin; i < end; ++i)
+            {
+                slicePeak = std::max(slicePeak, std::fabs(master[i]));
+            }
+            slicePeaks[slice] = slicePeak;
+        });
+        for (float slicePeak : slicePeaks)
+        {
+            peak = std::max(peak, slicePeak);
+        }
+
+        bufferFrames[index] = numFrames;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            filledBuffers.push_back(index);
+            queueChanged.notify_all();
+        }
+        framesRendered_.fetch_add(numFrames, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        mixingDone = true;
+        queueChanged.notify_all();
+    }
+    writerThread.join();
+
+    bool succeeded = writer.Close() && !writeFailed.load() && !cancelRequested_.load();
+    if (!succeeded)
+    {
+        std::error_code error;
+        std::filesystem::remove(filePath_, error); // Never leave a truncated bounce behind
+        return false;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    result_.numTracks = static_cast<uint32_t>(tracks_.size());
+    result_.numWorkers = static_cast<uint32_t>(numGroups);
+    result_.numFrames = totalFrames;
+    result_.seconds = elapsed.count();
+    result_.realTimeFactor = elapsed.count() > 0.0 ? totalFrames / static_cast<double>(settings_.sampleRate) / elapsed.count() : 0.0;
+    result_.peak = peak;
+    printf("Bounced %s: %u tracks, %.1f s of audio in %.2f s (%.1fx real time), peak %.2f\n", filePath_.c_str(),
+        result_.numTracks, totalFrames / static_cast<double>(settings_.sampleRate), result_.seconds,
+        result_.realTimeFactor, result_.peak);
+    return true;
+}
+
+BounceJob::Result BounceJob::RunBenchmark(uint32_t numTracks, uint32_t seconds)
+{
+    Settings settings;
+    const uint32_t numFrames = seconds * settings.sampleRate;
+    std::string filePath = (std::filesystem::temp_directory_path() / "exedaw_bounce_benchmark.wav").string();
+    BounceJob job(filePath, settings);
+
+    // Deterministic noise, one mono and one stereo buffer shared by alternating tracks
+    std::shared_ptr<const SampleBuffer> buffers[2];
+    uint32_t seed = 0x12345678u;
+    for (uint16_t b = 0; b < 2 && numFrames > 0; ++b)
+    {
+        const uint16_t channels = b + 1;
+        auto buffer = std::make_shared<SampleBuffer>(numFrames, settings.sampleRate, channels, 16);
+        for (uint16_t ch = 0; ch < channels; ++ch)
+        {
+            float* samples = buffer->GetWritableChannel(ch);
+            for (uint32_t i = 0; i < numFrames; ++i)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                samples[i] = static_cast<int16_t>(seed >> 16) / 32768.0f;
+            }
+        }
+        buffer->Seal();
+        buffers[b] = buffer;
+    }
+
+    for (uint32_t i = 0; i < numTracks && numFrames > 0; ++i)
+    {
+        Track track;
+        track.buffer = buffers[i % 2];
+        track.channels = static_cast<uint16_t>(i % 2 + 1);
+        track.numFrames = numFrames;
+        track.gain = 1.0f / numTracks;
+        track.pan = (i % 5) * 0.5f - 1.0f;
+        job.tracks_.push_back(std::move(track));
+    }
+
+    job.Run();
+    std::error_code error;
+    std::filesystem::remove(filePath, error);
+    return job.result_;
+}
+
+void BounceJob::PrintBenchmark(const Result& result)
+{
+    printf("Bounce benchmark: %u tracks, %.0f s of audio on %u workers\n", result.numTracks,
+        result.numFrames / static_cast<double>(Settings().sampleRate), result.numWorkers);
+    printf("  %.2f s, %.1fx real time\n", result.seconds, result.realTimeFactor);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "MixEngine.h"
+#include "WavWriter.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <atomic>
+#include <cstdint>
+
+class AudioTrack;
+class SampleBuffer;
+
+// Bounce Job - renders the mix to a WAV file offline, as fast as the machine allows. The session
+// is mixed one chunk at a time with the channels split across the shared thread pool, while a
+// writer thread streams the chunks already mixed to disk.
+class BounceJob
+{
+public:
+    enum Status
+    {
+        RENDERING,
+        SUCCEEDED,
+        FAILED,
+        CANCELLED
+    };
+
+    struct Settings
+    {
+        uint32_t sampleRate;          // Written to the file - sources are not resampled
+        WavWriter::SampleFormat format;
+        uint32_t chunkFrames;         // Session frames mixed per parallel step
+
+        Settings() : sampleRate(44100), format(WavWriter::FORMAT_PCM24), chunkFrames(16384) {}
+    };
+
+    struct Result
+    {
+        uint32_t numTracks = 0;       // Audible channels that were mixed
+        uint32_t numWorkers = 0;      // Channel groups mixed in parallel
+        uint64_t numFrames = 0;
+        double seconds = 0.0;
+        double realTimeFactor = 0.0;  // Audio seconds bounced per second
+        float peak = 0.0f;            // Of the master, before conversion
+    };
+
+    // Start bouncing sources from the start of the session. Volume, pan, mute and solo are
+    // taken as they are now; the players themselves are not touched, so playback can go on.
+    static std::shared_ptr<BounceJob> Start(const std::vector<MixEngine::Source>& sources,
+                                            const std::string& filePath,
+                                            const Settings& settings = Settings());
+
+    ~BounceJob();
+
+    BounceJob(const BounceJob&) = delete;
+    BounceJob& operator=(const BounceJob&) = delete;
+
+    // Call from the thread that started the job; never blocks
+    Status Poll();
+
+    // Ask the bounce to stop - the partial file is deleted and Poll() reports CANCELLED
+    void Cancel();
+
+    Status GetStatus() const { return status_; }
+    bool IsFinished() const { return status_ != RENDERING; }
+    float GetFraction() const; // 0.0 to 1.0
+    const Result& GetResult() const { return result_; } // Once Poll() reports SUCCEEDED
+    const std::string& GetFilePath() const { return filePath_; }
+
+    // Benchmark: bounce a synthetic session of alternating mono and stereo noise tracks to a
+    // temporary file, on the calling thread
+    static Result RunBenchmark(uint32_t numTracks = 80, uint32_t seconds = 240);
+    static void PrintBenchmark(const Result& result);
+
+private:
+    // One audible channel, captured when the job starts
+    struct Track
+    {
+        std::shared_ptr<const SampleBuffer> buffer; // Players holding the whole file in memory
+        std::string streamPath;                     // Streaming players - mapped again by the bounce
+        std::unique_ptr<AudioTrack> stream;
+        uint16_t channels = 0;
+        uint32_t numFrames = 0;
+        float gain = 1.0f;
+        float pan = 0.0f;
+    };
+
+    BounceJob(const std::string& filePath, const Settings& settings);
+
+    std::string filePath_;
+    Settings settings_;
+    std::vector<Track> tracks_; // Only touched by the bounce until result_ is ready
+    Result result_;
+    std::atomic<uint64_t> framesRendered_;
+    std::atomic<uint64_t> framesTotal_;
+    std::atomic<bool> cancelRequested_;
+    std::future<bool> done_;
+    Status status_;
+
+    bool Run();
+};
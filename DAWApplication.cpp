@@ -1,25 +1,30 @@
 #include "DAWApplication.h"
+#include <cstring>
+#include <cstdio>
 
 DAWApplication::DAWApplication()
 {
     sequencer_ = std::make_shared<SequencerEngine>();
     transport_ = std::make_shared<TransportControl>();
     visualizer_ = std::make_shared<WaveformVisualizer>();
+    mixEngine_ = std::make_shared<MixEngine>();
 }
 
 DAWApplication::~DAWApplication()
 {
+    // The render thread reads the engine and the channels, stop it before they go
+    audioDevice_.reset();
 }
 
 bool DAWApplication::Initialize()
 {
-    // Initialize transport control
-   transport_->SetSampleRate(44100);
+    // Initialize transport control - the sample rate comes from the audio device
     transport_->SetTempo(120.0f);
   transport_->SetTimeSignature(4, 4);
     transport_->SetLoopEnabled(false);
-    
-    return true;
+
+    // Nothing to hear yet - a clocked null device keeps the engine running in real time
+    return SetAudioDevice(std::make_unique<NullAudioDevice>(true));
 }
 
 std::shared_ptr<SequencerEngine> DAWApplication::GetSequencer()
@@ -37,6 +42,98 @@ std::shared_ptr<WaveformVisualizer> DAWApplication::GetVisualizer()
     return visualizer_;
 }
 
+std::shared_ptr<MixEngine> DAWApplication::GetMixEngine()
+{
+    return mixEngine_;
+}
+
+bool DAWApplication::SetAudioDevice(std::unique_ptr<AudioDevice> device, const AudioDevice::Config& config)
+{
+    if (!device)
+    {
+        return false;
+    }
+
+    // Reconfiguring the running device - let go of it first, and go back to it on failure
+    const bool sameDevice = audioDevice_ && strcmp(audioDevice_->GetName(), device->GetName()) == 0 &&
+        audioDevice_->GetTarget() == device->GetTarget();
+    const AudioDevice::Config previous = audioDevice_ ? audioDevice_->GetConfig() : AudioDevice::Config();
+    if (sameDevice)
+    {
+        audioDevice_->Close();
+    }
+
+    if (!device->Open(config))
+    {
+        if (sameDevice && !(audioDevice_->Open(previous) && StartAudioDevice()))
+        {
+            printf("Audio device %s: could not reopen the previous configuration\n", audioDevice_->GetName());
+        }
+        return false;
+    }
+
+    if (audioDevice_)
+    {
+        audioDevice_->Close();
+    }
+    audioDevice_ = std::move(device);
+    return StartAudioDevice();
+}
+
+bool DAWApplication::StartAudioDevice()
+{
+    // Positions and tempo math follow the rate the device settled on
+    const AudioDevice::Config& negotiated = audioDevice_->GetConfig();
+    transport_->SetSampleRate(negotiated.sampleRate);
+
+    std::shared_ptr<MixEngine> engine = mixEngine_;
+    const uint16_t channels = negotiated.channels;
+    return audioDevice_->Start([engine, channels](float* output, uint32_t numFrames)
+    {
+        engine->Render(output, numFrames, channels);
+    });
+}
+
+void DAWApplication::Update()
+{
+    // Free what the render thread handed back, then follow its playhead once it has caught up
+    // with everything posted, so a fresh Locate or Stop is not overwritten by a stale position
+    mixEngine_->ProcessReplies();
+    if (mixEngine_->GetCompletedSequence() == mixEngine_->GetPostedSequence() && !transport_->IsStopped())
+    {
+        transport_->SetPlayheadPosition(mixEngine_->GetPlayhead());
+    }
+    PublishSources();
+}
+
+void DAWApplication::PublishSources()
+{
+    // Republish only when a channel or its player changed, the new list allocates
+    const std::vector<std::shared_ptr<SequencerChannel>>& channels = sequencer_->GetAllChannels();
+    const std::vector<MixEngine::Source>& current = mixEngine_->GetSources();
+
+    bool changed = current.size() != channels.size();
+    for (size_t i = 0; i < channels.size() && !changed; ++i)
+    {
+        changed = current[i].channel != channels[i] || current[i].player != channels[i]->GetAudioPlayer();
+    }
+    if (!changed)
+    {
+        return;
+    }
+
+    std::vector<MixEngine::Source> sources;
+    sources.reserve(channels.size());
+    for (const auto& channel : channels)
+    {
+        MixEngine::Source source;
+        source.channel = channel;
+        source.player = channel->GetAudioPlayer();
+        sources.push_back(source);
+    }
+    mixEngine_->SetSources(std::move(sources));
+}
+
 std::shared_ptr<SequencerChannel> DAWApplication::AddTrack(const std::string& trackName)
 {
     return sequencer_->CreateChannel(trackName, SequencerChannel::AUDIO);
@@ -49,44 +146,32 @@ bool DAWApplication::LoadAudioFile(uint32_t channelId, const std::string& filePa
 
 void DAWApplication::PlayAll()
 {
+    // The players are only ever started, stopped and moved by the render thread, between blocks.
+    // Channels added since the last Update() are sent first so they take part.
+    PublishSources();
     transport_->Play();
-    
-    // Play all channels that have audio
-    for (const auto& channel : sequencer_->GetAllChannels())
-    {
-if (channel->HasAudioPlayer())
-  {
-   channel->GetAudioPlayer()->Play();
-        }
-    }
+    mixEngine_->Play();
 }
 
 void DAWApplication::StopAll()
 {
+    PublishSources();
     transport_->Stop();
-    
-    // Stop all channels
-    for (const auto& channel : sequencer_->GetAllChannels())
-    {
-   if (channel->HasAudioPlayer())
-        {
-            channel->GetAudioPlayer()->Stop();
-        }
-    }
+    mixEngine_->Stop();
 }
 
 void DAWApplication::PauseAll()
 {
+    PublishSources();
     transport_->Pause();
-    
-    // Pause all channels
-    for (const auto& channel : sequencer_->GetAllChannels())
-    {
-        if (channel->HasAudioPlayer())
-   {
-     channel->GetAudioPlayer()->Pause();
-      }
-    }
+    mixEngine_->Pause();
+}
+
+void DAWApplication::Locate(uint32_t sampleIndex)
+{
+    PublishSources();
+    transport_->SetPlayheadPosition(sampleIndex);
+    mixEngine_->Locate(sampleIndex);
 }
 
 uint32_t DAWApplication::GetTrackCount() const
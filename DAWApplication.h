@@ -3,6 +3,8 @@
 #include "SequencerEngine.h"
 #include "TransportControl.h"
 #include "WaveformVisualizer.h"
+#include "MixEngine.h"
+#include "AudioDevice.h"
 #include <memory>
 
 // DAW Application class - Main coordinator for the audio workstation
@@ -19,15 +21,29 @@ public:
     std::shared_ptr<SequencerEngine> GetSequencer();
     std::shared_ptr<TransportControl> GetTransport();
     std::shared_ptr<WaveformVisualizer> GetVisualizer();
+    std::shared_ptr<MixEngine> GetMixEngine();
+
+    // Output - the device renders the mix engine on its own thread until it is replaced, and the
+    // transport runs at the sample rate it negotiated. Fails, keeping the current device, if the
+    // new one cannot be opened. The same backend and target is closed before it is reopened, as
+    // an exclusive PCM or a capture file cannot be opened twice.
+    bool SetAudioDevice(std::unique_ptr<AudioDevice> device, const AudioDevice::Config& config = AudioDevice::Config());
+    AudioDevice* GetAudioDevice() { return audioDevice_.get(); }
+
+    // Call once per UI frame - hands channel additions, deletions and player changes to the mix
+    // engine, frees what it has finished with and moves the transport's playhead along
+    void Update();
 
     // Convenience methods for common DAW operations
     std::shared_ptr<SequencerChannel> AddTrack(const std::string& trackName);
     bool LoadAudioFile(uint32_t channelId, const std::string& filePath);
     
-    // Play/Stop operations affecting all channels
+    // Play/Stop operations affecting all channels - the transport changes now, the players at
+    // the start of the next block the engine renders
     void PlayAll();
     void StopAll();
     void PauseAll();
+    void Locate(uint32_t sampleIndex);
 
     // Get channel count
     uint32_t GetTrackCount() const;
@@ -36,4 +52,9 @@ private:
     std::shared_ptr<SequencerEngine> sequencer_;
     std::shared_ptr<TransportControl> transport_;
     std::shared_ptr<WaveformVisualizer> visualizer_;
+    std::shared_ptr<MixEngine> mixEngine_;
+    std::unique_ptr<AudioDevice> audioDevice_;
+
+    void PublishSources();
+    bool StartAudioDevice();
 };
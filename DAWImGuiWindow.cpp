@@ -4,18 +4,32 @@
 #include "SequencerModel.h"
 #include "SequencerView.h"
 #include "AudioTrack.h"
+#include "AudioLoadJob.h"
+#include "BatchImporter.h"
+#include "SampleConvert.h"
+#include "SamplePool.h"
+#include "DecodeCache.h"
+#include "AudioAnalysis.h"
+#include "PeakPyramid.h"
+#include "MixEngine.h"
+#include "BounceJob.h"
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <Windows.h> // For file dialog
 
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h> // For glfwGetWin32Window
 
+// Narrowest waveform view zooming can reach
+static const double kMinWaveformViewFrames = 32.0;
+
 DAWImGuiWindow::DAWImGuiWindow()
     : selectedTrackIndex_(-1)
 {
     daw_ = std::make_shared<DAWApplication>();
-    sequencer_ = std::make_shared<SequencerEngine>();
+    sequencer_ = daw_->GetSequencer(); // Channels made here are the ones the mix engine plays
+    batchImporter_ = std::make_unique<BatchImporter>();
 }
 
 DAWImGuiWindow::~DAWImGuiWindow()
@@ -123,6 +137,20 @@ bool DAWImGuiWindow::Create(const char* title, int width, int height)
 void DAWImGuiWindow::Destroy()
 {
     isRunning_ = false;
+    
+    // Stop background imports before the tracks they feed go away
+    for (auto& job : loadJobs_)
+    {
+        job->Cancel();
+    }
+    loadJobs_.clear();
+    batchImporter_->Cancel();
+    bounceJob_.reset(); // Cancels and waits
+    if (benchmark_.valid())
+    {
+        printf("Waiting for the %s benchmark to finish\n", benchmarkName_.c_str());
+        benchmark_.wait();
+    }
   
     // Cleanup ImGui first (while GLFW context is still valid)
     if (glfwWindow_)
@@ -247,6 +275,39 @@ bool DAWImGuiWindow::Update()
 
     // Poll events
     glfwPollEvents();
+    
+    // Hand finished imports to their tracks
+    PollLoadJobs();
+    
+    // Turn finished folder-import files into channels
+    if (batchImporter_->IsRunning())
+    {
+        batchImporter_->Poll(*sequencer_);
+        if (!batchImporter_->IsRunning())
+        {
+            batchImporter_->PrintStats();
+        }
+    }
+
+    // Hand channel changes to the mix engine
+    daw_->Update();
+    
+    // Finished bounces report themselves
+    if (bounceJob_ && bounceJob_->Poll() != BounceJob::RENDERING)
+    {
+        if (bounceJob_->GetStatus() == BounceJob::FAILED)
+        {
+            printf("Bounce to %s failed\n", bounceJob_->GetFilePath().c_str());
+        }
+        bounceJob_.reset();
+    }
+    
+    // So do benchmarks
+    if (benchmark_.valid() && benchmark_.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        benchmark_.get();
+        printf("%s benchmark finished\n", benchmarkName_.c_str());
+    }
 
 // Start ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
@@ -262,6 +323,8 @@ bool DAWImGuiWindow::Update()
     if (uiState_.showBrowser) DrawBrowser();
     if (uiState_.showProperties) DrawProperties();
     if (uiState_.showAbout) DrawAbout();
+    if (uiState_.showImportDialog) DrawImportDialog();
+    if (uiState_.showBounceDialog) DrawBounceDialog();
 
     return true;
 }
@@ -291,6 +354,8 @@ void DAWImGuiWindow::DrawMenuBar()
         {
       if (ImGui::MenuItem("New", "Ctrl+N")) OnFileNew();
             if (ImGui::MenuItem("Open...", "Ctrl+O")) OnFileOpen();
+            if (ImGui::MenuItem("Import Folder...")) OnFileImportFolder();
+            if (ImGui::MenuItem("Bounce Mix...", nullptr, false, !bounceJob_)) OnFileBounce();
   ImGui::Separator();
             if (ImGui::MenuItem("Save", "Ctrl+S")) OnFileSave();
           if (ImGui::MenuItem("Save As...", "Ctrl+Shift+S")) OnFileSaveAs();
@@ -323,12 +388,20 @@ if (ImGui::MenuItem("Delete", "Del")) OnEditDelete();
       ImGui::MenuItem("Mixer", nullptr, &uiState_.showMixer);
        ImGui::MenuItem("Browser", nullptr, &uiState_.showBrowser);
   ImGui::MenuItem("Properties", nullptr, &uiState_.showProperties);
+            ImGui::Separator();
+            ImGui::MenuItem("Waveform per Channel", nullptr, &uiState_.waveformChannelLanes);
             ImGui::EndMenu();
    }
 
         // Help Menu
         if (ImGui::BeginMenu("Help"))
   {
+      // One benchmark at a time, so they do not skew each other
+      const bool benchmarkIdle = !benchmark_.valid();
+      if (ImGui::MenuItem("Benchmark Sample Conversion", nullptr, false, benchmarkIdle)) OnHelpBenchmark();
+      if (ImGui::MenuItem("Benchmark Mix Engine", nullptr, false, benchmarkIdle)) OnHelpBenchmarkMix();
+      if (ImGui::MenuItem("Benchmark Offline Bounce", nullptr, false, benchmarkIdle)) OnHelpBenchmarkBounce();
+      ImGui::Separator();
       if (ImGui::MenuItem("About")) OnHelpAbout();
           ImGui::EndMenu();
     }
@@ -443,6 +516,45 @@ void DAWImGuiWindow::DrawSequencer()
   ImGui::SetNextItemWidth(80);
     ImGui::Combo("##snap", &snapValue, "1/4\0001/8\0001/16\0001/32\0");
     
+    // Folder import status
+    if (batchImporter_->IsRunning())
+    {
+        BatchImporter::Stats stats = batchImporter_->GetStats();
+        ImGui::SameLine();
+        ImGui::Spacing();
+        ImGui::SameLine();
+        ImGui::Text("Importing %u/%u files - %.0f MB/s",
+            stats.filesDecoded + stats.filesFailed, stats.filesTotal, stats.readMegabytesPerSecond);
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel Import"))
+        {
+            batchImporter_->Cancel();
+        }
+    }
+    
+    // Bounce status
+    if (bounceJob_)
+    {
+        ImGui::SameLine();
+        ImGui::Spacing();
+        ImGui::SameLine();
+        ImGui::Text("Bouncing %.0f%%", bounceJob_->GetFraction() * 100.0f);
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel Bounce"))
+        {
+            bounceJob_->Cancel();
+        }
+    }
+    
+    // Benchmark status
+    if (benchmark_.valid())
+    {
+        ImGui::SameLine();
+        ImGui::Spacing();
+        ImGui::SameLine();
+        ImGui::Text("Running %s benchmark...", benchmarkName_.c_str());
+    }
+    
     ImGui::Separator();
     
     // Track list
@@ -457,9 +569,27 @@ auto& track = audioTracks_[i];
       snprintf(label, sizeof(label), "%s###track%zu", track->GetName().c_str(), i);
         
      bool isSelected = (static_cast<int>(i) == selectedTrackIndex_);
-     if (ImGui::Selectable(label, isSelected))
+ if (ImGui::Selectable(label, isSelected))
     {
     selectedTrackIndex_ = static_cast<int>(i);
+    uiState_.waveformViewFrames = 0.0;
+        }
+        
+        // Import progress with a cancel button
+        if (AudioLoadJob* job = FindLoadJob(track.get()))
+        {
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB",
+                job->GetBytesRead() / (1024.0 * 1024.0),
+                job->GetBytesTotal() / (1024.0 * 1024.0));
+            ImGui::ProgressBar(job->GetFraction(), ImVec2(-40, 0), overlay);
+            ImGui::SameLine();
+            ImGui::PushID(static_cast<int>(i));
+            if (ImGui::SmallButton("X"))
+            {
+                job->Cancel();
+            }
+            ImGui::PopID();
         }
  
       // Show track info
@@ -504,27 +634,68 @@ ImGui::SameLine();
        ImVec2(canvas_pos.x + canvas_size.x, canvas_pos.y + canvas_size.y),
      IM_COL32(20, 20, 22, 255));
             
-  // Get waveform data
-    std::vector<float> minVals, maxVals;
-          uint32_t numPoints = static_cast<uint32_t>(canvas_size.x);
-      track->GetPeakAmplitudes(minVals, maxVals, numPoints);
-        
-       // Draw waveform
-          float centerY = canvas_pos.y + canvas_size.y * 0.5f;
-     float scale = canvas_size.y * 0.4f;
-         
-      for (size_t i = 0; i < minVals.size(); ++i)
+            // Wheel zooms around the pointer, Shift+wheel scrolls, double-click shows the whole track
+            const double numFrames = track->GetNumSamples();
+            double& viewStart = uiState_.waveformViewStart;
+            double& viewFrames = uiState_.waveformViewFrames;
+            if (viewFrames <= 0.0 || viewFrames > numFrames)
             {
-  float x = canvas_pos.x + i;
-      float y1 = centerY - maxVals[i] * scale;
-       float y2 = centerY - minVals[i] * scale;
-          
-    draw_list->AddLine(
-      ImVec2(x, y1),
-       ImVec2(x, y2),
-          IM_COL32(100, 180, 255, 255),
-       1.0f);
-        }
+                viewStart = 0.0;
+                viewFrames = numFrames;
+            }
+            if (ImGui::IsWindowHovered() && canvas_size.x > 0.0f)
+            {
+                ImGuiIO& io = ImGui::GetIO();
+                float scroll = io.KeyShift ? io.MouseWheel : io.MouseWheelH;
+                if (io.MouseWheel != 0.0f && !io.KeyShift)
+                {
+                    double pointer = (io.MousePos.x - canvas_pos.x) / canvas_size.x;
+                    double anchor = viewStart + pointer * viewFrames;
+                    double minFrames = numFrames < kMinWaveformViewFrames ? numFrames : kMinWaveformViewFrames;
+                    viewFrames *= std::pow(0.8, io.MouseWheel);
+                    viewFrames = viewFrames < minFrames ? minFrames : (viewFrames > numFrames ? numFrames : viewFrames);
+                    viewStart = anchor - pointer * viewFrames;
+                }
+                if (scroll != 0.0f)
+                {
+                    viewStart -= scroll * viewFrames * 0.1;
+                }
+                if (ImGui::IsMouseDoubleClicked(0))
+                {
+                    viewStart = 0.0;
+                    viewFrames = numFrames;
+                }
+            }
+            viewStart = viewStart < 0.0 ? 0.0 : (viewStart > numFrames - viewFrames ? numFrames - viewFrames : viewStart);
+            
+            // Get waveform data - only the visible range is read, and only when the view changed. Channels get
+            // their own lanes so out-of-phase content stays visible; otherwise one lane shows their envelope.
+            uint32_t numPoints = static_cast<uint32_t>(canvas_size.x);
+            uint32_t viewFirst = static_cast<uint32_t>(viewStart);
+            uint32_t viewEnd = static_cast<uint32_t>(std::ceil(viewStart + viewFrames));
+            uint16_t numLanes = uiState_.waveformChannelLanes && track->GetNumChannels() <= 32 ? track->GetNumChannels() : 1;
+            ImVec2 lane_size = ImVec2(canvas_size.x, canvas_size.y / numLanes);
+            
+            std::shared_ptr<const PeakPyramid> peaks = track->GetPeakPyramid();
+            WaveformGeometry& geometry = waveformGeometry_[track.get()];
+            WaveformView view = { peaks ? static_cast<const void*>(peaks.get()) : static_cast<const void*>(track.get()),
+                track->GetNumSamples(), viewFirst, viewEnd, numLanes, canvas_pos, canvas_size, ImGui::GetFontTexUvWhitePixel() };
+            if (!PrepareWaveformGeometry(geometry, view))
+            {
+                std::vector<float> minVals, maxVals;
+                for (uint16_t lane = 0; lane < numLanes; ++lane)
+                {
+                    uint32_t channelMask = numLanes > 1 ? 1u << lane : PeakPyramid::kAllChannels;
+                    track->GetPeakAmplitudes(viewFirst, viewEnd, numPoints, channelMask, minVals, maxVals);
+                    AddWaveformLane(geometry, ImVec2(canvas_pos.x, canvas_pos.y + lane * lane_size.y), lane_size, minVals, maxVals);
+                }
+                track->GetRangeStatistics(viewFirst, viewEnd, geometry.viewPeak, geometry.viewRMS);
+            }
+            DrawWaveformGeometry(draw_list, geometry);
+            
+            for (uint16_t lane = 0; lane < numLanes; ++lane)
+            {
+                float centerY = canvas_pos.y + lane * lane_size.y + lane_size.y * 0.5f;
       
  // Draw center line
         draw_list->AddLine(
@@ -532,17 +703,22 @@ ImGui::SameLine();
          ImVec2(canvas_pos.x + canvas_size.x, centerY),
              IM_COL32(80, 80, 80, 255),
              1.0f);
+            }
             
-     // Draw info text
+     // Draw info text - whole-track statistics are cached, the visible range's with the waveform
       char info[256];
       snprintf(info, sizeof(info),
-     "%s - %.2fs - %dHz %dch - Peak: %.2f RMS: %.2f",
+     "%s - %.2fs (%.2fs-%.2fs) - %dHz %dch - Peak: %.2f RMS: %.2f - View Peak: %.2f RMS: %.2f",
     track->GetName().c_str(),
       track->GetDurationSeconds(),
+      viewStart / track->GetSampleRate(),
+      (viewStart + viewFrames) / track->GetSampleRate(),
      track->GetSampleRate(),
      track->GetNumChannels(),
      track->GetPeakAmplitude(),
- track->GetRMSAmplitude());
+ track->GetRMSAmplitude(),
+      geometry.viewPeak,
+      geometry.viewRMS);
       
      ImVec2 text_pos = ImVec2(canvas_pos.x + 10, canvas_pos.y + 10);
      draw_list->AddText(text_pos, IM_COL32(220, 220, 220, 255), info);
@@ -553,7 +729,33 @@ ImGui::SameLine();
            ImGui::GetWindowPos().x + ImGui::GetWindowSize().x * 0.5f - 80,
      ImGui::GetWindowPos().y + ImGui::GetWindowSize().y * 0.5f);
          ImGui::SetCursorScreenPos(text_pos);
-       ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), "No audio loaded");
+       if (AudioLoadJob* job = FindLoadJob(track.get()))
+       {
+           // The part decoded so far, growing as the load goes on
+           std::shared_ptr<const PeakPyramid> peaks = job->GetPeaks();
+           if (peaks && peaks->GetValidFrames() > 0)
+           {
+               ImVec2 canvas_pos = ImGui::GetWindowPos();
+               ImVec2 canvas_size = ImGui::GetWindowSize();
+               WaveformGeometry& geometry = waveformGeometry_[track.get()];
+               WaveformView view = { peaks.get(), peaks->GetValidFrames(), 0, peaks->GetNumFrames(), 1,
+                   canvas_pos, canvas_size, ImGui::GetFontTexUvWhitePixel() };
+               if (!PrepareWaveformGeometry(geometry, view))
+               {
+                   uint32_t numPoints = static_cast<uint32_t>(canvas_size.x);
+                   std::vector<float> minVals(numPoints), maxVals(numPoints);
+                   peaks->GetRangePeaks(nullptr, 0, peaks->GetNumFrames(), numPoints, PeakPyramid::kAllChannels,
+                                        minVals.data(), maxVals.data());
+                   AddWaveformLane(geometry, canvas_pos, canvas_size, minVals, maxVals);
+               }
+               DrawWaveformGeometry(ImGui::GetWindowDrawList(), geometry);
+           }
+           ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), "Loading... %.0f%%", job->GetFraction() * 100.0f);
+       }
+       else
+       {
+           ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), "No audio loaded");
+       }
      }
  }
     else
@@ -576,6 +778,101 @@ ImGui::GetWindowPos().x + ImGui::GetWindowSize().x * 0.5f - 100,
  ImGui::End();
 }
 
+bool DAWImGuiWindow::PrepareWaveformGeometry(WaveformGeometry& geometry, const WaveformView& view)
+{
+    const WaveformView& built = geometry.view;
+    if (geometry.valid && built.source == view.source && built.validFrames == view.validFrames &&
+        built.firstFrame == view.firstFrame && built.endFrame == view.endFrame && built.numLanes == view.numLanes &&
+        built.pos.x == view.pos.x && built.pos.y == view.pos.y && built.size.x == view.size.x && built.size.y == view.size.y &&
+        built.whitePixelUV.x == view.whitePixelUV.x && built.whitePixelUV.y == view.whitePixelUV.y)
+    {
+        return true;
+    }
+    
+    geometry.view = view;
+    geometry.valid = true;
+    geometry.vertices.clear();
+    geometry.indices.clear();
+    geometry.verticesPerLane = 0;
+    return false;
+}
+
+void DAWImGuiWindow::AddWaveformLane(WaveformGeometry& geometry, const ImVec2& pos, const ImVec2& size,
+                                     const std::vector<float>& minVals, const std::vector<float>& maxVals)
+{
+    float centerY = pos.y + size.y * 0.5f;
+    float scale = size.y * 0.4f;
+    const ImU32 color = IM_COL32(100, 180, 255, 255);
+    
+    // Every lane holds as many columns, so they share one set of indices. 16-bit indices reach 32K columns.
+    const int numColumns = minVals.size() < 32767 ? static_cast<int>(minVals.size()) : 32767;
+    if (numColumns < 2)
+    {
+        return;
+    }
+    if (geometry.indices.empty())
+    {
+        geometry.verticesPerLane = numColumns * 2;
+        for (int i = 0; i + 1 < numColumns; ++i)
+        {
+            ImDrawIdx top = static_cast<ImDrawIdx>(i * 2);
+            const ImDrawIdx quad[6] = { top, static_cast<ImDrawIdx>(top + 1), static_cast<ImDrawIdx>(top + 2),
+                                        static_cast<ImDrawIdx>(top + 1), static_cast<ImDrawIdx>(top + 3), static_cast<ImDrawIdx>(top + 2) };
+            geometry.indices.insert(geometry.indices.end(), quad, quad + 6);
+        }
+    }
+    if (numColumns * 2 != geometry.verticesPerLane)
+    {
+        return;
+    }
+    
+    // Top and bottom of each pixel column, joined to the next column - half a pixel wider so silence still shows
+    ImDrawVert vertex;
+    vertex.uv = geometry.view.whitePixelUV;
+    vertex.col = color;
+    for (int i = 0; i < numColumns; ++i)
+    {
+        vertex.pos = ImVec2(pos.x + i, centerY - maxVals[i] * scale - 0.5f);
+        geometry.vertices.push_back(vertex);
+        vertex.pos = ImVec2(pos.x + i, centerY - minVals[i] * scale + 0.5f);
+        geometry.vertices.push_back(vertex);
+    }
+}
+
+void DAWImGuiWindow::DrawWaveformGeometry(ImDrawList* drawList, const WaveformGeometry& geometry)
+{
+    const int numVertices = geometry.verticesPerLane;
+    const int numIndices = static_cast<int>(geometry.indices.size());
+    if (numVertices == 0 || numIndices == 0)
+    {
+        return;
+    }
+    
+    for (size_t first = 0; first + numVertices <= geometry.vertices.size(); first += numVertices)
+    {
+        // With 16-bit indices every vertex must sit within 64K of the list's vertex offset. PrimReserve starts a
+        // new offset by itself when the renderer honours them; without that, a lane past the limit would wrap
+        // its indices onto other geometry, so it and the lanes after it are left out instead.
+        if (sizeof(ImDrawIdx) == 2 && !(drawList->Flags & ImDrawListFlags_AllowVtxOffset) &&
+            drawList->_VtxCurrentIdx + static_cast<unsigned int>(numVertices) > 0x10000)
+        {
+            return;
+        }
+        drawList->PrimReserve(numIndices, numVertices);
+        
+        // The lane's vertices go in with one copy, as ImGui's own primitives fill the reserved space. The cached
+        // indices are lane-relative - rebase them onto the vertices already in the list.
+        const unsigned int base = drawList->_VtxCurrentIdx;
+        memcpy(drawList->_VtxWritePtr, geometry.vertices.data() + first, numVertices * sizeof(ImDrawVert));
+        drawList->_VtxWritePtr += numVertices;
+        drawList->_VtxCurrentIdx += static_cast<unsigned int>(numVertices);
+        for (int i = 0; i < numIndices; ++i)
+        {
+            drawList->PrimWriteIdx(static_cast<ImDrawIdx>(geometry.indices[i] + base));
+        }
+    }
+}
+
 void DAWImGuiWindow::DrawInspector()
 {
   ImGui::Begin("Inspector", &uiState_.showInspector, ImGuiWindowFlags_NoCollapse);
@@ -636,6 +933,17 @@ void DAWImGuiWindow::DrawInspector()
        ImGui::BulletText("Samples: %u", track->GetNumSamples());
      ImGui::BulletText("Peak Amplitude: %.3f", track->GetPeakAmplitude());
       ImGui::BulletText("RMS Amplitude: %.3f", track->GetRMSAmplitude());
+            if (track->GetLoudness() > AudioAnalysis::kSilence)
+            {
+                ImGui::BulletText("Loudness: %.1f LUFS", track->GetLoudness());
+            }
+            
+            // Other tracks and players holding the same pooled buffer
+            std::shared_ptr<const SampleBuffer> buffer = track->GetBuffer();
+            if (buffer)
+            {
+                ImGui::BulletText("Shared By: %ld users", static_cast<long>(buffer.use_count() - 1));
+            }
         }
         else
         {
@@ -697,22 +1005,37 @@ void DAWImGuiWindow::DrawMixer()
     {
   for (unsigned int i = 0; i < sequencer_->GetChannelCount() && i < 8; ++i)
         {
+            SequencerChannel& channel = *sequencer_->GetAllChannels()[i];
        ImGui::BeginGroup();
             
             char label[16];
          snprintf(label, sizeof(label), "Ch %u", i + 1);
             ImGui::Text("%s", label);
 
-      float vol = 0.75f;
+      float vol = channel.GetVolume();
             snprintf(label, sizeof(label), "##vol%u", i);
-    ImGui::VSliderFloat(label, ImVec2(40, 200), &vol, 0.0f, 1.0f, "");
+    if (ImGui::VSliderFloat(label, ImVec2(40, 200), &vol, 0.0f, 1.0f, ""))
+                channel.SetVolume(vol);
             ImGui::Text("%.2f", vol);
+
+            float pan = channel.GetPan();
+            snprintf(label, sizeof(label), "##pan%u", i);
+            ImGui::SetNextItemWidth(40);
+            if (ImGui::SliderFloat(label, &pan, -1.0f, 1.0f, "%.1f"))
+                channel.SetPan(pan);
          
+            // Lit while engaged
+            bool muted = channel.IsMuted();
+            if (muted) ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.8f, 0.3f, 0.2f, 1.0f));
 snprintf(label, sizeof(label), "M##mute%u", i);
-            if (ImGui::Button(label, ImVec2(40, 20))) {}
+            if (ImGui::Button(label, ImVec2(40, 20))) channel.SetMuted(!muted);
+            if (muted) ImGui::PopStyleColor();
             
+            bool solo = channel.IsSolo();
+            if (solo) ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.8f, 0.7f, 0.2f, 1.0f));
     snprintf(label, sizeof(label), "S##solo%u", i);
-            if (ImGui::Button(label, ImVec2(40, 20))) {}
+            if (ImGui::Button(label, ImVec2(40, 20))) channel.SetSolo(!solo);
+            if (solo) ImGui::PopStyleColor();
       
        ImGui::EndGroup();
             
@@ -792,18 +1115,64 @@ void DAWImGuiWindow::DrawProperties()
         static char projectName[64] = "Untitled Project";
         ImGui::InputText("Name", projectName, sizeof(projectName));
       
-        static int sampleRate = 44100;
-      ImGui::Text("Sample Rate: %d Hz", sampleRate);
-        
-    static int bufferSize = 512;
-        ImGui::SliderInt("Buffer Size", &bufferSize, 64, 2048);
+      ImGui::Text("Sample Rate: %u Hz", daw_->GetTransport()->GetSampleRate());
     }
     
     // Audio settings
  if (ImGui::CollapsingHeader("Audio"))
     {
-        static int device = 0;
-        ImGui::Combo("Output Device", &device, "Default\0Device 1\0Device 2\0");
+        // Requested settings - the device may settle on others, shown below once it is open
+        const char* backendNames[AudioDevice::BACKEND_COUNT];
+        for (int i = 0; i < AudioDevice::BACKEND_COUNT; ++i)
+        {
+            backendNames[i] = AudioDevice::GetBackendName(static_cast<AudioDevice::Backend>(i));
+        }
+        ImGui::Combo("Output Device", &uiState_.audioBackend, backendNames, AudioDevice::BACKEND_COUNT);
+        if (uiState_.audioBackend == AudioDevice::BACKEND_WAV_FILE)
+        {
+            ImGui::InputText("Capture File", uiState_.captureFileBuffer, sizeof(uiState_.captureFileBuffer));
+        }
+        ImGui::InputInt("Sample Rate", &uiState_.audioSampleRate, 0, 0);
+        ImGui::SliderInt("Buffer Size", &uiState_.audioBufferFrames, 64, 4096);
+        
+        AudioDevice::Backend backend = static_cast<AudioDevice::Backend>(uiState_.audioBackend);
+        if (!AudioDevice::IsBackendAvailable(backend))
+        {
+            ImGui::TextDisabled("Not available in this build");
+        }
+        else if (ImGui::Button("Open Device"))
+        {
+            AudioDevice::Config config;
+            config.sampleRate = static_cast<uint32_t>(uiState_.audioSampleRate);
+            config.bufferFrames = static_cast<uint32_t>(uiState_.audioBufferFrames);
+            if (!daw_->SetAudioDevice(AudioDevice::Create(backend, uiState_.captureFileBuffer), config))
+            {
+                printf("Could not open %s output\n", AudioDevice::GetBackendName(backend));
+            }
+        }
+        
+        // Per-block ramps are cheaper, per-sample ones follow fast automation exactly
+        MixEngine& engine = *daw_->GetMixEngine();
+        bool perSample = engine.GetSmoothing() == MixEngine::SMOOTH_PER_SAMPLE;
+        if (ImGui::Checkbox("Per-sample Smoothing", &perSample))
+        {
+            engine.SetSmoothing(perSample ? MixEngine::SMOOTH_PER_SAMPLE : MixEngine::SMOOTH_PER_BLOCK);
+        }
+        
+        if (AudioDevice* device = daw_->GetAudioDevice())
+        {
+            const AudioDevice::Config& config = device->GetConfig();
+            AudioDevice::Stats stats = device->GetStats();
+            ImGui::Separator();
+            ImGui::Text("%s: %u Hz, %u frames (%.2f ms), %u channels", device->GetName(), config.sampleRate,
+                config.bufferFrames, stats.periodMicros / 1000.0, config.channels);
+            ImGui::Text("Callback: %.0f us mean, %.0f us max", stats.meanCallbackMicros, stats.maxCallbackMicros);
+            ImGui::Text("Jitter: %.0f us mean, %.0f us max", stats.meanJitterMicros, stats.maxJitterMicros);
+            ImGui::Text("Load: %.1f%% mean, %.1f%% peak (headroom %.1f%%)", stats.meanLoad * 100.0,
+                stats.peakLoad * 100.0, stats.headroom * 100.0);
+            ImGui::Text("Buffers: %llu  Xruns: %llu", static_cast<unsigned long long>(stats.buffers),
+                static_cast<unsigned long long>(stats.xruns));
+        }
     
         static int inputDevice = 0;
         ImGui::Combo("Input Device", &inputDevice, "Default\0Device 1\0Device 2\0");
@@ -818,6 +1187,54 @@ void DAWImGuiWindow::DrawProperties()
         ImGui::Text("MIDI Input Devices:");
         ImGui::Selectable("No MIDI devices found");
     }
+    
+    // Sample pool usage
+    if (ImGui::CollapsingHeader("Memory"))
+    {
+        SamplePool::Stats pool = SamplePool::GetShared().GetStats();
+        ImGui::Text("Sample Buffers: %u (%.1f MB)", pool.liveBuffers, pool.liveBytes / (1024.0 * 1024.0));
+        ImGui::Text("Shared Loads: %llu from file, %llu by content",
+            static_cast<unsigned long long>(pool.fileHits), static_cast<unsigned long long>(pool.contentHits));
+        ImGui::Text("Memory Saved: %.1f MB", pool.bytesShared / (1024.0 * 1024.0));
+        ImGui::Checkbox("Compact 16/24-bit Storage", &uiState_.compactSampleStorage);
+    }
+    
+    // Persistent decode cache
+    if (ImGui::CollapsingHeader("Decode Cache"))
+    {
+        DecodeCache& cache = DecodeCache::GetShared();
+        DecodeCache::Settings settings = cache.GetSettings();
+        DecodeCache::Stats stats = cache.GetStats();
+        
+        ImGui::TextWrapped("Location: %s", settings.directory.c_str());
+        ImGui::Text("Entries: %u (%.1f MB)", stats.entries, stats.totalBytes / (1024.0 * 1024.0));
+        ImGui::Text("Hits: %llu  Misses: %llu  Evicted: %llu",
+            static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.misses),
+            static_cast<unsigned long long>(stats.evictions));
+        ImGui::Text("Peak Files Opened: %llu", static_cast<unsigned long long>(stats.peakHits));
+        if (stats.pendingStores > 0)
+        {
+            ImGui::Text("Writing %u decoded file(s) in the background", stats.pendingStores);
+        }
+        
+        if (ImGui::Checkbox("Enabled", &settings.enabled))
+        {
+            cache.Configure(settings);
+        }
+        
+        // Applied on release, so dragging the limit down does not evict on every frame
+        ImGui::SliderInt("Size Limit (MB)", &uiState_.decodeCacheBudgetMB, 256, 65536);
+        if (ImGui::IsItemDeactivatedAfterEdit())
+        {
+            settings.maxBytes = static_cast<uint64_t>(uiState_.decodeCacheBudgetMB) * 1024 * 1024;
+            cache.Configure(settings);
+        }
+        
+        if (ImGui::Button("Clear Cache"))
+        {
+            cache.Clear();
+        }
+    }
 
     ImGui::End();
 }
@@ -858,6 +1275,16 @@ void DAWImGuiWindow::OnFileOpen()
     printf("File > Open\n");
 }
 
+void DAWImGuiWindow::OnFileImportFolder()
+{
+    uiState_.showImportDialog = true;
+}
+
+void DAWImGuiWindow::OnFileBounce()
+{
+    uiState_.showBounceDialog = true;
+}
+
 void DAWImGuiWindow::OnFileSave() 
 { 
     printf("File > Save\n");
@@ -915,6 +1342,44 @@ void DAWImGuiWindow::OnHelpAbout()
     uiState_.showAbout = true;
 }
 
+void DAWImGuiWindow::OnHelpBenchmark()
+{
+    StartBenchmark("sample conversion", []()
+    {
+        SampleConvert::PrintBenchmark(SampleConvert::RunBenchmark());
+        SampleBuffer::PrintStorageBenchmark(SampleBuffer::RunStorageBenchmark());
+    });
+}
+
+void DAWImGuiWindow::OnHelpBenchmarkMix()
+{
+    StartBenchmark("mix engine", []()
+    {
+        MixEngine::PrintBenchmark(MixEngine::RunBenchmark(MixEngine::SMOOTH_PER_BLOCK));
+        MixEngine::PrintBenchmark(MixEngine::RunBenchmark(MixEngine::SMOOTH_PER_SAMPLE));
+    });
+}
+
+void DAWImGuiWindow::OnHelpBenchmarkBounce()
+{
+    StartBenchmark("offline bounce", []()
+    {
+        BounceJob::PrintBenchmark(BounceJob::RunBenchmark());
+    });
+}
+
+void DAWImGuiWindow::StartBenchmark(const std::string& name, std::function<void()> run)
+{
+    // Benchmarks take seconds and allocate hundreds of MB - never on the UI thread
+    if (benchmark_.valid())
+    {
+        return;
+    }
+    benchmarkName_ = name;
+    benchmark_ = std::async(std::launch::async, std::move(run));
+    printf("Help > Benchmark %s started\n", name.c_str());
+}
+
 // Transport handlers
 void DAWImGuiWindow::OnPlayClick() 
 { 
@@ -972,7 +1437,7 @@ void DAWImGuiWindow::OnLoadAudio()
     ofn.hwndOwner = glfwGetWin32Window(glfwWindow_);
  ofn.lpstrFile = szFile;
  ofn.nMaxFile = sizeof(szFile);
-     ofn.lpstrFilter = "Audio Files\0*.WAV;*.MP3;*.FLAC;*.OGG\0WAV Files\0*.WAV\0All Files\0*.*\0";
+     ofn.lpstrFilter = "Audio Files\0*.WAV;*.MP3;*.FLAC;*.OGG\0WAV Files\0*.WAV\0FLAC Files\0*.FLAC\0All Files\0*.*\0";
         ofn.nFilterIndex = 1;
         ofn.lpstrFileTitle = NULL;
  ofn.nMaxFileTitle = 0;
@@ -981,15 +1446,7 @@ void DAWImGuiWindow::OnLoadAudio()
         
         if (GetOpenFileNameA(&ofn))
         {
-       auto& track = audioTracks_[selectedTrackIndex_];
-if (track->LoadFromFile(szFile))
-      {
-       printf("Loaded audio file: %s\n", szFile);
-          }
-       else
-            {
-printf("Failed to load audio file: %s\n", szFile);
- }
+       StartLoad(audioTracks_[selectedTrackIndex_], szFile);
      }
     }
     else
@@ -1002,6 +1459,8 @@ void DAWImGuiWindow::OnDeleteTrack()
 {
     if (selectedTrackIndex_ >= 0 && selectedTrackIndex_ < static_cast<int>(audioTracks_.size()))
     {
+        CancelLoad(audioTracks_[selectedTrackIndex_].get());
+        waveformGeometry_.erase(audioTracks_[selectedTrackIndex_].get());
         audioTracks_.erase(audioTracks_.begin() + selectedTrackIndex_);
         selectedTrackIndex_ = -1;
       printf("Track deleted\n");
@@ -1012,6 +1471,64 @@ void DAWImGuiWindow::OnDeleteTrack()
     }
 }
 
+void DAWImGuiWindow::StartLoad(const std::shared_ptr<AudioTrack>& track, const std::string& filePath)
+{
+    // A newer import for the same track replaces the old one
+    CancelLoad(track.get());
+    waveformGeometry_.erase(track.get());
+    
+    AudioTrack::LoadMode mode = uiState_.compactSampleStorage ? AudioTrack::LOAD_COMPACT : AudioTrack::LOAD_EAGER;
+    loadJobs_.push_back(AudioLoadJob::Start(track, filePath, mode));
+    printf("Loading audio file: %s\n", filePath.c_str());
+}
+
+void DAWImGuiWindow::PollLoadJobs()
+{
+    for (size_t i = 0; i < loadJobs_.size(); )
+    {
+        AudioLoadJob::Status status = loadJobs_[i]->Poll();
+        if (status == AudioLoadJob::LOADING)
+        {
+            ++i;
+            continue;
+        }
+        
+        if (status == AudioLoadJob::FAILED)
+        {
+            printf("Failed to load audio file: %s\n", loadJobs_[i]->GetFilePath().c_str());
+        }
+        else if (status == AudioLoadJob::CANCELLED)
+        {
+            printf("Cancelled loading audio file: %s\n", loadJobs_[i]->GetFilePath().c_str());
+        }
+        loadJobs_.erase(loadJobs_.begin() + i);
+    }
+}
+
+void DAWImGuiWindow::CancelLoad(const AudioTrack* track)
+{
+    // Cancelled jobs stay in the list until their loader has wound down
+    for (auto& job : loadJobs_)
+    {
+        if (!job->IsCancelRequested() && job->GetTarget().get() == track)
+        {
+            job->Cancel();
+        }
+    }
+}
+
+AudioLoadJob* DAWImGuiWindow::FindLoadJob(const AudioTrack* track) const
+{
+    for (const auto& job : loadJobs_)
+    {
+        if (!job->IsCancelRequested() && job->GetTarget().get() == track)
+        {
+            return job.get();
+        }
+    }
+    return nullptr;
+}
+
 void DAWImGuiWindow::DrawFileDialog()
 {
     // Simple file path input dialog
@@ -1028,8 +1545,7 @@ void DAWImGuiWindow::DrawFileDialog()
         {
       if (selectedTrackIndex_ >= 0 && selectedTrackIndex_ < static_cast<int>(audioTracks_.size()))
  {
-     auto& track = audioTracks_[selectedTrackIndex_];
-    track->LoadFromFile(uiState_.filePathBuffer);
+     StartLoad(audioTracks_[selectedTrackIndex_], uiState_.filePathBuffer);
   }
       uiState_.showFileDialog = false;
       ImGui::CloseCurrentPopup();
@@ -1046,3 +1562,71 @@ void DAWImGuiWindow::DrawFileDialog()
         ImGui::EndPopup();
     }
 }
+
+void DAWImGuiWindow::DrawImportDialog()
+{
+    ImGui::OpenPopup("Import Folder");
+    
+    if (ImGui::BeginPopupModal("Import Folder", &uiState_.showImportDialog, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::Text("Enter folder path:");
+        ImGui::InputText("##importpath", uiState_.importPathBuffer, sizeof(uiState_.importPathBuffer));
+        
+        ImGui::Separator();
+        
+        if (ImGui::Button("Import", ImVec2(120, 0)))
+        {
+            if (!batchImporter_->StartDirectory(uiState_.importPathBuffer))
+            {
+                printf("Could not start folder import: %s\n", uiState_.importPathBuffer);
+            }
+            uiState_.showImportDialog = false;
+            ImGui::CloseCurrentPopup();
+        }
+        
+        ImGui::SameLine();
+        
+        if (ImGui::Button("Cancel", ImVec2(120, 0)))
+        {
+            uiState_.showImportDialog = false;
+            ImGui::CloseCurrentPopup();
+        }
+        
+        ImGui::EndPopup();
+    }
+}
+
+void DAWImGuiWindow::DrawBounceDialog()
+{
+    ImGui::OpenPopup("Bounce Mix");
+    
+    if (ImGui::BeginPopupModal("Bounce Mix", &uiState_.showBounceDialog, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::Text("Enter output file:");
+        ImGui::InputText("##bouncepath", uiState_.bouncePathBuffer, sizeof(uiState_.bouncePathBuffer));
+        ImGui::Combo("Format", &uiState_.bounceFormat, "16-bit PCM\00024-bit PCM\00032-bit Float\0");
+        
+        ImGui::Separator();
+        
+        if (ImGui::Button("Bounce", ImVec2(120, 0)))
+        {
+            // The whole session from the start, at the device rate, as mixed right now
+            BounceJob::Settings settings;
+            settings.sampleRate = daw_->GetTransport()->GetSampleRate();
+            settings.format = static_cast<WavWriter::SampleFormat>(uiState_.bounceFormat);
+            bounceJob_ = BounceJob::Start(daw_->GetMixEngine()->GetSources(), uiState_.bouncePathBuffer, settings);
+            uiState_.showBounceDialog = false;
+            ImGui::CloseCurrentPopup();
+        }
+        
+        ImGui::SameLine();
+        
+        if (ImGui::Button("Cancel", ImVec2(120, 0)))
+        {
+            uiState_.showBounceDialog = false;
+            ImGui::CloseCurrentPopup();
+        }
+        
+        ImGui::EndPopup();
+    }
+}
@@ -2,8 +2,10 @@
 
 #include <memory>
 #include <vector>
+#include <map>
 #include <functional>
 #include <string>
+#include <future>
 
 // GLFW and OpenGL
 #include <GLFW/glfw3.h>
@@ -17,6 +19,9 @@
 class DAWApplication;
 class SequencerEngine;
 class AudioTrack;
+class AudioLoadJob;
+class BatchImporter;
+class BounceJob;
 
 // Main application window using ImGui
 class DAWImGuiWindow
@@ -45,6 +50,19 @@ private:
     // Audio tracks
   std::vector<std::shared_ptr<AudioTrack>> audioTracks_;
     int selectedTrackIndex_;
+    
+    // Imports running in the background, polled once per frame
+    std::vector<std::shared_ptr<AudioLoadJob>> loadJobs_;
+    
+    // Folder imports - each file becomes a sequencer channel
+    std::unique_ptr<BatchImporter> batchImporter_;
+    
+    // Offline mixdown in progress, polled once per frame
+    std::shared_ptr<BounceJob> bounceJob_;
+    
+    // Help menu benchmark running in the background, polled once per frame - results go to the console
+    std::future<void> benchmark_;
+    std::string benchmarkName_;
 
     // Window state
     bool isRunning_ = true;
@@ -71,22 +89,84 @@ private:
         // File dialog state
         bool showFileDialog = false;
  char filePathBuffer[512] = "";
+        
+        // Folder import dialog state
+        bool showImportDialog = false;
+        char importPathBuffer[512] = "";
+        
+        // Bounce dialog state
+        bool showBounceDialog = false;
+        char bouncePathBuffer[512] = "bounce.wav";
+        int bounceFormat = 1;            // WavWriter::SampleFormat
+        
+        // Keep 16/24-bit files native in memory (AudioTrack::LOAD_COMPACT)
+        bool compactSampleStorage = false;
+        
+        // DecodeCache size limit being edited, starts at DecodeCache::kDefaultMaxBytes
+        int decodeCacheBudgetMB = 4096;
+        
+        // Output device requested in Properties > Audio, applied with its Open button
+        int audioBackend = 0;            // AudioDevice::Backend
+        int audioSampleRate = 44100;
+        int audioBufferFrames = 512;
+        char captureFileBuffer[512] = "capture.wav";
+        
+        // Draw each channel of the selected track in its own waveform lane
+        bool waveformChannelLanes = true;
+        
+        // Part of the selected track shown in the waveform view, in frames; 0 frames shows the whole track
+        double waveformViewStart = 0.0;
+        double waveformViewFrames = 0.0;
     } uiState_;
 
+    // Waveform of one track as a triangle mesh, rebuilt only when its view changes, so an unchanged
+    // frame appends it to the draw list as a block instead of adding a line per pixel column
+    struct WaveformView
+    {
+        const void* source;     // Peak pyramid the mesh was built from, or the track if it has none
+        uint32_t validFrames;   // Grows while the track loads
+        uint32_t firstFrame;
+        uint32_t endFrame;
+        uint16_t numLanes;
+        ImVec2 pos;
+        ImVec2 size;
+        ImVec2 whitePixelUV;    // Of the font atlas the vertices were made for
+    };
+    struct WaveformGeometry
+    {
+        WaveformView view;
+        bool valid = false;
+        std::vector<ImDrawVert> vertices; // Top and bottom of every pixel column, lane by lane, in screen space
+        std::vector<ImDrawIdx> indices;   // Triangles of one lane, relative to the lane's first vertex
+        int verticesPerLane = 0;
+        float viewPeak = 0.0f;            // Statistics of the view, for the info text
+        float viewRMS = 0.0f;
+    };
+    std::map<const AudioTrack*, WaveformGeometry> waveformGeometry_;
+
     // UI rendering methods
     void DrawMenuBar();
     void DrawTransport();
     void DrawSequencer();
     void DrawInspector();
+    // Returns false, after resetting geometry for view, unless it already holds the mesh for view
+    static bool PrepareWaveformGeometry(WaveformGeometry& geometry, const WaveformView& view);
+    static void AddWaveformLane(WaveformGeometry& geometry, const ImVec2& pos, const ImVec2& size,
+                                const std::vector<float>& minVals, const std::vector<float>& maxVals);
+    static void DrawWaveformGeometry(ImDrawList* drawList, const WaveformGeometry& geometry);
     void DrawMixer();
     void DrawBrowser();
   void DrawProperties();
     void DrawAbout();
     void DrawFileDialog();
+    void DrawImportDialog();
+    void DrawBounceDialog();
 
     // Menu handlers
     void OnFileNew();
     void OnFileOpen();
+    void OnFileImportFolder();
+    void OnFileBounce();
     void OnFileSave();
     void OnFileSaveAs();
   void OnFileExit();
@@ -98,6 +178,10 @@ private:
     void OnEditDelete();
     void OnEditSelectAll();
     void OnHelpAbout();
+    void OnHelpBenchmark();
+    void OnHelpBenchmarkMix();
+    void OnHelpBenchmarkBounce();
+    void StartBenchmark(const std::string& name, std::function<void()> run);
 
     // Transport handlers
     void OnPlayClick();
@@ -110,6 +194,12 @@ private:
     void OnAddTrack();
     void OnLoadAudio();
  void OnDeleteTrack();
+    
+    // Background imports
+    void StartLoad(const std::shared_ptr<AudioTrack>& track, const std::string& filePath);
+    void PollLoadJobs();
+    void CancelLoad(const AudioTrack* track);
+    AudioLoadJob* FindLoadJob(const AudioTrack* track) const;
 
     // Helper methods
     void SetupImGui();
@@ -421,6 +421,8 @@ LRESULT DAWWindow::HandleMessage(UINT message, WPARAM wParam, LPARAM lParam)
     case WM_TIMER:
      if (wParam == RENDER_TIMER_ID)
       {
+            // Keeps the mix engine's channels and transport in step with the session
+            if (daw_) daw_->Update();
       RedrawAll();
             return 0;
         }
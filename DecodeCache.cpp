@@ -0,0 +1,674 @@
+#include "DecodeCache.h"
+#include "AudioAnalysis.h"
+#include "MappedFile.h"
+#include "SamplePool.h"
+#include "PeakPyramid.h"
+#include "PeakFile.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+
+// Header block in front of the samples - a multiple of 64 keeps the channels aligned in the mapping
+static const size_t kHeaderBytes = 4096;
+static const char kMagic[8] = { 'E', 'X', 'D', 'A', 'W', 'D', 'C', 0 };
+static const uint32_t kVersion = 3;
+static const char* const kEntryExtension = ".dcache";
+static const char* const kTempExtension = ".tmp";
+
+// Fixed part of the header, followed by the normalized source path
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pathLength;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t contentHash;
+    uint64_t channelStride;
+    uint64_t samplesOffset;
+    uint32_t numFrames;
+    uint32_t sampleRate;
+    uint16_t channels;
+    uint16_t bitsPerSample;
+    uint32_t storage;
+    float peak;
+    float rms;
+    float loudness;
+    uint32_t reserved;
+};
+
+static_assert(kHeaderBytes % SampleBuffer::kAlignment == 0, "Samples must start on a cache line");
+static_assert(sizeof(CacheHeader) < kHeaderBytes, "Header does not fit its block");
+
+static const size_t kMaxPathLength = kHeaderBytes - sizeof(CacheHeader);
+
+static std::string GetEnvironment(const char* name)
+{
+#ifdef _MSC_VER
+    char* value = nullptr;
+    size_t length = 0;
+    if (_dupenv_s(&value, &length, name) != 0 || !value)
+    {
+        return std::string();
+    }
+    std::string result(value);
+    free(value);
+    return result;
+#else
+    const char* value = std::getenv(name);
+    return value ? std::string(value) : std::string();
+#endif
+}
+
+// Absolute, normalized and - on Windows - case-folded, so one file always has one key
+static std::string NormalizePath(const std::string& filePath)
+{
+    std::error_code error;
+    fs::path path = fs::absolute(fs::path(filePath), error);
+    std::string result = (error ? fs::path(filePath) : path).lexically_normal().string();
+#ifdef _WIN32
+    std::transform(result.begin(), result.end(), result.begin(), [](char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+#endif
+    return result;
+}
+
+// FNV-1a of the normalized path names the entry files - samples and peaks differ by extension
+static std::string EntryFileName(const std::string& key, const char* extension)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : key)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return std::string(name) + extension;
+}
+
+DecodeCache::Settings::Settings()
+    : directory(DecodeCache::GetDefaultDirectory())
+    , maxBytes(kDefaultMaxBytes)
+    , enabled(true)
+{
+}
+
+DecodeCache& DecodeCache::GetShared()
+{
+    static DecodeCache cache;
+    return cache;
+}
+
+DecodeCache::~DecodeCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(storeMutex_);
+        stopStores_.store(true);
+        pendingStores_.clear();
+    }
+    storeWake_.notify_all();
+    if (storeThread_.joinable())
+    {
+        storeThread_.join();
+    }
+}
+
+std::string DecodeCache::GetDefaultDirectory()
+{
+#ifdef _WIN32
+    std::string base = GetEnvironment("LOCALAPPDATA");
+#else
+    std::string base = GetEnvironment("XDG_CACHE_HOME");
+    if (base.empty())
+    {
+        std::string home = GetEnvironment("HOME");
+        if (!home.empty())
+        {
+            base = (fs::path(home) / ".cache").string();
+        }
+    }
+#endif
+    if (base.empty())
+    {
+        std::error_code error;
+        base = fs::temp_directory_path(error).string();
+    }
+    return (fs::path(base) / "exeDAW" / "DecodeCache").string();
+}
+
+void DecodeCache::Configure(const Settings& settings)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (settings.directory != settings_.directory)
+    {
+        index_.clear();
+        indexLoaded_ = false;
+        totalBytes_ = 0;
+    }
+    settings_ = settings;
+
+    if (settings_.enabled)
+    {
+        LoadIndex();
+        EvictToBudget(std::string());
+    }
+}
+
+DecodeCache::Settings DecodeCache::GetSettings() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return settings_;
+}
+
+std::unique_ptr<SampleBuffer> DecodeCache::Find(const std::string& sourcePath, bool allowCompact)
+{
+    Settings settings = GetSettings();
+    if (!settings.enabled)
+    {
+        return nullptr;
+    }
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!SamplePool::GetFileIdentity(sourcePath, sourceSize, sourceTime))
+    {
+        return nullptr;
+    }
+
+    const std::string key = NormalizePath(sourcePath);
+    const fs::path entryPath = fs::path(settings.directory) / EntryFileName(key, kEntryExtension);
+
+    auto mapping = std::make_unique<MappedFile>();
+    if (!mapping->Open(entryPath.string()))
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++misses_;
+        return nullptr;
+    }
+
+    CacheHeader header;
+    bool valid = mapping->GetSize() >= kHeaderBytes;
+    if (valid)
+    {
+        memcpy(&header, mapping->GetData(), sizeof(header));
+        // Sizes are checked by division, so a damaged header cannot wrap its way past the bounds test
+        const uint64_t fileSize = mapping->GetSize();
+        valid = memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == kVersion &&
+            header.pathLength == key.size() && key.size() <= kMaxPathLength &&
+            memcmp(mapping->GetData() + sizeof(CacheHeader), key.data(), key.size()) == 0 &&
+            header.storage <= SampleBuffer::STORAGE_INT24 && header.channels > 0 &&
+            header.samplesOffset <= fileSize && header.channelStride <= SIZE_MAX &&
+            header.channelStride <= (fileSize - header.samplesOffset) / header.channels;
+    }
+
+    // An entry for an older version of the source is dead weight
+    bool stale = !valid || header.sourceSize != sourceSize || header.sourceTime != sourceTime;
+    if (stale || !SamplePool::IsStorageAllowed(static_cast<SampleBuffer::Storage>(header.storage),
+                                                header.bitsPerSample, allowCompact))
+    {
+        mapping.reset();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stale)
+        {
+            RemoveEntry(entryPath);
+        }
+        ++misses_;
+        return nullptr;
+    }
+
+    auto analysis = std::make_shared<AudioAnalysis>();
+    analysis->peak = header.peak;
+    analysis->rms = header.rms;
+    analysis->loudness = header.loudness;
+
+    std::unique_ptr<SampleBuffer> buffer = SampleBuffer::FromMapping(std::move(mapping), header.samplesOffset,
+        static_cast<size_t>(header.channelStride), header.numFrames, header.sampleRate, header.channels,
+        header.bitsPerSample, static_cast<SampleBuffer::Storage>(header.storage), header.contentHash);
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        RemoveEntry(entryPath);
+        ++misses_;
+        return nullptr;
+    }
+
+    // Peaks evicted on their own, or from an older version, are rebuilt from the mapped samples
+    analysis->peaks = FindPeaks(sourcePath);
+    if (!analysis->peaks || analysis->peaks->GetNumFrames() != buffer->GetNumFrames() ||
+        analysis->peaks->GetNumChannels() != buffer->GetNumChannels())
+    {
+        analysis->peaks = StorePeaks(sourcePath, PeakPyramid::Build(*buffer));
+    }
+    buffer->SetAnalysis(std::move(analysis));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++hits_;
+    TouchEntry(entryPath);
+    return buffer;
+}
+
+bool DecodeCache::Store(const std::string& sourcePath, const SampleBuffer& buffer)
+{
+    Settings settings = GetSettings();
+    const std::shared_ptr<const AudioAnalysis>& analysis = buffer.GetAnalysis();
+    if (!settings.enabled || buffer.IsMapped() || !analysis || buffer.GetNumFrames() == 0)
+    {
+        return false;
+    }
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!SamplePool::GetFileIdentity(sourcePath, sourceSize, sourceTime))
+    {
+        return false;
+    }
+
+    const std::string key = NormalizePath(sourcePath);
+    const uint64_t samplesBytes = buffer.GetSizeBytes();
+    const uint64_t fileBytes = kHeaderBytes + samplesBytes;
+    if (key.size() > kMaxPathLength || fileBytes > settings.maxBytes)
+    {
+        return false;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.pathLength = static_cast<uint32_t>(key.size());
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.contentHash = buffer.GetContentHash();
+    header.channelStride = buffer.GetChannelStride();
+    header.samplesOffset = kHeaderBytes;
+    header.numFrames = buffer.GetNumFrames();
+    header.sampleRate = buffer.GetSampleRate();
+    header.channels = buffer.GetNumChannels();
+    header.bitsPerSample = buffer.GetBitsPerSample();
+    header.storage = buffer.GetStorage();
+    header.peak = analysis->peak;
+    header.rms = analysis->rms;
+    header.loudness = analysis->loudness;
+
+    const fs::path directory(settings.directory);
+    const fs::path entryPath = directory / EntryFileName(key, kEntryExtension);
+
+    // Nothing to do if the entry already holds exactly this
+    {
+        std::ifstream existing(entryPath, std::ios::binary);
+        CacheHeader current;
+        if (existing.read(reinterpret_cast<char*>(&current), sizeof(current)) &&
+            memcmp(&current, &header, sizeof(header)) == 0)
+        {
+            return true;
+        }
+    }
+
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    fs::path tempPath;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tempPath = entryPath;
+        tempPath += "." + std::to_string(++tempCounter_) + kTempExtension;
+    }
+
+    // Write beside the entry and rename over it, so a reader never maps a half-written file
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        std::vector<char> headerBlock(kHeaderBytes, 0);
+        memcpy(headerBlock.data(), &header, sizeof(header));
+        memcpy(headerBlock.data() + sizeof(header), key.data(), key.size());
+        file.write(headerBlock.data(), headerBlock.size());
+
+        for (uint16_t ch = 0; ch < buffer.GetNumChannels() && file && !stopStores_.load(); ++ch)
+        {
+            file.write(reinterpret_cast<const char*>(buffer.GetChannelBytes(ch)),
+                static_cast<std::streamsize>(buffer.GetChannelStride()));
+        }
+        file.close();
+
+        if (stopStores_.load())
+        {
+            fs::remove(tempPath, error);
+            return false;
+        }
+        if (!file)
+        {
+            printf("Decode cache: could not write %s\n", tempPath.string().c_str());
+            fs::remove(tempPath, error);
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    LoadIndex();
+
+    // Fails on Windows while the old entry is still mapped by a loaded track - keep that one
+    fs::rename(tempPath, entryPath, error);
+    if (error)
+    {
+        fs::remove(tempPath, error);
+        return false;
+    }
+
+    const std::string name = entryPath.filename().string();
+    auto it = index_.find(name);
+    if (it != index_.end())
+    {
+        totalBytes_ -= it->second.bytes;
+    }
+    index_[name] = IndexEntry{ fileBytes, fs::file_time_type::clock::now() };
+    totalBytes_ += fileBytes;
+    ++stores_;
+
+    EvictToBudget(name);
+    return true;
+}
+
+void DecodeCache::StoreAsync(const std::string& sourcePath, std::shared_ptr<const SampleBuffer> buffer)
+{
+    if (!buffer || buffer->IsMapped() || !GetSettings().enabled)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(storeMutex_);
+        if (stopStores_.load())
+        {
+            return;
+        }
+        // A second load of the same file while the first is still queued has nothing new to write
+        for (const PendingStore& pending : pendingStores_)
+        {
+            if (pending.sourcePath == sourcePath && pending.buffer == buffer)
+            {
+                return;
+            }
+        }
+        pendingStores_.push_back(PendingStore{ sourcePath, std::move(buffer) });
+        if (!storeThread_.joinable())
+        {
+            storeThread_ = std::thread(&DecodeCache::StoreThread, this);
+        }
+    }
+    storeWake_.notify_one();
+}
+
+void DecodeCache::WaitForStores()
+{
+    std::unique_lock<std::mutex> lock(storeMutex_);
+    storeDone_.wait(lock, [this] { return (pendingStores_.empty() && !storing_) || stopStores_.load(); });
+}
+
+void DecodeCache::StoreThread()
+{
+    std::unique_lock<std::mutex> lock(storeMutex_);
+    while (!stopStores_.load())
+    {
+        if (pendingStores_.empty())
+        {
+            storeDone_.notify_all();
+            storeWake_.wait(lock);
+            continue;
+        }
+
+        PendingStore pending = std::move(pendingStores_.front());
+        pendingStores_.pop_front();
+        storing_ = true;
+        lock.unlock();
+
+        Store(pending.sourcePath, *pending.buffer);
+        pending.buffer.reset();
+
+        lock.lock();
+        storing_ = false;
+    }
+    storeDone_.notify_all();
+}
+
+std::shared_ptr<const PeakPyramid> DecodeCache::FindPeaks(const std::string& sourcePath)
+{
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!SamplePool::GetFileIdentity(sourcePath, sourceSize, sourceTime))
+    {
+        return nullptr;
+    }
+
+    // A sidecar may have been written on another machine, so only its source's size and time must match
+    std::shared_ptr<const PeakPyramid> peaks = PeakFile::Open(sourcePath + PeakFile::kExtension, std::string(), sourceSize, sourceTime);
+    if (peaks && peaks->GetSource() == PeakPyramid::SOURCE_CHANNELS)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++peakHits_;
+        return peaks;
+    }
+
+    Settings settings = GetSettings();
+    if (!settings.enabled)
+    {
+        return nullptr;
+    }
+
+    const std::string key = NormalizePath(sourcePath);
+    const fs::path entryPath = fs::path(settings.directory) / EntryFileName(key, PeakFile::kExtension);
+    peaks = PeakFile::Open(entryPath.string(), key, sourceSize, sourceTime);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!peaks || peaks->GetSource() != PeakPyramid::SOURCE_CHANNELS)
+    {
+        // Missing, or for an older version of the source
+        RemoveEntry(entryPath);
+        return nullptr;
+    }
+    ++peakHits_;
+    TouchEntry(entryPath);
+    return peaks;
+}
+
+std::shared_ptr<const PeakPyramid> DecodeCache::StorePeaks(const std::string& sourcePath, std::shared_ptr<const PeakPyramid> peaks)
+{
+    Settings settings = GetSettings();
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!settings.enabled || !peaks || peaks->IsMapped() || !peaks->IsComplete() ||
+        !SamplePool::GetFileIdentity(sourcePath, sourceSize, sourceTime))
+    {
+        return peaks;
+    }
+
+    const std::string key = NormalizePath(sourcePath);
+    const fs::path directory(settings.directory);
+    const fs::path entryPath = directory / EntryFileName(key, PeakFile::kExtension);
+
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    fs::path tempPath;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tempPath = entryPath;
+        tempPath += "." + std::to_string(++tempCounter_) + kTempExtension;
+    }
+    if (!PeakFile::Write(tempPath.string(), *peaks, key, sourceSize, sourceTime))
+    {
+        fs::remove(tempPath, error);
+        return peaks;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        LoadIndex();
+
+        // Fails on Windows while the old file is still mapped by a loaded track - keep that one
+        fs::rename(tempPath, entryPath, error);
+        if (error)
+        {
+            fs::remove(tempPath, error);
+            return peaks;
+        }
+
+        const std::string name = entryPath.filename().string();
+        const uint64_t fileBytes = fs::file_size(entryPath, error);
+        auto it = index_.find(name);
+        if (it != index_.end())
+        {
+            totalBytes_ -= it->second.bytes;
+        }
+        index_[name] = IndexEntry{ error ? 0 : fileBytes, fs::file_time_type::clock::now() };
+        totalBytes_ += index_[name].bytes;
+        EvictToBudget(name);
+    }
+
+    std::shared_ptr<const PeakPyramid> mapped = PeakFile::Open(entryPath.string(), key, sourceSize, sourceTime);
+    return mapped ? mapped : peaks;
+}
+
+void DecodeCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    LoadIndex();
+
+    const fs::path directory(settings_.directory);
+    std::vector<std::string> names;
+    for (const auto& entry : index_)
+    {
+        names.push_back(entry.first);
+    }
+    for (const std::string& name : names)
+    {
+        RemoveEntry(directory / name);
+    }
+}
+
+DecodeCache::Stats DecodeCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    LoadIndex();
+
+    Stats stats;
+    stats.entries = static_cast<uint32_t>(index_.size());
+    stats.totalBytes = totalBytes_;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.stores = stores_;
+    stats.evictions = evictions_;
+    stats.peakHits = peakHits_;
+
+    std::lock_guard<std::mutex> storeLock(storeMutex_);
+    stats.pendingStores = static_cast<uint32_t>(pendingStores_.size()) + (storing_ ? 1 : 0);
+    return stats;
+}
+
+void DecodeCache::LoadIndex()
+{
+    if (indexLoaded_)
+    {
+        return;
+    }
+    indexLoaded_ = true;
+
+    std::error_code error;
+    fs::directory_iterator it(settings_.directory, error);
+    for (; !error && it != fs::directory_iterator(); it.increment(error))
+    {
+        const fs::path& path = it->path();
+        std::error_code entryError;
+        if (!it->is_regular_file(entryError))
+        {
+            continue;
+        }
+
+        // Left behind by a store that never finished
+        if (path.extension() == kTempExtension)
+        {
+            fs::remove(path, entryError);
+            continue;
+        }
+        if (path.extension() != kEntryExtension && path.extension() != PeakFile::kExtension)
+        {
+            continue;
+        }
+
+        uint64_t bytes = it->file_size(entryError);
+        fs::file_time_type lastUse = it->last_write_time(entryError);
+        if (!entryError)
+        {
+            index_[path.filename().string()] = IndexEntry{ bytes, lastUse };
+            totalBytes_ += bytes;
+        }
+    }
+}
+
+void DecodeCache::TouchEntry(const fs::path& path)
+{
+    // Record the use on disk too, so the LRU order survives a restart
+    std::error_code error;
+    fs::file_time_type now = fs::file_time_type::clock::now();
+    fs::last_write_time(path, now, error);
+    LoadIndex();
+    auto it = index_.find(path.filename().string());
+    if (it != index_.end())
+    {
+        it->second.lastUse = now;
+    }
+}
+
+void DecodeCache::RemoveEntry(const fs::path& path)
+{
+    // An entry still mapped on Windows cannot be deleted; it stays until it is released
+    std::error_code error;
+    if (!fs::remove(path, error) && error)
+    {
+        return;
+    }
+
+    auto it = index_.find(path.filename().string());
+    if (it != index_.end())
+    {
+        totalBytes_ -= it->second.bytes;
+        index_.erase(it);
+    }
+}
+
+void DecodeCache::EvictToBudget(const std::string& keepName)
+{
+    if (totalBytes_ <= settings_.maxBytes)
+    {
+        return;
+    }
+
+    // Oldest use first
+    std::vector<std::pair<fs::file_time_type, std::string>> order;
+    for (const auto& entry : index_)
+    {
+        if (entry.first != keepName)
+        {
+            order.emplace_back(entry.second.lastUse, entry.first);
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    const fs::path directory(settings_.directory);
+    for (size_t i = 0; i < order.size() && totalBytes_ > settings_.maxBytes; ++i)
+    {
+        size_t before = index_.size();
+        RemoveEntry(directory / order[i].second);
+        if (index_.size() < before)
+        {
+            ++evictions_;
+        }
+    }
+}
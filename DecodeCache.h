@@ -0,0 +1,130 @@
+#pragma once
+
+#include "SampleBuffer.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <filesystem>
+#include <cstdint>
+
+class PeakPyramid;
+
+// Decode Cache - persistent on-disk cache of decoded samples and their AudioAnalysis.
+// One file per source, keyed by path and checked against the source's size, modification
+// time and content hash. Samples are stored in SampleBuffer's own layout (64-byte aligned
+// channels), so reopening a project maps them back in place with no decode and no copy.
+// Peak pyramids are kept apart as PeakFiles, small enough to outlive their samples in the
+// budget, so a waveform can be drawn before the samples are decoded or while they stay mapped.
+// The directory is kept under a size budget by evicting the least recently used entries.
+class DecodeCache
+{
+public:
+    struct Settings
+    {
+        std::string directory;
+        uint64_t maxBytes;
+        bool enabled;
+
+        Settings();
+    };
+
+    struct Stats
+    {
+        uint32_t entries = 0;
+        uint64_t totalBytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stores = 0;
+        uint64_t evictions = 0;
+        uint64_t peakHits = 0;
+        uint32_t pendingStores = 0;  // Queued for the background writer
+    };
+
+    static constexpr uint64_t kDefaultMaxBytes = 4ull * 1024 * 1024 * 1024;
+
+    static DecodeCache& GetShared();
+
+    // Change directory or budget; entries over a smaller budget are evicted right away
+    void Configure(const Settings& settings);
+    Settings GetSettings() const;
+
+    // Sealed, mapped buffer with analysis attached, or nullptr if there is no valid entry for
+    // the file as it is on disk now. Storage is matched as in SamplePool::IsStorageAllowed().
+    std::unique_ptr<SampleBuffer> Find(const std::string& sourcePath, bool allowCompact);
+
+    // Write buffer as the entry for sourcePath. Mapped buffers and sources that cannot be
+    // identified on disk are skipped. Synchronous - writes the whole buffer before it returns.
+    bool Store(const std::string& sourcePath, const SampleBuffer& buffer);
+
+    // Store() on a background writer thread, so a load is not held up by writing its samples out.
+    // The buffer, which must be sealed, is kept alive until it is written. Stores still queued at
+    // exit are dropped.
+    void StoreAsync(const std::string& sourcePath, std::shared_ptr<const SampleBuffer> buffer);
+
+    // Block until every queued store has been written
+    void WaitForStores();
+
+    // Mapped peak pyramid of sourcePath as it is on disk now, or nullptr. A "<source>.peaks" sidecar
+    // beside the source is used first, even with the cache disabled; then the cache's own entry.
+    std::shared_ptr<const PeakPyramid> FindPeaks(const std::string& sourcePath);
+
+    // Write peaks, which must be complete, as the peak file for sourcePath and return them mapped
+    // back from it, so the heap copy can go. Returns peaks itself if they could not be stored.
+    std::shared_ptr<const PeakPyramid> StorePeaks(const std::string& sourcePath, std::shared_ptr<const PeakPyramid> peaks);
+
+    // Delete every entry that is not in use
+    void Clear();
+
+    Stats GetStats();
+
+    // Per-user cache location, e.g. %LOCALAPPDATA%\exeDAW\DecodeCache
+    static std::string GetDefaultDirectory();
+
+private:
+    struct IndexEntry
+    {
+        uint64_t bytes;
+        std::filesystem::file_time_type lastUse;
+    };
+
+    mutable std::mutex mutex_;
+    Settings settings_;
+    std::map<std::string, IndexEntry> index_; // Entry file name -> size and last use
+    bool indexLoaded_ = false;
+    uint64_t totalBytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t stores_ = 0;
+    uint64_t evictions_ = 0;
+    uint64_t peakHits_ = 0;
+    uint64_t tempCounter_ = 0;
+
+    // Background writer - its own lock, so a long write never blocks lookups
+    struct PendingStore
+    {
+        std::string sourcePath;
+        std::shared_ptr<const SampleBuffer> buffer;
+    };
+    std::mutex storeMutex_;
+    std::condition_variable storeWake_;
+    std::condition_variable storeDone_;
+    std::deque<PendingStore> pendingStores_;
+    bool storing_ = false;                  // The writer is busy with a store it has taken off the queue
+    std::thread storeThread_;
+    std::atomic<bool> stopStores_{ false }; // Also aborts a store being written
+
+    DecodeCache() {}
+    ~DecodeCache();
+
+    void StoreThread();
+
+    void TouchEntry(const std::filesystem::path& path);    // Requires mutex_
+    void LoadIndex();                                   // Requires mutex_
+    void RemoveEntry(const std::filesystem::path& path); // Requires mutex_
+    void EvictToBudget(const std::string& keepName);     // Requires mutex_
+};
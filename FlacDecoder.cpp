@@ -0,0 +1,891 @@
+#include "FlacDecoder.h"
+#include "SampleBuffer.h"
+#include "ThreadPool.h"
+#include "AudioTrack.h"
+#include "PeakPyramid.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Compressed bytes per parallel decode task - a few dozen frames
+static const size_t kDecodeGroupBytes = 512 * 1024;
+
+// Samples wider than this do not fit the int32 decode path once a side channel adds its extra bit
+static const uint16_t kMaxBitsPerSample = 24;
+
+static const uint8_t kFlacMarker[4] = { 'f', 'L', 'a', 'C' };
+
+struct CrcTables
+{
+    uint8_t crc8[256];   // Frame header, polynomial x^8 + x^2 + x + 1
+    uint16_t crc16[256]; // Whole frame, polynomial x^16 + x^15 + x^2 + 1
+
+    CrcTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            uint8_t c8 = static_cast<uint8_t>(i);
+            uint16_t c16 = static_cast<uint16_t>(i << 8);
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                c8 = static_cast<uint8_t>((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+                c16 = static_cast<uint16_t>((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+            }
+            crc8[i] = c8;
+            crc16[i] = c16;
+        }
+    }
+};
+
+static const CrcTables& GetCrcTables()
+{
+    static const CrcTables tables;
+    return tables;
+}
+
+static uint8_t Crc8(const uint8_t* data, size_t size)
+{
+    const CrcTables& tables = GetCrcTables();
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = tables.crc8[crc ^ data[i]];
+    }
+    return crc;
+}
+
+static uint16_t Crc16(const uint8_t* data, size_t size)
+{
+    const CrcTables& tables = GetCrcTables();
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = static_cast<uint16_t>((crc << 8) ^ tables.crc16[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+static inline int CountLeadingZeros(uint64_t value) // value != 0
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+    {
+        return 31 - static_cast<int>(index);
+    }
+    _BitScanReverse(&index, static_cast<unsigned long>(value));
+    return 63 - static_cast<int>(index);
+#else
+    return __builtin_clzll(value);
+#endif
+}
+
+// MSB-first bit reader over one frame. Reads past the end return zeros and are
+// caught by IsOverrun() once the frame is done.
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, size_t size)
+        : data_(data), size_(size), position_(0), cache_(0), cachedBits_(0)
+    {
+    }
+
+    uint32_t Read(unsigned bits) // 0-32
+    {
+        if (bits == 0)
+        {
+            return 0;
+        }
+        if (cachedBits_ < bits)
+        {
+            Refill();
+        }
+        uint32_t value = static_cast<uint32_t>(cache_ >> (64 - bits));
+        cache_ <<= bits;
+        cachedBits_ -= bits;
+        return value;
+    }
+
+    int32_t ReadSigned(unsigned bits)
+    {
+        if (bits == 0)
+        {
+            return 0;
+        }
+        uint32_t value = Read(bits);
+        return static_cast<int32_t>(value << (32 - bits)) >> (32 - bits);
+    }
+
+    // Number of 0 bits before the next 1
+    uint32_t ReadUnary()
+    {
+        uint32_t count = 0;
+        for (;;)
+        {
+            if (cache_ != 0)
+            {
+                unsigned zeros = static_cast<unsigned>(CountLeadingZeros(cache_));
+                count += zeros;
+                cache_ = zeros + 1 < 64 ? cache_ << (zeros + 1) : 0;
+                cachedBits_ -= zeros + 1;
+                return count;
+            }
+
+            count += cachedBits_;
+            cachedBits_ = 0;
+            if (position_ > size_ + 8)
+            {
+                return count; // Ran off the frame - the overrun check rejects it
+            }
+            Refill();
+        }
+    }
+
+    int32_t ReadRice(unsigned parameter)
+    {
+        uint32_t value = (ReadUnary() << parameter) | Read(parameter);
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+
+    void AlignToByte()
+    {
+        unsigned skip = cachedBits_ & 7;
+        cache_ <<= skip;
+        cachedBits_ -= skip;
+    }
+
+    void SkipBytes(size_t bytes)
+    {
+        // Only used on byte boundaries before anything is cached
+        position_ += bytes;
+    }
+
+    uint64_t GetBitPosition() const { return static_cast<uint64_t>(position_) * 8 - cachedBits_; }
+    bool IsOverrun() const { return GetBitPosition() > static_cast<uint64_t>(size_) * 8; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_;   // Next byte to load into the cache
+    uint64_t cache_;    // Unread bits, MSB first
+    unsigned cachedBits_;
+
+    void Refill()
+    {
+        // Whole bytes that still fit in the cache
+        unsigned freeBytes = (64 - cachedBits_) >> 3;
+        if (freeBytes == 0)
+        {
+            return;
+        }
+        if (position_ + 8 <= size_)
+        {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                word = (word << 8) | data_[position_ + i];
+            }
+            unsigned newBits = freeBytes * 8;
+            cache_ |= (word >> (64 - newBits)) << (64 - cachedBits_ - newBits);
+            cachedBits_ += newBits;
+            position_ += freeBytes;
+            return;
+        }
+
+        for (unsigned i = 0; i < freeBytes; ++i)
+        {
+            uint64_t byte = position_ < size_ ? data_[position_] : 0;
+            cache_ |= byte << (56 - cachedBits_);
+            cachedBits_ += 8;
+            ++position_;
+        }
+    }
+};
+
+static bool DecodeResidual(BitReader& reader, uint32_t blockSize, uint32_t order, int32_t* out)
+{
+    uint32_t method = reader.Read(2);
+    if (method > 1)
+    {
+        return false;
+    }
+    const unsigned parameterBits = method == 0 ? 4 : 5;
+    const uint32_t escapeParameter = method == 0 ? 15 : 31;
+
+    uint32_t partitionOrder = reader.Read(4);
+    uint32_t partitionSize = blockSize >> partitionOrder;
+    if ((partitionSize << partitionOrder) != blockSize || partitionSize < order)
+    {
+        return false;
+    }
+
+    uint32_t index = order;
+    for (uint32_t partition = 0; partition < (1u << partitionOrder); ++partition)
+    {
+        uint32_t count = partition == 0 ? partitionSize - order : partitionSize;
+        uint32_t parameter = reader.Read(parameterBits);
+        if (parameter == escapeParameter)
+        {
+            // Unencoded partition: fixed-width signed samples
+            unsigned bits = reader.Read(5);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                out[index++] = reader.ReadSigned(bits);
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                out[index++] = reader.ReadRice(parameter);
+            }
+        }
+    }
+    return true;
+}
+
+static bool DecodeSubframe(BitReader& reader, unsigned bitsPerSample, uint32_t blockSize, int32_t* out)
+{
+    if (reader.Read(1) != 0)
+    {
+        return false;
+    }
+    uint32_t type = reader.Read(6);
+
+    // Wasted bits - low bits that are zero in every sample of the subframe
+    unsigned wastedBits = 0;
+    if (reader.Read(1))
+    {
+        wastedBits = reader.ReadUnary() + 1;
+        if (wastedBits >= bitsPerSample)
+        {
+            return false;
+        }
+        bitsPerSample -= wastedBits;
+    }
+
+    if (type == 0)
+    {
+        // CONSTANT
+        std::fill(out, out + blockSize, reader.ReadSigned(bitsPerSample));
+    }
+    else if (type == 1)
+    {
+        // VERBATIM
+        for (uint32_t i = 0; i < blockSize; ++i)
+        {
+            out[i] = reader.ReadSigned(bitsPerSample);
+        }
+    }
+    else if (type >= 8 && type <= 12)
+    {
+        // FIXED - polynomial predictor of order 0-4
+        uint32_t order = type - 8;
+        if (order > blockSize)
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < order; ++i)
+        {
+            out[i] = reader.ReadSigned(bitsPerSample);
+        }
+        if (!DecodeResidual(reader, blockSize, order, out))
+        {
+            return false;
+        }
+
+        switch (order)
+        {
+        case 1:
+            for (uint32_t i = 1; i < blockSize; ++i)
+            {
+                out[i] += out[i - 1];
+            }
+            break;
+        case 2:
+            for (uint32_t i = 2; i < blockSize; ++i)
+            {
+                out[i] += static_cast<int32_t>(2 * static_cast<int64_t>(out[i - 1]) - out[i - 2]);
+            }
+            break;
+        case 3:
+            for (uint32_t i = 3; i < blockSize; ++i)
+            {
+                out[i] += static_cast<int32_t>(3 * (static_cast<int64_t>(out[i - 1]) - out[i - 2]) + out[i - 3]);
+            }
+            break;
+        case 4:
+            for (uint32_t i = 4; i < blockSize; ++i)
+            {
+                out[i] += static_cast<int32_t>(4 * (static_cast<int64_t>(out[i - 1]) + out[i - 3]) -
+                    6 * static_cast<int64_t>(out[i - 2]) - out[i - 4]);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    else if (type >= 32)
+    {
+        // LPC - quantized coefficients of order 1-32
+        uint32_t order = type - 31;
+        if (order > blockSize)
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < order; ++i)
+        {
+            out[i] = reader.ReadSigned(bitsPerSample);
+        }
+
+        unsigned precision = reader.Read(4) + 1;
+        int shift = reader.ReadSigned(5);
+        if (precision == 16 || shift < 0)
+        {
+            return false;
+        }
+        int32_t coefficients[32];
+        for (uint32_t i = 0; i < order; ++i)
+        {
+            coefficients[i] = reader.ReadSigned(precision);
+        }
+
+        if (!DecodeResidual(reader, blockSize, order, out))
+        {
+            return false;
+        }
+
+        for (uint32_t i = order; i < blockSize; ++i)
+        {
+            int64_t prediction = 0;
+            const int32_t* history = out + i;
+            for (uint32_t j = 0; j < order; ++j)
+            {
+                prediction += static_cast<int64_t>(coefficients[j]) * history[-1 - static_cast<int32_t>(j)];
+            }
+            out[i] += static_cast<int32_t>(prediction >> shift);
+        }
+    }
+    else
+    {
+        // Reserved subframe types
+        return false;
+    }
+
+    if (wastedBits)
+    {
+        for (uint32_t i = 0; i < blockSize; ++i)
+        {
+            out[i] = static_cast<int32_t>(static_cast<uint32_t>(out[i]) << wastedBits);
+        }
+    }
+    return !reader.IsOverrun();
+}
+
+// Store one decoded channel in the buffer's native storage
+static void WriteChannel(SampleBuffer& buffer, uint16_t channel, uint32_t firstFrame, const int32_t* samples,
+                         uint32_t count, uint16_t bitsPerSample)
+{
+    switch (buffer.GetStorage())
+    {
+    case SampleBuffer::STORAGE_INT16:
+    {
+        uint8_t* dest = buffer.GetWritableChannelBytes(channel) + static_cast<size_t>(firstFrame) * 2;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            int16_t value = static_cast<int16_t>(samples[i]);
+            std::memcpy(dest + i * 2, &value, 2);
+        }
+        break;
+    }
+    case SampleBuffer::STORAGE_INT24:
+    {
+        uint8_t* dest = buffer.GetWritableChannelBytes(channel) + static_cast<size_t>(firstFrame) * 3;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            dest[i * 3] = static_cast<uint8_t>(samples[i]);
+            dest[i * 3 + 1] = static_cast<uint8_t>(samples[i] >> 8);
+            dest[i * 3 + 2] = static_cast<uint8_t>(samples[i] >> 16);
+        }
+        break;
+    }
+    default:
+    {
+        // Same scaling as the WAV PCM kernels
+        const float scale = 1.0f / static_cast<float>(1u << (bitsPerSample - 1));
+        float* dest = buffer.GetWritableChannel(channel) + firstFrame;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            dest[i] = static_cast<float>(samples[i]) * scale;
+        }
+        break;
+    }
+    }
+}
+
+// Size of an ID3v2 tag in front of the stream, 0 if there is none
+static size_t GetId3TagSize(const uint8_t* data, size_t size)
+{
+    if (size < 10 || std::memcmp(data, "ID3", 3) != 0)
+    {
+        return 0;
+    }
+    // Sync-safe size: 7 bits per byte, plus the header and an optional footer
+    size_t tagSize = (static_cast<size_t>(data[6] & 0x7F) << 21) | (static_cast<size_t>(data[7] & 0x7F) << 14) |
+        (static_cast<size_t>(data[8] & 0x7F) << 7) | (data[9] & 0x7F);
+    return 10 + tagSize + ((data[5] & 0x10) ? 10 : 0);
+}
+
+FlacDecoder::FlacDecoder()
+    : data_(nullptr)
+    , size_(0)
+    , numSamples_(0)
+{
+}
+
+bool FlacDecoder::IsFlac(const uint8_t* data, size_t size)
+{
+    size_t offset = GetId3TagSize(data, size);
+    return offset + 4 <= size && std::memcmp(data + offset, kFlacMarker, 4) == 0;
+}
+
+bool FlacDecoder::Open(const uint8_t* data, size_t size)
+{
+    data_ = data;
+    size_ = size;
+    streamInfo_ = StreamInfo();
+    frames_.clear();
+    numSamples_ = 0;
+
+    if (!IsFlac(data, size))
+    {
+        return false;
+    }
+
+    size_t offset = GetId3TagSize(data, size) + 4;
+    if (!ParseMetadata(offset))
+    {
+        return false;
+    }
+
+    // The minimum frame size from STREAMINFO lets the scan skip most of each frame. If that
+    // comes up short of the sample count it promised, scan every byte instead.
+    if (!LocateFrames(offset, true) ||
+        (streamInfo_.totalSamples != 0 && numSamples_ < streamInfo_.totalSamples && streamInfo_.minFrameSize != 0))
+    {
+        LocateFrames(offset, false);
+    }
+
+    if (frames_.empty())
+    {
+        printf("FLAC: no audio frames found\n");
+        return false;
+    }
+    if (streamInfo_.totalSamples != 0 && numSamples_ != streamInfo_.totalSamples)
+    {
+        printf("FLAC: found %u of %llu samples\n", numSamples_, static_cast<unsigned long long>(streamInfo_.totalSamples));
+    }
+    return true;
+}
+
+bool FlacDecoder::ParseMetadata(size_t& offset)
+{
+    bool haveStreamInfo = false;
+    bool lastBlock = false;
+    while (!lastBlock)
+    {
+        if (offset + 4 > size_)
+        {
+            return false;
+        }
+        const uint8_t* header = data_ + offset;
+        lastBlock = (header[0] & 0x80) != 0;
+        uint32_t type = header[0] & 0x7F;
+        size_t length = (static_cast<size_t>(header[1]) << 16) | (header[2] << 8) | header[3];
+        offset += 4;
+        if (offset + length > size_)
+        {
+            return false;
+        }
+
+        if (type == 0)
+        {
+            // STREAMINFO - required, and always first
+            if (length < 34)
+            {
+                return false;
+            }
+            const uint8_t* b = data_ + offset;
+            streamInfo_.minBlockSize = (b[0] << 8) | b[1];
+            streamInfo_.maxBlockSize = (b[2] << 8) | b[3];
+            streamInfo_.minFrameSize = (b[4] << 16) | (b[5] << 8) | b[6];
+            streamInfo_.maxFrameSize = (b[7] << 16) | (b[8] << 8) | b[9];
+            streamInfo_.sampleRate = (b[10] << 12) | (b[11] << 4) | (b[12] >> 4);
+            streamInfo_.numChannels = static_cast<uint16_t>(((b[12] >> 1) & 7) + 1);
+            streamInfo_.bitsPerSample = static_cast<uint16_t>((((b[12] & 1) << 4) | (b[13] >> 4)) + 1);
+            streamInfo_.totalSamples = (static_cast<uint64_t>(b[13] & 0x0F) << 32) |
+                (static_cast<uint64_t>(b[14]) << 24) | (b[15] << 16) | (b[16] << 8) | b[17];
+            haveStreamInfo = true;
+        }
+        else if (!haveStreamInfo)
+        {
+            return false;
+        }
+        // Seek tables, tags and pictures are not needed - frames are found by the scan
+
+        offset += length;
+    }
+
+    if (!haveStreamInfo || streamInfo_.sampleRate == 0 || streamInfo_.bitsPerSample < 4)
+    {
+        return false;
+    }
+    if (streamInfo_.bitsPerSample > kMaxBitsPerSample)
+    {
+        printf("FLAC: %u-bit streams are not supported\n", streamInfo_.bitsPerSample);
+        return false;
+    }
+    return true;
+}
+
+bool FlacDecoder::ParseFrameHeader(size_t offset, FrameHeader& header) const
+{
+    const uint8_t* p = data_ + offset;
+    const size_t available = size_ - offset;
+    if (available < 6 || p[0] != 0xFF || (p[1] & 0xFE) != 0xF8)
+    {
+        return false;
+    }
+
+    header.variableBlockSize = (p[1] & 1) != 0;
+    const uint32_t blockSizeCode = p[2] >> 4;
+    const uint32_t sampleRateCode = p[2] & 0x0F;
+    const uint32_t channelCode = p[3] >> 4;
+    const uint32_t sampleSizeCode = (p[3] >> 1) & 7;
+    if ((p[3] & 1) || blockSizeCode == 0 || sampleRateCode == 15 || channelCode > 10 || sampleSizeCode == 3)
+    {
+        return false;
+    }
+
+    // Frame or sample number, UTF-8 style variable length
+    size_t pos = 4;
+    uint8_t lead = p[pos++];
+    uint64_t number;
+    int extraBytes;
+    if (!(lead & 0x80)) { number = lead; extraBytes = 0; }
+    else if ((lead & 0xE0) == 0xC0) { number = lead & 0x1F; extraBytes = 1; }
+    else if ((lead & 0xF0) == 0xE0) { number = lead & 0x0F; extraBytes = 2; }
+    else if ((lead & 0xF8) == 0xF0) { number = lead & 0x07; extraBytes = 3; }
+    else if ((lead & 0xFC) == 0xF8) { number = lead & 0x03; extraBytes = 4; }
+    else if ((lead & 0xFE) == 0xFC) { number = lead & 0x01; extraBytes = 5; }
+    else if (lead == 0xFE) { number = 0; extraBytes = 6; }
+    else { return false; }
+
+    for (int i = 0; i < extraBytes; ++i)
+    {
+        if (pos >= available || (p[pos] & 0xC0) != 0x80)
+        {
+            return false;
+        }
+        number = (number << 6) | (p[pos++] & 0x3F);
+    }
+    header.number = number;
+
+    auto hasBytes = [&](size_t count) { return pos + count <= available; };
+
+    if (blockSizeCode == 1)
+    {
+        header.blockSize = 192;
+    }
+    else if (blockSizeCode <= 5)
+    {
+        header.blockSize = 576u << (blockSizeCode - 2);
+    }
+    else if (blockSizeCode == 6)
+    {
+        if (!hasBytes(1))
+        {
+            return false;
+        }
+        header.blockSize = p[pos++] + 1u;
+    }
+    else if (blockSizeCode == 7)
+    {
+        if (!hasBytes(2))
+        {
+            return false;
+        }
+        header.blockSize = ((p[pos] << 8) | p[pos + 1]) + 1u;
+        pos += 2;
+    }
+    else
+    {
+        header.blockSize = 256u << (blockSizeCode - 8);
+    }
+
+    static const uint32_t kSampleRates[12] = {
+        0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+    if (sampleRateCode < 12)
+    {
+        header.sampleRate = sampleRateCode == 0 ? streamInfo_.sampleRate : kSampleRates[sampleRateCode];
+    }
+    else if (sampleRateCode == 12)
+    {
+        if (!hasBytes(1))
+        {
+            return false;
+        }
+        header.sampleRate = p[pos++] * 1000u;
+    }
+    else
+    {
+        if (!hasBytes(2))
+        {
+            return false;
+        }
+        header.sampleRate = (p[pos] << 8) | p[pos + 1];
+        if (sampleRateCode == 14)
+        {
+            header.sampleRate *= 10;
+        }
+        pos += 2;
+    }
+
+    static const uint16_t kSampleSizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+    header.bitsPerSample = sampleSizeCode == 0 ? streamInfo_.bitsPerSample : kSampleSizes[sampleSizeCode];
+    header.channelAssignment = static_cast<uint16_t>(channelCode);
+    header.numChannels = static_cast<uint16_t>(channelCode < 8 ? channelCode + 1 : 2);
+
+    if (!hasBytes(1) || Crc8(p, pos) != p[pos])
+    {
+        return false;
+    }
+    header.headerSize = pos + 1;
+    return true;
+}
+
+bool FlacDecoder::LocateFrames(size_t firstFrameOffset, bool skipMinFrameSize)
+{
+    frames_.clear();
+    numSamples_ = 0;
+
+    // A candidate is only a frame if its header CRC matches, its format matches STREAMINFO and
+    // it carries the next frame or sample number - sync patterns inside frame data fail that
+    uint64_t numSamples = 0;
+    bool variableBlockSize = false;
+    size_t offset = firstFrameOffset;
+    while (offset < size_)
+    {
+        const void* hit = std::memchr(data_ + offset, 0xFF, size_ - offset);
+        if (!hit)
+        {
+            break;
+        }
+        size_t candidate = static_cast<const uint8_t*>(hit) - data_;
+
+        FrameHeader header;
+        if (!ParseFrameHeader(candidate, header) ||
+            header.numChannels != streamInfo_.numChannels || header.bitsPerSample != streamInfo_.bitsPerSample ||
+            (streamInfo_.maxBlockSize != 0 && header.blockSize > streamInfo_.maxBlockSize) ||
+            (!frames_.empty() && header.variableBlockSize != variableBlockSize) ||
+            header.number != (header.variableBlockSize ? numSamples : frames_.size()))
+        {
+            offset = candidate + 1;
+            continue;
+        }
+
+        if (numSamples + header.blockSize > UINT32_MAX)
+        {
+            printf("FLAC: stream longer than %u samples, truncated\n", UINT32_MAX);
+            break;
+        }
+
+        if (!frames_.empty())
+        {
+            frames_.back().size = candidate - frames_.back().offset;
+        }
+        FrameLocation frame;
+        frame.offset = candidate;
+        frame.size = size_ - candidate;
+        frame.firstSample = static_cast<uint32_t>(numSamples);
+        frame.blockSize = header.blockSize;
+        frame.channelAssignment = header.channelAssignment;
+        frames_.push_back(frame);
+
+        variableBlockSize = header.variableBlockSize;
+        numSamples += header.blockSize;
+        offset = candidate + std::max<size_t>(header.headerSize, skipMinFrameSize ? streamInfo_.minFrameSize : 0);
+    }
+
+    numSamples_ = static_cast<uint32_t>(numSamples);
+    return !frames_.empty();
+}
+
+bool FlacDecoder::DecodeFrame(const FrameLocation& frame, SampleBuffer& buffer, std::vector<int32_t>& scratch) const
+{
+    FrameHeader header;
+    if (!ParseFrameHeader(frame.offset, header))
+    {
+        return false;
+    }
+
+    const uint16_t channels = streamInfo_.numChannels;
+    const uint32_t blockSize = frame.blockSize;
+    scratch.resize(static_cast<size_t>(channels) * blockSize);
+
+    BitReader reader(data_ + frame.offset, frame.size);
+    reader.SkipBytes(header.headerSize);
+
+    // The side channel of a stereo pair needs one extra bit
+    const uint16_t assignment = frame.channelAssignment;
+    for (uint16_t ch = 0; ch < channels; ++ch)
+    {
+        unsigned bits = header.bitsPerSample;
+        if ((assignment == 8 && ch == 1) || (assignment == 9 && ch == 0) || (assignment == 10 && ch == 1))
+        {
+            ++bits;
+        }
+        if (!DecodeSubframe(reader, bits, blockSize, scratch.data() + static_cast<size_t>(ch) * blockSize))
+        {
+            return false;
+        }
+    }
+
+    // Footer: CRC-16 of everything before it
+    reader.AlignToByte();
+    const size_t footer = static_cast<size_t>(reader.GetBitPosition() / 8);
+    if (reader.IsOverrun() || footer + 2 > frame.size)
+    {
+        return false;
+    }
+    const uint8_t* frameData = data_ + frame.offset;
+    if (Crc16(frameData, footer) != ((frameData[footer] << 8) | frameData[footer + 1]))
+    {
+        return false;
+    }
+
+    // Undo stereo decorrelation
+    if (assignment >= 8)
+    {
+        int32_t* first = scratch.data();
+        int32_t* second = scratch.data() + blockSize;
+        for (uint32_t i = 0; i < blockSize; ++i)
+        {
+            int32_t a = first[i];
+            int32_t b = second[i];
+            if (assignment == 8)
+            {
+                second[i] = a - b;              // Left, side -> right
+            }
+            else if (assignment == 9)
+            {
+                first[i] = a + b;               // Side, right -> left
+            }
+            else
+            {
+                int32_t mid = static_cast<int32_t>(static_cast<uint32_t>(a) << 1) | (b & 1);
+                first[i] = (mid + b) >> 1;      // Mid, side -> left, right
+                second[i] = (mid - b) >> 1;
+            }
+        }
+    }
+
+    for (uint16_t ch = 0; ch < channels; ++ch)
+    {
+        WriteChannel(buffer, ch, frame.firstSample, scratch.data() + static_cast<size_t>(ch) * blockSize,
+            blockSize, header.bitsPerSample);
+    }
+    return true;
+}
+
+bool FlacDecoder::Decode(SampleBuffer& buffer, ThreadPool* pool, LoadProgress* progress, PeakBuilder* peaks) const
+{
+    if (frames_.empty() || buffer.GetNumChannels() != streamInfo_.numChannels || buffer.GetNumFrames() < numSamples_)
+    {
+        return false;
+    }
+    if ((buffer.GetStorage() == SampleBuffer::STORAGE_INT16 && streamInfo_.bitsPerSample != 16) ||
+        (buffer.GetStorage() == SampleBuffer::STORAGE_INT24 && streamInfo_.bitsPerSample != 24))
+    {
+        return false;
+    }
+
+    // Consecutive frames grouped into tasks of roughly kDecodeGroupBytes
+    std::vector<size_t> groupStarts;
+    size_t groupBytes = kDecodeGroupBytes;
+    for (size_t i = 0; i < frames_.size(); ++i)
+    {
+        if (groupBytes >= kDecodeGroupBytes)
+        {
+            groupStarts.push_back(i);
+            groupBytes = 0;
+        }
+        groupBytes += frames_[i].size;
+    }
+    groupStarts.push_back(frames_.size());
+
+    if (progress)
+    {
+        const FrameLocation& last = frames_.back();
+        progress->bytesTotal.store(last.offset + last.size - frames_.front().offset);
+    }
+
+    std::atomic<bool> failed{ false };
+    auto decodeGroup = [&](size_t group)
+    {
+        // Groups still queued after a failure or a cancel are skipped
+        if (failed.load(std::memory_order_relaxed) ||
+            (progress && progress->cancelRequested.load(std::memory_order_relaxed)))
+        {
+            return;
+        }
+
+        std::vector<int32_t> scratch;
+        size_t bytes = 0;
+        uint64_t samples = 0;
+        for (size_t i = groupStarts[group]; i < groupStarts[group + 1]; ++i)
+        {
+            if (!DecodeFrame(frames_[i], buffer, scratch))
+            {
+                printf("FLAC: frame %zu at byte %zu is corrupt\n", i, frames_[i].offset);
+                failed.store(true);
+                return;
+            }
+            bytes += frames_[i].size;
+            samples += static_cast<uint64_t>(frames_[i].blockSize) * streamInfo_.numChannels;
+        }
+
+        if (peaks)
+        {
+            const FrameLocation& first = frames_[groupStarts[group]];
+            const FrameLocation& last = frames_[groupStarts[group + 1] - 1];
+            peaks->MarkDecoded(first.firstSample, last.firstSample + last.blockSize - first.firstSample);
+        }
+
+        if (progress)
+        {
+            progress->bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+            progress->samplesDecoded.fetch_add(samples, std::memory_order_relaxed);
+        }
+    };
+
+    const size_t numGroups = groupStarts.size() - 1;
+    if (pool)
+    {
+        pool->ParallelFor(numGroups, decodeGroup);
+    }
+    else
+    {
+        for (size_t group = 0; group < numGroups; ++group)
+        {
+            decodeGroup(group);
+        }
+    }
+
+    return !failed.load() && !(progress && progress->cancelRequested.load());
+}
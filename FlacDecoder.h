@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class SampleBuffer;
+class ThreadPool;
+struct LoadProgress;
+class PeakBuilder;
+
+// FLAC Decoder - native FLAC decoding for the import path.
+// Open() parses STREAMINFO and finds every frame with a sync scan that checks the header
+// CRC-8 and the frame/sample number, so the frames can then be decoded independently
+// and in parallel straight into a SampleBuffer. Every frame is checked against its CRC-16.
+class FlacDecoder
+{
+public:
+    struct StreamInfo
+    {
+        uint32_t minBlockSize = 0;
+        uint32_t maxBlockSize = 0;
+        uint32_t minFrameSize = 0;   // Bytes, 0 = unknown
+        uint32_t maxFrameSize = 0;   // Bytes, 0 = unknown
+        uint32_t sampleRate = 0;
+        uint16_t numChannels = 0;
+        uint16_t bitsPerSample = 0;
+        uint64_t totalSamples = 0;   // Per channel, 0 = unknown
+    };
+
+    FlacDecoder();
+
+    // True if data starts with the fLaC marker, optionally behind an ID3v2 tag
+    static bool IsFlac(const uint8_t* data, size_t size);
+
+    // Parse the stream header and locate every frame. data must stay valid until decoding is done.
+    bool Open(const uint8_t* data, size_t size);
+
+    const StreamInfo& GetStreamInfo() const { return streamInfo_; }
+    size_t GetNumFrames() const { return frames_.size(); }
+    uint32_t GetNumSamples() const { return numSamples_; } // Per channel, from the frames found
+
+    // Decode every frame into buffer, which must have GetNumSamples() frames and the stream's
+    // channel count in any storage. pool == nullptr decodes on the calling thread.
+    // peaks, if given, is told about every finished group of frames.
+    bool Decode(SampleBuffer& buffer, ThreadPool* pool, LoadProgress* progress, PeakBuilder* peaks = nullptr) const;
+
+private:
+    struct FrameHeader
+    {
+        uint32_t blockSize = 0;
+        uint32_t sampleRate = 0;
+        uint16_t channelAssignment = 0; // 0-7 independent, 8 left/side, 9 right/side, 10 mid/side
+        uint16_t numChannels = 0;
+        uint16_t bitsPerSample = 0;
+        uint64_t number = 0;            // Frame number (fixed block size) or first sample (variable)
+        bool variableBlockSize = false;
+        size_t headerSize = 0;
+    };
+
+    struct FrameLocation
+    {
+        size_t offset;
+        size_t size;
+        uint32_t firstSample;
+        uint32_t blockSize;
+        uint16_t channelAssignment;
+    };
+
+    const uint8_t* data_;
+    size_t size_;
+    StreamInfo streamInfo_;
+    std::vector<FrameLocation> frames_;
+    uint32_t numSamples_;
+
+    bool ParseMetadata(size_t& offset);
+    bool ParseFrameHeader(size_t offset, FrameHeader& header) const;
+    bool LocateFrames(size_t firstFrameOffset, bool skipMinFrameSize);
+    bool DecodeFrame(const FrameLocation& frame, SampleBuffer& buffer, std::vector<int32_t>& scratch) const;
+};
@@ -0,0 +1,164 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : data_(nullptr)
+    , size_(0)
+#ifdef _WIN32
+    , fileHandle_(INVALID_HANDLE_VALUE)
+    , mappingHandle_(nullptr)
+#else
+    , fileDescriptor_(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& filePath)
+{
+    Close();
+
+    fileHandle_ = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle_ == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle_, &fileSize) || fileSize.QuadPart == 0 ||
+        static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+    {
+        Close();
+        return false;
+    }
+
+    mappingHandle_ = CreateFileMappingA(fileHandle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle_)
+    {
+        Close();
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_)
+    {
+        Close();
+        return false;
+    }
+
+    size_ = static_cast<uint64_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data_)
+    {
+        UnmapViewOfFile(data_);
+        data_ = nullptr;
+    }
+    if (mappingHandle_)
+    {
+        CloseHandle(mappingHandle_);
+        mappingHandle_ = nullptr;
+    }
+    if (fileHandle_ != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(fileHandle_);
+        fileHandle_ = INVALID_HANDLE_VALUE;
+    }
+    size_ = 0;
+}
+
+void MappedFile::Prefetch(uint64_t offset, uint64_t length) const
+{
+    if (!data_ || offset >= size_)
+    {
+        return;
+    }
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t*>(data_ + offset);
+    range.NumberOfBytes = static_cast<SIZE_T>(length < size_ - offset ? length : size_ - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filePath)
+{
+    Close();
+
+    fileDescriptor_ = open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor_ < 0)
+    {
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fileDescriptor_, &fileInfo) != 0 || fileInfo.st_size <= 0 ||
+        static_cast<uint64_t>(fileInfo.st_size) > SIZE_MAX)
+    {
+        Close();
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_SHARED, fileDescriptor_, 0);
+    if (view == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t*>(view);
+    size_ = static_cast<uint64_t>(fileInfo.st_size);
+    madvise(view, static_cast<size_t>(size_), MADV_SEQUENTIAL);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data_)
+    {
+        munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+        data_ = nullptr;
+    }
+    if (fileDescriptor_ >= 0)
+    {
+        close(fileDescriptor_);
+        fileDescriptor_ = -1;
+    }
+    size_ = 0;
+}
+
+void MappedFile::Prefetch(uint64_t offset, uint64_t length) const
+{
+    if (!data_ || offset >= size_)
+    {
+        return;
+    }
+
+    // madvise needs a page-aligned start address
+    const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t alignedOffset = offset - (offset % pageSize);
+    uint64_t end = offset + length < size_ ? offset + length : size_;
+    madvise(const_cast<uint8_t*>(data_ + alignedOffset), static_cast<size_t>(end - alignedOffset), MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file - pages stay in the OS page cache
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map / unmap
+    bool Open(const std::string& filePath);
+    void Close();
+    bool IsOpen() const { return data_ != nullptr; }
+
+    // Mapped view
+    const uint8_t* GetData() const { return data_; }
+    uint64_t GetSize() const { return size_; }
+
+    // Hint the OS to start paging in a range that is about to be read
+    void Prefetch(uint64_t offset, uint64_t length) const;
+
+private:
+    const uint8_t* data_;
+    uint64_t size_;
+
+#ifdef _WIN32
+    void* fileHandle_;
+    void* mappingHandle_;
+#else
+    int fileDescriptor_;
+#endif
+};
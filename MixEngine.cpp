@@ -0,0 +1,508 @@
+#include "MixEngine.h"
+#include "SequencerChannel.h"
+#include "AudioPlayer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+static const float kQuarterPi = 0.785398163f;
+static const double kBenchmarkSampleRate = 44100.0;
+
+MixEngine::MixEngine()
+    : postedSequence_(0)
+    , completedSequence_(0)
+    , commands_(kCommandCapacity)
+    , replies_(kCommandCapacity)
+    , sources_(new std::vector<Source>())
+    , rolling_(false)
+    , playheadFrames_(0)
+    , playhead_(0)
+    , renderedFrames_(0)
+    , smoothing_(SMOOTH_PER_BLOCK)
+    , scratch_(static_cast<size_t>(kMaxBlockFrames) * kMaxSourceChannels, 0.0f)
+    , stereo_(static_cast<size_t>(kMaxBlockFrames) * kOutputChannels, 0.0f)
+    , gains_(kMaxBlockFrames, 0.0f)
+    , pans_(kMaxBlockFrames, 0.0f)
+    , fades_(kMaxBlockFrames, 0.0f)
+{
+}
+
+MixEngine::~MixEngine()
+{
+    // No render thread any more - free whatever is still in flight
+    Reply reply;
+    while (replies_.TryPop(reply))
+    {
+        delete reply.garbage;
+    }
+    Command command;
+    while (commands_.TryPop(command))
+    {
+        delete command.sources;
+    }
+    for (const Command& held : backlog_)
+    {
+        delete held.sources;
+    }
+    delete sources_;
+}
+
+void MixEngine::SetSources(std::vector<Source> sources)
+{
+    published_ = sources;
+
+    Command command = {};
+    command.type = COMMAND_SET_SOURCES;
+    command.sources = new std::vector<Source>(std::move(sources));
+    Post(command);
+}
+
+void MixEngine::Play()
+{
+    Command command = {};
+    command.type = COMMAND_PLAY;
+    Post(command);
+}
+
+void MixEngine::Stop()
+{
+    Command command = {};
+    command.type = COMMAND_STOP;
+    Post(command);
+}
+
+void MixEngine::Pause()
+{
+    Command command = {};
+    command.type = COMMAND_PAUSE;
+    Post(command);
+}
+
+void MixEngine::Locate(uint32_t frame)
+{
+    Command command = {};
+    command.type = COMMAND_LOCATE;
+    command.frame = frame;
+    Post(command);
+}
+
+void MixEngine::Seek(AudioPlayer* player, uint32_t frame)
+{
+    Command command = {};
+    command.type = COMMAND_SEEK;
+    command.player = player;
+    command.frame = frame;
+    Post(command);
+}
+
+void MixEngine::Post(const Command& command)
+{
+    Command numbered = command;
+    numbered.sequence = ++postedSequence_;
+
+    // Held-back commands go first, so the render thread always sees them in order
+    if (!backlog_.empty() || !commands_.TryPush(numbered))
+    {
+        backlog_.push_back(numbered);
+    }
+}
+
+void MixEngine::ProcessReplies()
+{
+    Reply reply;
+    while (replies_.TryPop(reply))
+    {
+        delete reply.garbage;
+        completedSequence_ = reply.sequence;
+    }
+
+    while (!backlog_.empty() && commands_.TryPush(backlog_.front()))
+    {
+        backlog_.pop_front();
+    }
+}
+
+void MixEngine::ApplyCommands()
+{
+    // Only take a command that can be answered, the reply queue must never drop garbage
+    Command command;
+    while (!replies_.IsFull() && commands_.TryPop(command))
+    {
+        Reply reply = {};
+        reply.sequence = command.sequence;
+
+        const std::vector<Source>& sources = *sources_;
+        switch (command.type)
+        {
+        case COMMAND_SET_SOURCES:
+            reply.garbage = sources_;
+            sources_ = command.sources;
+            break;
+        case COMMAND_PLAY:
+            rolling_ = true;
+            for (const Source& source : sources)
+            {
+                if (source.player)
+                {
+                    source.player->Play();
+                }
+            }
+            break;
+        case COMMAND_STOP:
+            rolling_ = false;
+            playheadFrames_ = 0;
+            for (const Source& source : sources)
+            {
+                if (source.player)
+                {
+                    source.player->Stop();
+                }
+            }
+            break;
+        case COMMAND_PAUSE:
+            rolling_ = false;
+            for (const Source& source : sources)
+            {
+                if (source.player)
+                {
+                    source.player->Pause();
+                }
+            }
+            break;
+        case COMMAND_LOCATE:
+            playheadFrames_ = command.frame;
+            for (const Source& source : sources)
+            {
+                if (source.player)
+                {
+                    source.player->SetPosition(command.frame);
+                }
+            }
+            break;
+        case COMMAND_SEEK:
+            // The pointer is only trusted while a source holds the player alive
+            for (const Source& source : sources)
+            {
+                if (source.player.get() == command.player)
+                {
+                    command.player->SetPosition(command.frame);
+                    break;
+                }
+            }
+            break;
+        }
+        replies_.TryPush(reply);
+    }
+    playhead_.store(playheadFrames_, std::memory_order_relaxed);
+}
+
+void MixEngine::Render(float* output, uint32_t numFrames, uint16_t outputChannels)
+{
+    // Commands land between calls, so every block of a call mixes the same channels
+    ApplyCommands();
+    const std::vector<Source>& sources = *sources_;
+    const Smoothing smoothing = GetSmoothing();
+
+    uint32_t remaining = numFrames;
+    while (remaining > 0)
+    {
+        uint32_t blockFrames = remaining < kMaxBlockFrames ? remaining : kMaxBlockFrames;
+        if (outputChannels == kOutputChannels)
+        {
+            RenderBlock(sources, output, blockFrames, smoothing);
+        }
+        else
+        {
+            RenderBlock(sources, stereo_.data(), blockFrames, smoothing);
+            const float* mix = stereo_.data();
+            for (uint32_t i = 0; i < blockFrames; ++i, mix += 2)
+            {
+                float* frame = output + static_cast<size_t>(i) * outputChannels;
+                if (outputChannels == 1)
+                {
+                    frame[0] = (mix[0] + mix[1]) * 0.5f;
+                    continue;
+                }
+                frame[0] = mix[0];
+                frame[1] = mix[1];
+                std::fill(frame + 2, frame + outputChannels, 0.0f);
+            }
+        }
+        output += static_cast<size_t>(blockFrames) * outputChannels;
+        remaining -= blockFrames;
+    }
+    if (rolling_)
+    {
+        playheadFrames_ += numFrames;
+        playhead_.store(playheadFrames_, std::memory_order_relaxed);
+    }
+    renderedFrames_.fetch_add(numFrames, std::memory_order_relaxed);
+}
+
+void MixEngine::RenderBlock(const std::vector<Source>& sources, float* output, uint32_t numFrames,
+                            Smoothing smoothing)
+{
+    std::fill(output, output + static_cast<size_t>(numFrames) * kOutputChannels, 0.0f);
+
+    // Any soloed channel silences every channel that is not soloed
+    bool anySolo = false;
+    for (const Source& source : sources)
+    {
+        anySolo = anySolo || source.channel->IsSolo();
+    }
+
+    float* block = scratch_.data();
+    for (const Source& source : sources)
+    {
+        // Mute, solo and the player's own volume fade through the mix gain
+        SequencerChannel& channel = *source.channel;
+        SmoothedParameter& volume = channel.GetVolumeParameter();
+        SmoothedParameter& pan = channel.GetPanParameter();
+        SmoothedParameter& fade = channel.GetMixGain();
+        AudioPlayer* player = source.player.get();
+        const bool audible = !channel.IsMuted() && (!anySolo || channel.IsSolo());
+        fade.Set(audible && player ? player->GetVolume() : 0.0f);
+
+        const bool playing = player && player->GetState() == AudioPlayer::PLAYING;
+        if (!playing || !channel.IsMixed())
+        {
+            // New and idle channels jump straight to their settings, so playback never starts mid-ramp
+            channel.SetMixed();
+            volume.Snap();
+            pan.Snap();
+            fade.Snap();
+        }
+        if (!playing)
+        {
+            continue;
+        }
+        const uint16_t channels = player->GetAudioData().channels;
+        if (channels == 0 || channels > kMaxSourceChannels)
+        {
+            continue;
+        }
+
+        // Silenced channels still pull, so they stay in time with the rest
+        if (player->ReadFrames(block, numFrames) == 0)
+        {
+            continue;
+        }
+        // Steady channels skip the ramps altogether
+        const bool volumeMoving = volume.Follow();
+        const bool panMoving = pan.Follow();
+        const bool fadeMoving = fade.Follow();
+        if (!volumeMoving && !panMoving && !fadeMoving)
+        {
+            const float gain = volume.GetCurrent() * fade.GetCurrent();
+            if (gain != 0.0f)
+            {
+                MixSource(block, channels, numFrames, gain, pan.GetCurrent(), output);
+            }
+        }
+        else if (smoothing == SMOOTH_PER_SAMPLE)
+        {
+            float* gains = gains_.data();
+            float* fades = fades_.data();
+            volume.Fill(gains, numFrames);
+            fade.Fill(fades, numFrames);
+            pan.Fill(pans_.data(), numFrames);
+            bool silent = true;
+            for (uint32_t i = 0; i < numFrames; ++i)
+            {
+                gains[i] *= fades[i];
+                silent = silent && gains[i] == 0.0f;
+            }
+            if (!silent)
+            {
+                MixSource(block, channels, numFrames, gains, pans_.data(), output);
+            }
+        }
+        else
+        {
+            float volumeStart, volumeEnd, fadeStart, fadeEnd, panStart, panEnd;
+            volume.Advance(numFrames, volumeStart, volumeEnd);
+            fade.Advance(numFrames, fadeStart, fadeEnd);
+            pan.Advance(numFrames, panStart, panEnd);
+            const float gainStart = volumeStart * fadeStart;
+            const float gainEnd = volumeEnd * fadeEnd;
+            if (gainStart != 0.0f || gainEnd != 0.0f)
+            {
+                MixSource(block, channels, numFrames, gainStart, gainEnd, panStart, panEnd, output);
+            }
+        }
+    }
+}
+
+void MixEngine::GetPanGains(uint16_t channels, float pan, float& left, float& right)
+{
+    if (channels == 1)
+    {
+        // Constant-power pan, -3 dB per side at center
+        const float angle = (pan + 1.0f) * kQuarterPi;
+        left = std::cos(angle);
+        right = std::sin(angle);
+    }
+    else
+    {
+        // Balance - pan attenuates the opposite side
+        left = pan > 0.0f ? 1.0f - pan : 1.0f;
+        right = pan < 0.0f ? 1.0f + pan : 1.0f;
+    }
+}
+
+void MixEngine::MixSource(const float* frames, uint16_t channels, uint32_t numFrames, float gain, float pan,
+                          float* output)
+{
+    MixSource(frames, channels, numFrames, gain, gain, pan, pan, output);
+}
+
+void MixEngine::MixSource(const float* frames, uint16_t channels, uint32_t numFrames, float gainStart, float gainEnd,
+                          float panStart, float panEnd, float* output)
+{
+    float leftStart, rightStart, leftEnd, rightEnd;
+    GetPanGains(channels, panStart, leftStart, rightStart);
+    GetPanGains(channels, panEnd, leftEnd, rightEnd);
+    float left = leftStart * gainStart;
+    float right = rightStart * gainStart;
+    const float leftStep = (leftEnd * gainEnd - left) / numFrames;
+    const float rightStep = (rightEnd * gainEnd - right) / numFrames;
+
+    // Channels past the first two are dropped
+    const size_t stride = channels;
+    const size_t rightOffset = channels == 1 ? 0 : 1;
+    if (leftStep == 0.0f && rightStep == 0.0f)
+    {
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            const float* frame = frames + i * stride;
+            output[i * 2] += frame[0] * left;
+            output[i * 2 + 1] += frame[rightOffset] * right;
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        const float* frame = frames + i * stride;
+        output[i * 2] += frame[0] * left;
+        output[i * 2 + 1] += frame[rightOffset] * right;
+        left += leftStep;
+        right += rightStep;
+    }
+}
+
+void MixEngine::MixSource(const float* frames, uint16_t channels, uint32_t numFrames, const float* gains,
+                          const float* pans, float* output)
+{
+    // The pan law is only evaluated again when the pan moves
+    float pan = pans[0];
+    float left, right;
+    GetPanGains(channels, pan, left, right);
+
+    const size_t stride = channels;
+    const size_t rightOffset = channels == 1 ? 0 : 1;
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        if (pans[i] != pan)
+        {
+            pan = pans[i];
+            GetPanGains(channels, pan, left, right);
+        }
+        const float* frame = frames + i * stride;
+        output[i * 2] += frame[0] * left * gains[i];
+        output[i * 2 + 1] += frame[rightOffset] * right * gains[i];
+    }
+}
+
+MixEngine::BenchmarkResult MixEngine::RunBenchmark(Smoothing smoothing, uint32_t numChannels, uint32_t blockFrames,
+                                                   uint32_t numBlocks, int iterations)
+{
+    BenchmarkResult result;
+    result.smoothing = smoothing;
+    result.numChannels = numChannels;
+    result.blockFrames = blockFrames < kMaxBlockFrames ? blockFrames : kMaxBlockFrames;
+    result.blocksPerSecond = 0.0;
+    result.realTimeFactor = 0.0;
+    if (numChannels == 0 || result.blockFrames == 0 || numBlocks == 0)
+    {
+        return result;
+    }
+
+    // Deterministic noise, one mono and one stereo buffer shared by alternating channels
+    const uint32_t numFrames = result.blockFrames * numBlocks;
+    std::shared_ptr<const SampleBuffer> buffers[2];
+    uint32_t seed = 0x12345678u;
+    for (uint16_t b = 0; b < 2; ++b)
+    {
+        const uint16_t channels = b + 1;
+        auto buffer = std::make_shared<SampleBuffer>(numFrames, 44100, channels, 16);
+        for (uint16_t ch = 0; ch < channels; ++ch)
+        {
+            float* samples = buffer->GetWritableChannel(ch);
+            for (uint32_t i = 0; i < numFrames; ++i)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                samples[i] = static_cast<int16_t>(seed >> 16) / 32768.0f;
+            }
+        }
+        buffer->Seal();
+        buffers[b] = buffer;
+    }
+
+    MixEngine engine;
+    engine.SetSmoothing(smoothing);
+    std::vector<Source> sources;
+    for (uint32_t i = 0; i < numChannels; ++i)
+    {
+        Source source;
+        source.channel = std::make_shared<SequencerChannel>(i, "Benchmark");
+        source.channel->SetPan((i % 5) * 0.5f - 1.0f);
+        source.player = std::make_shared<AudioPlayer>();
+
+        AudioData data;
+        data.buffer = buffers[i % 2];
+        data.channels = static_cast<uint16_t>(i % 2 + 1);
+        data.sampleRate = 44100;
+        source.player->LoadAudioData(std::move(data));
+        sources.push_back(source);
+    }
+    engine.SetSources(sources);
+
+    // Best of N - every pass replays the session from the start
+    std::vector<float> output(static_cast<size_t>(result.blockFrames) * kOutputChannels);
+    double bestSeconds = 1e30;
+    for (int iter = 0; iter < iterations; ++iter)
+    {
+        engine.Stop();
+        engine.Play();
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < numBlocks; ++i)
+        {
+            // Automation - one channel in eight moves each block
+            for (uint32_t c = i % 8; c < numChannels; c += 8)
+            {
+                sources[c].channel->SetVolume(((i + c) % 16) / 16.0f);
+                sources[c].channel->SetPan(((i + c) % 9) * 0.25f - 1.0f);
+            }
+            engine.Render(output.data(), result.blockFrames);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        bestSeconds = std::min(bestSeconds, elapsed.count());
+    }
+
+    if (bestSeconds > 0.0)
+    {
+        result.blocksPerSecond = numBlocks / bestSeconds;
+        result.realTimeFactor = numFrames / kBenchmarkSampleRate / bestSeconds;
+    }
+    return result;
+}
+
+void MixEngine::PrintBenchmark(const BenchmarkResult& result)
+{
+    printf("Mix engine benchmark: %u channels, %u-frame blocks, %s smoothing\n", result.numChannels,
+        result.blockFrames, result.smoothing == SMOOTH_PER_SAMPLE ? "per-sample" : "per-block");
+    printf("  %.0f blocks/s, %.1fx real time\n", result.blocksPerSecond, result.realTimeFactor);
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "SpscQueue.h"
+#include <memory>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <cstdint>
+
+class SequencerChannel;
+class AudioPlayer;
+
+// Mix Engine - pull-based block renderer. Each Render() call pulls one block from every channel's
+// player, applies the channel's volume, pan and mute/solo, and sums the result into interleaved
+// stereo. It owns no thread; an AudioDevice (or a benchmark) drives it.
+// Channel parameters are ramped rather than stepped (see SmoothedParameter), a muted or
+// solo'd-out channel fades instead of cutting, and nothing on the render path takes a lock.
+// Everything else - the channel list, transport and seeks - reaches the render thread as commands
+// on a wait-free queue, applied between blocks. Replaced channel lists travel back on a reply queue
+// and are freed by the control thread, so the render thread never allocates or deallocates.
+class MixEngine
+{
+public:
+    enum Smoothing
+    {
+        SMOOTH_PER_BLOCK,  // Parameters advance once per block, gains interpolate across it
+        SMOOTH_PER_SAMPLE  // Every frame follows the parameter ramps exactly, pan law included
+    };
+
+    static constexpr uint16_t kOutputChannels = 2;
+    static constexpr uint16_t kMaxSourceChannels = 8;  // Sources with more channels are skipped
+    static constexpr uint32_t kMaxBlockFrames = 4096;  // Longer Render() calls are split into blocks
+
+    // One channel strip - the player is captured with it so it stays alive while it is mixed
+    struct Source
+    {
+        std::shared_ptr<SequencerChannel> channel;
+        std::shared_ptr<AudioPlayer> player;
+    };
+
+    MixEngine();
+    ~MixEngine();
+
+    static constexpr uint32_t kCommandCapacity = 256;  // Commands in flight; more wait on the control thread
+
+    // Control thread (one thread, normally the UI) - each call posts a command that the render
+    // thread applies before its next block. None of them block; if the queue is full the command
+    // is held back and sent on by ProcessReplies().
+
+    // Replace the channels being mixed. GetSources() returns the set as last posted.
+    void SetSources(std::vector<Source> sources);
+    const std::vector<Source>& GetSources() const { return published_; }
+
+    // Transport - every player being mixed at the time the command is applied follows it. Stop
+    // rewinds to the start, Locate moves every player and the playhead without changing state.
+    void Play();
+    void Stop();
+    void Pause();
+    void Locate(uint32_t frame);
+
+    // Move one player; ignored unless the player is being mixed when the command is applied
+    void Seek(AudioPlayer* player, uint32_t frame);
+
+    // Frees the channel lists the render thread has finished with and sends on held-back
+    // commands. Call regularly from the control thread, e.g. once per UI frame.
+    void ProcessReplies();
+
+    // Commands are numbered from 1 in the order they were posted. Once the completed sequence
+    // reaches a command's number (as seen by ProcessReplies) it and everything before it applied.
+    uint64_t GetPostedSequence() const { return postedSequence_; }
+    uint64_t GetCompletedSequence() const { return completedSequence_; }
+
+    // Fill numFrames interleaved frames (render thread). The mix is stereo; a mono output gets
+    // both sides averaged and outputs wider than stereo get silence past the first two channels.
+    void Render(float* output, uint32_t numFrames, uint16_t outputChannels = kOutputChannels);
+
+    uint64_t GetRenderedFrames() const { return renderedFrames_.load(std::memory_order_relaxed); }
+
+    // Any thread - session frames played since the last Stop or Locate, as of the last block
+    uint32_t GetPlayhead() const { return playhead_.load(std::memory_order_relaxed); }
+
+    // Any thread; taken up at the next Render()
+    void SetSmoothing(Smoothing smoothing) { smoothing_.store(smoothing, std::memory_order_relaxed); }
+    Smoothing GetSmoothing() const { return smoothing_.load(std::memory_order_relaxed); }
+
+    // Add numFrames interleaved frames of a source with 1..kMaxSourceChannels channels into
+    // interleaved stereo, with the engine's pan laws. Gain and pan are fixed, ramp linearly from
+    // start to end, or are given per frame.
+    static void MixSource(const float* frames, uint16_t channels, uint32_t numFrames, float gain, float pan,
+                          float* output);
+    static void MixSource(const float* frames, uint16_t channels, uint32_t numFrames, float gainStart, float gainEnd,
+                          float panStart, float panEnd, float* output);
+    static void MixSource(const float* frames, uint16_t channels, uint32_t numFrames, const float* gains,
+                          const float* pans, float* output);
+
+    // Left and right gain of a source at unity gain - constant power for mono, balance otherwise
+    static void GetPanGains(uint16_t channels, float pan, float& left, float& right);
+
+    // Micro-benchmark: how many blocks per second the engine mixes for a synthetic session
+    struct BenchmarkResult
+    {
+        Smoothing smoothing;
+        uint32_t numChannels;
+        uint32_t blockFrames;
+        double blocksPerSecond;
+        double realTimeFactor;  // Audio seconds mixed per second at 44.1 kHz
+    };
+
+    // A few channels change volume and pan every block, so ramps are always running
+    static BenchmarkResult RunBenchmark(Smoothing smoothing = SMOOTH_PER_BLOCK, uint32_t numChannels = 64,
+                                        uint32_t blockFrames = 256, uint32_t numBlocks = 2000, int iterations = 3);
+    static void PrintBenchmark(const BenchmarkResult& result);
+
+private:
+    enum CommandType
+    {
+        COMMAND_SET_SOURCES,
+        COMMAND_PLAY,
+        COMMAND_STOP,
+        COMMAND_PAUSE,
+        COMMAND_LOCATE,
+        COMMAND_SEEK
+    };
+
+    // Plain words only, so the queues never run a constructor or destructor on the render thread
+    struct Command
+    {
+        CommandType type;
+        uint64_t sequence;
+        std::vector<Source>* sources; // SET_SOURCES - ownership passes to the render thread
+        AudioPlayer* player;          // SEEK
+        uint32_t frame;               // LOCATE and SEEK
+    };
+
+    struct Reply
+    {
+        uint64_t sequence;            // The command that was applied
+        std::vector<Source>* garbage; // The channel list it replaced, for the control thread to free
+    };
+
+    // Control thread
+    std::vector<Source> published_;
+    std::deque<Command> backlog_;     // Posted while the command queue was full, oldest first
+    uint64_t postedSequence_;
+    uint64_t completedSequence_;
+
+    SpscQueue<Command> commands_;     // Control thread to render thread
+    SpscQueue<Reply> replies_;        // Render thread to control thread
+
+    // Render thread
+    std::vector<Source>* sources_;    // Owned; swapped by SET_SOURCES
+    bool rolling_;                    // Transport playing - the playhead advances
+    uint32_t playheadFrames_;
+    std::atomic<uint32_t> playhead_;
+    std::atomic<uint64_t> renderedFrames_;
+    std::atomic<Smoothing> smoothing_;
+    std::vector<float> scratch_; // One source block, kMaxBlockFrames * kMaxSourceChannels floats
+    std::vector<float> stereo_;  // One mixed block for outputs that are not stereo
+    std::vector<float> gains_;   // Per-sample smoothing: gain, pan and fade ramps of one block
+    std::vector<float> pans_;
+    std::vector<float> fades_;
+
+    void Post(const Command& command);
+    void ApplyCommands();
+    void RenderBlock(const std::vector<Source>& sources, float* output, uint32_t numFrames, Smoothing smoothing);
+};
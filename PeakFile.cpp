@@ -0,0 +1,107 @@
+#include "PeakFile.h"
+#include "PeakPyramid.h"
+#include "MappedFile.h"
+#include "SampleBuffer.h"
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+static const char kMagic[8] = { 'E', 'X', 'D', 'A', 'W', 'P', 'K', 0 };
+static const uint32_t kVersion = 1;
+
+// Fixed part of the header, followed by the source path and padding up to dataOffset
+struct PeakFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t dataOffset;    // Header block size, a multiple of SampleBuffer::kAlignment
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t dataCount;     // Floats in the pyramid block
+    uint32_t numFrames;
+    uint16_t channels;
+    uint16_t baseShift;     // PeakPyramid::kBaseShift the levels were built with
+    uint32_t source;        // PeakPyramid::Source
+    uint32_t pathLength;
+};
+
+// Longest source path a header holds - keeps a corrupt pathLength from reading far into the file
+static const size_t kMaxPathLength = 32768;
+
+bool PeakFile::Write(const std::string& filePath, const PeakPyramid& peaks,
+                     const std::string& sourceKey, uint64_t sourceSize, int64_t sourceTime)
+{
+    if (!peaks.IsComplete() || peaks.GetDataCount() == 0 || sourceKey.size() > kMaxPathLength)
+    {
+        return false;
+    }
+
+    const size_t headerBytes = sizeof(PeakFileHeader) + sourceKey.size();
+    const size_t dataOffset = (headerBytes + SampleBuffer::kAlignment - 1) / SampleBuffer::kAlignment * SampleBuffer::kAlignment;
+
+    PeakFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.dataOffset = static_cast<uint32_t>(dataOffset);
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.dataCount = peaks.GetDataCount();
+    header.numFrames = peaks.GetNumFrames();
+    header.channels = peaks.GetNumChannels();
+    header.baseShift = static_cast<uint16_t>(PeakPyramid::kBaseShift);
+    header.source = peaks.GetSource();
+    header.pathLength = static_cast<uint32_t>(sourceKey.size());
+
+    std::vector<char> headerBlock(dataOffset, 0);
+    memcpy(headerBlock.data(), &header, sizeof(header));
+    memcpy(headerBlock.data() + sizeof(header), sourceKey.data(), sourceKey.size());
+
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    file.write(headerBlock.data(), headerBlock.size());
+    file.write(reinterpret_cast<const char*>(peaks.GetData()), static_cast<std::streamsize>(peaks.GetSizeBytes()));
+    file.close();
+    if (!file)
+    {
+        printf("Peak file: could not write %s\n", filePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const PeakPyramid> PeakFile::Open(const std::string& filePath,
+                                                  const std::string& sourceKey, uint64_t sourceSize, int64_t sourceTime)
+{
+    auto mapping = std::make_unique<MappedFile>();
+    if (!mapping->Open(filePath) || mapping->GetSize() < sizeof(PeakFileHeader))
+    {
+        return nullptr;
+    }
+
+    PeakFileHeader header;
+    memcpy(&header, mapping->GetData(), sizeof(header));
+    bool valid = memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == kVersion &&
+        header.baseShift == PeakPyramid::kBaseShift && header.source <= PeakPyramid::SOURCE_MID_SIDE &&
+        header.pathLength <= kMaxPathLength && header.dataOffset % SampleBuffer::kAlignment == 0 &&
+        sizeof(PeakFileHeader) + header.pathLength <= header.dataOffset && header.dataOffset <= mapping->GetSize() &&
+        header.sourceSize == sourceSize && header.sourceTime == sourceTime;
+    if (valid && !sourceKey.empty())
+    {
+        valid = header.pathLength == sourceKey.size() &&
+            memcmp(mapping->GetData() + sizeof(PeakFileHeader), sourceKey.data(), sourceKey.size()) == 0;
+    }
+    if (!valid)
+    {
+        return nullptr;
+    }
+
+    // FromMapping checks that the block fits the file; the count must also match the shape it derives
+    std::shared_ptr<PeakPyramid> peaks = PeakPyramid::FromMapping(std::move(mapping), header.dataOffset,
+        header.numFrames, header.channels, static_cast<PeakPyramid::Source>(header.source));
+    if (!peaks || peaks->GetDataCount() != header.dataCount)
+    {
+        return nullptr;
+    }
+    return peaks;
+}
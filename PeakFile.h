@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+class PeakPyramid;
+
+// Peak File - a PeakPyramid as a compact binary file (.peaks) that maps back in place.
+// A short header names the source file and records its size and modification time; every
+// level follows as the pyramid's own block, 64-byte aligned, so opening one costs a mapping
+// and a header check however long the source is, and only the pages drawn are ever read.
+namespace PeakFile
+{
+    static const char* const kExtension = ".peaks";
+
+    // Write peaks, which must be complete, for the source identified by sourceKey, sourceSize and
+    // sourceTime. Writes filePath directly - write elsewhere and rename to publish it atomically.
+    bool Write(const std::string& filePath, const PeakPyramid& peaks,
+               const std::string& sourceKey, uint64_t sourceSize, int64_t sourceTime);
+
+    // Map filePath if it is a peak file of this version for the source as given, else nullptr.
+    // An empty sourceKey accepts a file written for any path (e.g. a sidecar copied with its source).
+    std::shared_ptr<const PeakPyramid> Open(const std::string& filePath,
+                                            const std::string& sourceKey, uint64_t sourceSize, int64_t sourceTime);
+}
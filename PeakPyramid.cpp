@@ -0,0 +1,522 @@
+#include "PeakPyramid.h"
+#include "SampleBuffer.h"
+#include "ThreadPool.h"
+#include "SampleConvert.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Level-0 entries per parallel build task - 1M frames
+static const uint32_t kBuildChunkEntries = 16384;
+
+// visitor(const float* samples, size_t count) over frames of one pyramid channel - a buffer channel,
+// or for mid/side the half sum or half difference of the first two, built a decoded block at a time
+template <typename Visitor>
+static void VisitSource(const SampleBuffer& buffer, PeakPyramid::Source source, uint16_t channel,
+                        uint32_t startFrame, uint32_t numFrames, Visitor&& visitor)
+{
+    if (source == PeakPyramid::SOURCE_CHANNELS)
+    {
+        buffer.VisitChannel(channel, startFrame, numFrames, visitor);
+        return;
+    }
+
+    float mid[SampleBuffer::kDecodeBlockFrames];
+    float side[SampleBuffer::kDecodeBlockFrames];
+    for (uint32_t done = 0; done < numFrames; done += SampleBuffer::kDecodeBlockFrames)
+    {
+        uint32_t frames = std::min(numFrames - done, SampleBuffer::kDecodeBlockFrames);
+        frames = buffer.ReadChannel(0, startFrame + done, frames, mid);
+        buffer.ReadChannel(1, startFrame + done, frames, side);
+        if (frames == 0)
+        {
+            break;
+        }
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            float left = mid[i];
+            mid[i] = 0.5f * (left + side[i]);
+            side[i] = 0.5f * (left - side[i]);
+        }
+        visitor(static_cast<const float*>(channel == 0 ? mid : side), static_cast<size_t>(frames));
+    }
+}
+
+PeakPyramid::PeakPyramid(uint32_t numFrames, uint16_t channels, Source source)
+    : base_(nullptr)
+    , dataCount_(0)
+    , numFrames_(numFrames)
+    , channels_(channels)
+    , source_(source)
+    , validFrames_(0)
+{
+    BuildLayout();
+    data_.assign(dataCount_, 0.0f);
+    base_ = data_.data();
+}
+
+PeakPyramid::PeakPyramid(uint32_t numFrames, uint16_t channels, Source source, std::unique_ptr<MappedFile> mapping, uint64_t offset)
+    : mapping_(std::move(mapping))
+    , base_(reinterpret_cast<const float*>(mapping_->GetData() + offset))
+    , dataCount_(0)
+    , numFrames_(numFrames)
+    , channels_(channels)
+    , source_(source)
+    , validFrames_(numFrames)
+{
+    BuildLayout();
+}
+
+PeakPyramid::~PeakPyramid()
+{
+}
+
+void PeakPyramid::BuildLayout()
+{
+    if (numFrames_ == 0 || channels_ == 0)
+    {
+        return;
+    }
+
+    size_t offset = 0;
+    uint32_t entries = (numFrames_ + kBaseFrames - 1) / kBaseFrames;
+    for (;;)
+    {
+        levels_.push_back(Level{ entries, offset });
+        offset += static_cast<size_t>(entries) * channels_ * 3;
+        if (entries == 1)
+        {
+            break;
+        }
+        entries = (entries + 1) / 2;
+    }
+    dataCount_ = offset;
+}
+
+std::shared_ptr<PeakPyramid> PeakPyramid::Build(const SampleBuffer& buffer, Source source)
+{
+    if (source == SOURCE_MID_SIDE && buffer.GetNumChannels() < 2)
+    {
+        return nullptr;
+    }
+    uint16_t channels = source == SOURCE_MID_SIDE ? 2 : buffer.GetNumChannels();
+    auto pyramid = std::make_shared<PeakPyramid>(buffer.GetNumFrames(), channels, source);
+    if (pyramid->levels_.empty())
+    {
+        return pyramid;
+    }
+
+    const uint32_t baseEntries = pyramid->levels_[0].numEntries;
+    const size_t chunksPerChannel = (baseEntries + kBuildChunkEntries - 1) / kBuildChunkEntries;
+    ThreadPool::GetShared().ParallelFor(chunksPerChannel * pyramid->channels_, [&](size_t task)
+    {
+        uint16_t channel = static_cast<uint16_t>(task / chunksPerChannel);
+        uint32_t first = static_cast<uint32_t>(task % chunksPerChannel) * kBuildChunkEntries;
+        pyramid->ComputeBase(buffer, channel, first, std::min(baseEntries, first + kBuildChunkEntries), pyramid->numFrames_);
+    });
+
+    // The upper levels hold half the base entries in total - one task per channel
+    ThreadPool::GetShared().ParallelFor(pyramid->channels_, [&](size_t channel)
+    {
+        pyramid->ComputeLevels(static_cast<uint16_t>(channel), 0, baseEntries);
+    });
+    pyramid->validFrames_.store(pyramid->numFrames_, std::memory_order_release);
+    return pyramid;
+}
+
+std::shared_ptr<PeakPyramid> PeakPyramid::FromMapping(std::unique_ptr<MappedFile> mapping, uint64_t offset,
+                                                      uint32_t numFrames, uint16_t channels, Source source)
+{
+    if (!mapping || !mapping->IsOpen() || offset % alignof(float) != 0 || offset > mapping->GetSize())
+    {
+        return nullptr;
+    }
+    uint64_t available = mapping->GetSize() - offset;
+    std::shared_ptr<PeakPyramid> pyramid(new PeakPyramid(numFrames, channels, source, std::move(mapping), offset));
+    if (pyramid->levels_.empty() || static_cast<uint64_t>(pyramid->dataCount_) * sizeof(float) > available)
+    {
+        return nullptr;
+    }
+    return pyramid;
+}
+
+void PeakPyramid::Update(const SampleBuffer& buffer, uint32_t startFrame, uint32_t numFrames)
+{
+    if (levels_.empty() || mapping_ || startFrame >= numFrames_ || numFrames == 0)
+    {
+        return;
+    }
+
+    uint32_t endFrame = startFrame + std::min(numFrames, numFrames_ - startFrame);
+    uint32_t firstEntry = startFrame / kBaseFrames;
+    uint32_t endEntry = (endFrame + kBaseFrames - 1) / kBaseFrames;
+    for (uint16_t ch = 0; ch < channels_; ++ch)
+    {
+        ComputeBase(buffer, ch, firstEntry, endEntry, numFrames_);
+        ComputeLevels(ch, firstEntry, endEntry);
+    }
+}
+
+void PeakPyramid::Extend(const SampleBuffer& buffer, uint32_t startFrame, uint32_t endFrame)
+{
+    if (levels_.empty() || startFrame >= endFrame)
+    {
+        return;
+    }
+
+    // Frames past endFrame may still be being decoded - the entry straddling it is left partial and
+    // redone by the next call, which starts from that entry
+    uint32_t firstEntry = startFrame / kBaseFrames;
+    uint32_t endEntry = (endFrame + kBaseFrames - 1) / kBaseFrames;
+    for (uint16_t ch = 0; ch < channels_; ++ch)
+    {
+        ComputeBase(buffer, ch, firstEntry, endEntry, endFrame);
+        ComputeLevels(ch, firstEntry, endEntry);
+    }
+}
+
+uint32_t PeakPyramid::GetNumValidEntries(uint32_t level) const
+{
+    uint32_t validFrames = GetValidFrames();
+    return validFrames == numFrames_ ? levels_[level].numEntries : validFrames >> (kBaseShift + level);
+}
+
+uint32_t PeakPyramid::SelectLevel(uint32_t framesPerPoint) const
+{
+    uint32_t level = 0;
+    while (level + 1 < levels_.size() && (static_cast<uint64_t>(kBaseFrames) << (level + 1)) <= framesPerPoint)
+    {
+        ++level;
+    }
+    return level;
+}
+
+void PeakPyramid::GetPeaks(uint16_t channel, uint32_t startFrame, uint32_t framesPerPoint, uint32_t numPoints,
+                           float* minValues, float* maxValues, float* rmsValues) const
+{
+    if (levels_.empty() || channel >= channels_ || framesPerPoint == 0)
+    {
+        std::fill(minValues, minValues + numPoints, 0.0f);
+        std::fill(maxValues, maxValues + numPoints, 0.0f);
+        if (rmsValues)
+        {
+            std::fill(rmsValues, rmsValues + numPoints, 0.0f);
+        }
+        return;
+    }
+
+    const uint32_t level = SelectLevel(framesPerPoint);
+    const uint32_t shift = kBaseShift + level;
+    const uint64_t numEntries = GetNumValidEntries(level);
+    const float* mins = GetMin(level, channel);
+    const float* maxs = GetMax(level, channel);
+    const float* sumSquares = GetSumSquares(level, channel);
+
+    for (uint32_t i = 0; i < numPoints; ++i)
+    {
+        uint64_t begin = startFrame + static_cast<uint64_t>(i) * framesPerPoint;
+        uint64_t first = begin >> shift;
+        uint64_t last = std::min(numEntries, std::max(first + 1, (begin + framesPerPoint) >> shift));
+
+        float minValue = 0.0f;
+        float maxValue = 0.0f;
+        double sum = 0.0;
+        if (first < numEntries)
+        {
+            minValue = mins[first];
+            maxValue = maxs[first];
+            for (uint64_t e = first; e < last; ++e)
+            {
+                minValue = std::min(minValue, mins[e]);
+                maxValue = std::max(maxValue, maxs[e]);
+                sum += sumSquares[e];
+            }
+        }
+
+        minValues[i] = minValue;
+        maxValues[i] = maxValue;
+        if (rmsValues)
+        {
+            uint64_t frames = std::min<uint64_t>(last << shift, numFrames_) - std::min<uint64_t>(first << shift, numFrames_);
+            rmsValues[i] = frames > 0 ? static_cast<float>(std::sqrt(sum / frames)) : 0.0f;
+        }
+    }
+}
+
+void PeakPyramid::GetRangePeaks(const SampleBuffer* buffer, uint32_t startFrame, uint32_t endFrame, uint32_t numPoints,
+                                uint32_t channelMask, float* minValues, float* maxValues) const
+{
+    std::fill(minValues, minValues + numPoints, 0.0f);
+    std::fill(maxValues, maxValues + numPoints, 0.0f);
+    if (levels_.empty() || startFrame >= endFrame)
+    {
+        return;
+    }
+
+    const uint32_t limit = std::min(numFrames_, GetValidFrames());
+    for (uint32_t i = 0; i < numPoints; ++i)
+    {
+        // Bins are laid out over the requested range; only their reads are clamped
+        uint32_t binStart = GetBinStart(startFrame, endFrame, numPoints, i);
+        uint32_t binEnd = std::max(binStart + 1, GetBinStart(startFrame, endFrame, numPoints, i + 1));
+        binEnd = std::min(binEnd, limit);
+        if (binStart >= binEnd)
+        {
+            continue;
+        }
+
+        for (uint16_t ch = 0; ch < channels_ && ch < 32; ++ch)
+        {
+            if (channelMask & (1u << ch))
+            {
+                ReduceRange(binEnd - binStart < kExactEdgeFrames ? buffer : nullptr, ch, binStart, binEnd,
+                            minValues[i], maxValues[i], nullptr);
+            }
+        }
+    }
+}
+
+PeakPyramid::Statistics PeakPyramid::GetRangeStatistics(const SampleBuffer* buffer, uint32_t startFrame, uint32_t endFrame,
+                                                        uint32_t channelMask) const
+{
+    Statistics stats;
+    endFrame = std::min(endFrame, std::min(numFrames_, GetValidFrames()));
+    if (levels_.empty() || startFrame >= endFrame)
+    {
+        return stats;
+    }
+
+    // Entries are summed in double, so the error does not grow with the length of the range
+    double sumSquares = 0.0;
+    uint64_t samples = 0;
+    float minValue = 0.0f;
+    float maxValue = 0.0f;
+    for (uint16_t ch = 0; ch < channels_ && ch < 32; ++ch)
+    {
+        if (channelMask & (1u << ch))
+        {
+            samples += ReduceRange(buffer, ch, startFrame, endFrame, minValue, maxValue, &sumSquares);
+        }
+    }
+    stats.peak = std::max(-minValue, maxValue);
+    stats.rms = samples > 0 ? static_cast<float>(std::sqrt(sumSquares / samples)) : 0.0f;
+    return stats;
+}
+
+void PeakPyramid::ComputeBase(const SampleBuffer& buffer, uint16_t channel, uint32_t firstEntry, uint32_t endEntry,
+                              uint32_t endFrame)
+{
+    float* mins = GetWritablePlane(0, channel, 0);
+    float* maxs = GetWritablePlane(0, channel, 1);
+    float* sumSquares = GetWritablePlane(0, channel, 2);
+
+    const uint32_t startFrame = firstEntry * kBaseFrames;
+    endFrame = std::min(endFrame, std::min(numFrames_, endEntry * kBaseFrames));
+    if (endFrame <= startFrame)
+    {
+        return;
+    }
+    uint32_t entry = firstEntry;
+    uint32_t fill = 0;
+    float minValue = 0.0f;
+    float maxValue = 0.0f;
+    float sum = 0.0f;
+
+    // Blocks arrive in whatever size the storage decodes; entries are cut out of them
+    VisitSource(buffer, source_, channel, startFrame, endFrame - startFrame, [&](const float* samples, size_t count)
+    {
+        while (count > 0)
+        {
+            if (fill == 0)
+            {
+                minValue = samples[0];
+                maxValue = samples[0];
+                sum = 0.0f;
+            }
+
+            size_t take = std::min<size_t>(count, kBaseFrames - fill);
+            SampleConvert::ReducePeaks(samples, take, &minValue, &maxValue, &sum);
+            samples += take;
+            count -= take;
+            fill += static_cast<uint32_t>(take);
+
+            if (fill == kBaseFrames)
+            {
+                mins[entry] = minValue;
+                maxs[entry] = maxValue;
+                sumSquares[entry] = sum;
+                ++entry;
+                fill = 0;
+            }
+        }
+    });
+
+    // Short last entry at the end of the buffer, or cut short by endFrame
+    if (fill > 0)
+    {
+        mins[entry] = minValue;
+        maxs[entry] = maxValue;
+        sumSquares[entry] = sum;
+    }
+}
+
+void PeakPyramid::ComputeLevels(uint16_t channel, uint32_t firstEntry, uint32_t endEntry)
+{
+    for (uint32_t level = 1; level < levels_.size(); ++level)
+    {
+        const uint32_t belowEntries = levels_[level - 1].numEntries;
+        const float* belowMin = GetMin(level - 1, channel);
+        const float* belowMax = GetMax(level - 1, channel);
+        const float* belowSum = GetSumSquares(level - 1, channel);
+        float* mins = GetWritablePlane(level, channel, 0);
+        float* maxs = GetWritablePlane(level, channel, 1);
+        float* sumSquares = GetWritablePlane(level, channel, 2);
+
+        firstEntry /= 2;
+        endEntry = std::min(levels_[level].numEntries, (endEntry + 1) / 2);
+        for (uint32_t e = firstEntry; e < endEntry; ++e)
+        {
+            uint32_t a = e * 2;
+            uint32_t b = std::min(a + 1, belowEntries - 1);
+            mins[e] = std::min(belowMin[a], belowMin[b]);
+            maxs[e] = std::max(belowMax[a], belowMax[b]);
+            sumSquares[e] = b != a ? belowSum[a] + belowSum[b] : belowSum[a];
+        }
+    }
+}
+
+uint32_t PeakPyramid::ReduceRange(const SampleBuffer* buffer, uint16_t channel, uint32_t startFrame, uint32_t endFrame,
+                                  float& minValue, float& maxValue, double* sumSquares) const
+{
+    auto scan = [&](uint32_t first, uint32_t end)
+    {
+        if (first < end)
+        {
+            VisitSource(*buffer, source_, channel, first, end - first, [&](const float* samples, size_t count)
+            {
+                float blockSum = 0.0f;
+                SampleConvert::ReducePeaks(samples, count, &minValue, &maxValue, sumSquares ? &blockSum : nullptr);
+                if (sumSquares)
+                {
+                    *sumSquares += blockSum;
+                }
+            });
+        }
+    };
+
+    // Level-0 entries wholly inside the range, with the frames around them read directly
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t frames;
+    if (buffer)
+    {
+        frames = endFrame - startFrame;
+        lo = (startFrame + kBaseFrames - 1) >> kBaseShift;
+        hi = endFrame >> kBaseShift;
+        if (lo >= hi)
+        {
+            scan(startFrame, endFrame);
+            return frames;
+        }
+        scan(startFrame, lo << kBaseShift);
+        scan(hi << kBaseShift, endFrame);
+    }
+    else
+    {
+        // Nearest entry boundaries, keeping the short last entry and at least the entry under startFrame
+        const uint32_t validEntries = GetNumValidEntries(0);
+        const uint32_t half = kBaseFrames / 2;
+        lo = static_cast<uint32_t>((static_cast<uint64_t>(startFrame) + half) >> kBaseShift);
+        hi = endFrame == numFrames_ ? validEntries
+                                    : static_cast<uint32_t>((static_cast<uint64_t>(endFrame) + half) >> kBaseShift);
+        hi = std::min(hi, validEntries);
+        if (lo >= hi)
+        {
+            lo = startFrame >> kBaseShift;
+            hi = std::min(lo + 1, validEntries);
+        }
+        frames = lo < hi ? static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(hi) << kBaseShift, numFrames_) -
+                                                 (static_cast<uint64_t>(lo) << kBaseShift)) : 0;
+    }
+
+    // Cover [lo, hi) with the fewest entries - at most two per level, climbing while the range is wide
+    for (uint32_t level = 0; lo < hi; ++level)
+    {
+        const float* mins = GetMin(level, channel);
+        const float* maxs = GetMax(level, channel);
+        const float* sums = GetSumSquares(level, channel);
+        if (lo & 1)
+        {
+            minValue = std::min(minValue, mins[lo]);
+            maxValue = std::max(maxValue, maxs[lo]);
+            if (sumSquares)
+            {
+                *sumSquares += sums[lo];
+            }
+            ++lo;
+        }
+        if (hi & 1)
+        {
+            --hi;
+            minValue = std::min(minValue, mins[hi]);
+            maxValue = std::max(maxValue, maxs[hi]);
+            if (sumSquares)
+            {
+                *sumSquares += sums[hi];
+            }
+        }
+        lo >>= 1;
+        hi >>= 1;
+    }
+    return frames;
+}
+
+PeakBuilder::PeakBuilder(const SampleBuffer& buffer)
+    : buffer_(buffer)
+    , pyramid_(std::make_shared<PeakPyramid>(buffer.GetNumFrames(), buffer.GetNumChannels()))
+    , decodedFrames_(0)
+    , builtFrames_(0)
+{
+}
+
+void PeakBuilder::MarkDecoded(uint32_t startFrame, uint32_t numFrames)
+{
+    if (numFrames > 0)
+    {
+        std::lock_guard<std::mutex> lock(rangesMutex_);
+        pendingRanges_[startFrame] = startFrame + numFrames;
+        for (auto it = pendingRanges_.find(decodedFrames_); it != pendingRanges_.end(); it = pendingRanges_.find(decodedFrames_))
+        {
+            decodedFrames_ = it->second;
+            pendingRanges_.erase(it);
+        }
+    }
+
+    // Whoever holds buildMutex_ extends the pyramid, also over blocks other writers finish meanwhile.
+    // The recheck after unlocking catches a block marked just before the unlock.
+    while (buildMutex_.try_lock())
+    {
+        uint32_t target = GetDecodedFrames();
+        if (target > builtFrames_)
+        {
+            // Only decoded frames are read. Entries straddling builtFrames_ are recomputed, and readers
+            // only use entries below validFrames_, so they never see one half-built.
+            pyramid_->Extend(buffer_, builtFrames_, std::min(target, pyramid_->numFrames_));
+            pyramid_->validFrames_.store(target, std::memory_order_release);
+            builtFrames_ = target;
+        }
+        buildMutex_.unlock();
+
+        if (GetDecodedFrames() <= target)
+        {
+            break;
+        }
+    }
+}
+
+uint32_t PeakBuilder::GetDecodedFrames()
+{
+    std::lock_guard<std::mutex> lock(rangesMutex_);
+    return decodedFrames_;
+}
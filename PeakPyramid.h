@@ -0,0 +1,190 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+class SampleBuffer;
+class MappedFile;
+
+// Peak Pyramid - per-channel min, max and sum of squares of a SampleBuffer at power-of-two
+// decimations. Level 0 summarizes kBaseFrames frames per entry and every level above halves
+// the entry count, so a waveform at any zoom is answered from the level whose entries are
+// closest to one pixel, in time proportional to the pixel count instead of the sample count.
+//
+// All levels live in one contiguous float array, each level and channel as three planes
+// (min, max, sum of squares), so the whole pyramid can be written out and mapped back in place
+// as a block (see PeakFile).
+//
+// A pyramid filled by PeakBuilder while its samples are still arriving is readable as it grows:
+// readers only see entries that lie wholly inside GetValidFrames().
+class PeakPyramid
+{
+public:
+    static constexpr uint32_t kBaseShift = 6;
+    static constexpr uint32_t kBaseFrames = 1u << kBaseShift; // Frames per level-0 entry
+
+    // What the pyramid's channels summarize
+    enum Source
+    {
+        SOURCE_CHANNELS, // The buffer's channels
+        SOURCE_MID_SIDE  // Channel 0 (L+R)/2 and channel 1 (L-R)/2 of the buffer's first two channels
+    };
+
+    // Empty pyramid for numFrames frames; nothing is valid until it is filled
+    PeakPyramid(uint32_t numFrames, uint16_t channels, Source source = SOURCE_CHANNELS);
+    ~PeakPyramid();
+
+    PeakPyramid(const PeakPyramid&) = delete;
+    PeakPyramid& operator=(const PeakPyramid&) = delete;
+
+    // Pyramid of every sample in buffer, channels and chunks in parallel on the shared ThreadPool.
+    // SOURCE_MID_SIDE needs at least two channels and returns nullptr otherwise.
+    static std::shared_ptr<PeakPyramid> Build(const SampleBuffer& buffer, Source source = SOURCE_CHANNELS);
+
+    // Read-only pyramid over a block written from GetData() at offset of mapping, which it keeps open.
+    // nullptr if the block does not fit the shape or the mapping.
+    static std::shared_ptr<PeakPyramid> FromMapping(std::unique_ptr<MappedFile> mapping, uint64_t offset,
+                                                    uint32_t numFrames, uint16_t channels, Source source);
+
+    // Recompute the entries covering [startFrame, startFrame + numFrames) on every level.
+    // Mapped pyramids are read-only and ignore it.
+    void Update(const SampleBuffer& buffer, uint32_t startFrame, uint32_t numFrames);
+
+    uint32_t GetNumFrames() const { return numFrames_; }
+    uint16_t GetNumChannels() const { return channels_; }
+    Source GetSource() const { return source_; }
+    bool IsMapped() const { return mapping_ != nullptr; }
+    uint32_t GetNumLevels() const { return static_cast<uint32_t>(levels_.size()); }
+    uint32_t GetFramesPerEntry(uint32_t level) const { return kBaseFrames << level; }
+    uint32_t GetNumEntries(uint32_t level) const { return levels_[level].numEntries; }
+
+    // Frames whose entries are final - all of them unless the pyramid is still being built
+    uint32_t GetValidFrames() const { return validFrames_.load(std::memory_order_acquire); }
+    bool IsComplete() const { return GetValidFrames() == numFrames_; }
+    uint32_t GetNumValidEntries(uint32_t level) const;
+
+    // Planes of one level and channel, GetNumEntries(level) values each of which the first
+    // GetNumValidEntries(level) may be read while the pyramid is being built
+    const float* GetMin(uint32_t level, uint16_t channel) const { return GetPlane(level, channel, 0); }
+    const float* GetMax(uint32_t level, uint16_t channel) const { return GetPlane(level, channel, 1); }
+    const float* GetSumSquares(uint32_t level, uint16_t channel) const { return GetPlane(level, channel, 2); }
+
+    // Coarsest level whose entries span no more than framesPerPoint frames
+    uint32_t SelectLevel(uint32_t framesPerPoint) const;
+
+    // Min, max and RMS of one channel for numPoints points of framesPerPoint frames from startFrame.
+    // Point edges snap to entries of SelectLevel(framesPerPoint); framesPerPoint below kBaseFrames
+    // gets level-0 entries. Points past the valid frames are zero. rmsValues may be nullptr.
+    void GetPeaks(uint16_t channel, uint32_t startFrame, uint32_t framesPerPoint, uint32_t numPoints,
+                  float* minValues, float* maxValues, float* rmsValues) const;
+
+    // Envelope of the channels in channelMask (bit per channel) over [startFrame, endFrame), split into
+    // numPoints bins with fractional edges, so no frames are dropped at the end and every bin holds at
+    // least one frame. Each point spans zero. Whole entries inside a bin come from the coarsest levels
+    // that fit. The ragged frames at the edges of bins narrower than kExactEdgeFrames are read from
+    // buffer; wider bins, or any bin without a buffer, move their edges to the nearest level-0 entry
+    // boundary. Nothing outside the range is read. Frames past the valid frames are zero.
+    void GetRangePeaks(const SampleBuffer* buffer, uint32_t startFrame, uint32_t endFrame, uint32_t numPoints,
+                       uint32_t channelMask, float* minValues, float* maxValues) const;
+
+    // First frame of bin index when [startFrame, endFrame) is split into numPoints bins
+    static uint32_t GetBinStart(uint32_t startFrame, uint32_t endFrame, uint32_t numPoints, uint32_t index)
+    {
+        return startFrame + static_cast<uint32_t>(static_cast<uint64_t>(endFrame - startFrame) * index / numPoints);
+    }
+
+    static constexpr uint32_t kAllChannels = 0xFFFFFFFFu;
+    static constexpr uint32_t kExactEdgeFrames = kBaseFrames * 16; // Edges move by under 1/16 of a bin
+
+    struct Statistics
+    {
+        float peak = 0.0f; // Largest absolute sample
+        float rms = 0.0f;
+    };
+
+    // Peak and RMS of the channels in channelMask over [startFrame, endFrame) in O(levels) entries,
+    // with the edge frames read from buffer or, without one, rounded to level-0 entries.
+    // Entries recomputed by Update() are reflected straight away, so statistics follow edits.
+    Statistics GetRangeStatistics(const SampleBuffer* buffer, uint32_t startFrame, uint32_t endFrame,
+                                  uint32_t channelMask = kAllChannels) const;
+    Statistics GetStatistics() const { return GetRangeStatistics(nullptr, 0, numFrames_); }
+
+    // The whole pyramid as one block
+    const float* GetData() const { return base_; }
+    size_t GetDataCount() const { return dataCount_; }
+    size_t GetSizeBytes() const { return dataCount_ * sizeof(float); }
+
+private:
+    struct Level
+    {
+        uint32_t numEntries;
+        size_t offset; // Of channel 0's min plane in the block
+    };
+
+    std::vector<float> data_;                // Owned block, empty when mapped
+    std::unique_ptr<MappedFile> mapping_;    // Mapped block, nullptr when owned
+    const float* base_;                      // The block either way
+    size_t dataCount_;
+    std::vector<Level> levels_;
+    uint32_t numFrames_;
+    uint16_t channels_;
+    Source source_;
+    std::atomic<uint32_t> validFrames_;
+
+    friend class PeakBuilder;
+
+    const float* GetPlane(uint32_t level, uint16_t channel, int plane) const
+    {
+        const Level& entry = levels_[level];
+        return base_ + entry.offset + (static_cast<size_t>(channel) * 3 + plane) * entry.numEntries;
+    }
+    float* GetWritablePlane(uint32_t level, uint16_t channel, int plane)
+    {
+        return const_cast<float*>(GetPlane(level, channel, plane));
+    }
+
+    PeakPyramid(uint32_t numFrames, uint16_t channels, Source source, std::unique_ptr<MappedFile> mapping, uint64_t offset);
+    void BuildLayout(); // levels_ and dataCount_ for the shape
+
+    // Level-0 entries [firstEntry, endEntry), reading no sample at or past endFrame - an entry cut short by
+    // it is written partial and must be recomputed once its frames are there
+    void ComputeBase(const SampleBuffer& buffer, uint16_t channel, uint32_t firstEntry, uint32_t endEntry,
+                     uint32_t endFrame);
+    void Extend(const SampleBuffer& buffer, uint32_t startFrame, uint32_t endFrame); // PeakBuilder, see MarkDecoded
+    void ComputeLevels(uint16_t channel, uint32_t firstEntry, uint32_t endEntry); // Level-0 range, propagated up
+    uint32_t ReduceRange(const SampleBuffer* buffer, uint16_t channel, uint32_t startFrame, uint32_t endFrame,
+                         float& minValue, float& maxValue, double* sumSquares) const; // Returns frames covered
+};
+
+// Peak Builder - fills a PeakPyramid while its SampleBuffer is being decoded or recorded.
+// Writers report finished blocks in any order and from any thread; the pyramid grows over the
+// longest finished prefix, built by whichever writer is free, so no writer waits on another
+// and nothing is scanned twice. Watchers can draw GetPyramid() the whole time.
+class PeakBuilder
+{
+public:
+    explicit PeakBuilder(const SampleBuffer& buffer);
+
+    // [startFrame, startFrame + numFrames) of the buffer holds its final samples
+    void MarkDecoded(uint32_t startFrame, uint32_t numFrames);
+
+    const std::shared_ptr<PeakPyramid>& GetPyramid() const { return pyramid_; }
+
+private:
+    const SampleBuffer& buffer_;
+    std::shared_ptr<PeakPyramid> pyramid_;
+
+    std::mutex rangesMutex_;
+    std::map<uint32_t, uint32_t> pendingRanges_; // Start -> end of blocks past the finished prefix
+    uint32_t decodedFrames_;                     // Finished prefix
+
+    std::mutex buildMutex_;
+    uint32_t builtFrames_;                       // Prefix covered by the pyramid
+
+    uint32_t GetDecodedFrames();
+};
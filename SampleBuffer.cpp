@@ -0,0 +1,401 @@
+#include "SampleBuffer.h"
+#include "SampleConvert.h"
+#include "MappedFile.h"
+#include "AudioAnalysis.h"
+#include <new>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+
+// Channels interleaved per pass without touching the heap
+static const size_t kMaxInterleaveChannels = 32;
+
+// Channels decoded per block when interleaving compact storage - 8 KB of stack scratch
+static const size_t kCompactGroupChannels = 8;
+
+// Packed encoding the float kernels read each storage from
+static SampleConvert::Format StorageFormat(SampleBuffer::Storage storage)
+{
+    switch (storage)
+    {
+    case SampleBuffer::STORAGE_INT16: return SampleConvert::PCM_S16;
+    case SampleBuffer::STORAGE_INT24: return SampleConvert::PCM_S24;
+    default: return SampleConvert::FLOAT32;
+    }
+}
+
+// Write count channels starting at firstChannel into frames of totalChannels
+static void InterleaveGroup(const float* const* src, uint16_t count, uint16_t firstChannel, uint16_t totalChannels,
+                            float* dest, size_t numFrames)
+{
+    if (count == totalChannels)
+    {
+        SampleConvert::Interleave(src, dest, totalChannels, numFrames);
+        return;
+    }
+
+    // Very wide layouts go a group of channels at a time
+    for (uint16_t ch = 0; ch < count; ++ch)
+    {
+        for (size_t i = 0; i < numFrames; ++i)
+        {
+            dest[i * totalChannels + firstChannel + ch] = src[ch][i];
+        }
+    }
+}
+
+static const uint64_t kHashPrime1 = 0x9E3779B185EBCA87ull;
+static const uint64_t kHashPrime2 = 0xC2B2AE3D27D4EB4Full;
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t HashRound(uint64_t lane, uint64_t input)
+{
+    return RotateLeft(lane + input * kHashPrime2, 31) * kHashPrime1;
+}
+
+static uint64_t HashBytes(uint64_t seed, const uint8_t* bytes, size_t size)
+{
+    // Four independent lanes over 32-byte stripes keep the multiplies pipelined
+    uint64_t lanes[4] = { seed + kHashPrime1 + kHashPrime2, seed + kHashPrime2, seed, seed - kHashPrime1 };
+
+    size_t offset = 0;
+    for (; offset + 32 <= size; offset += 32)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + offset + lane * 8, sizeof(word));
+            lanes[lane] = HashRound(lanes[lane], word);
+        }
+    }
+
+    uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+    for (; offset + 8 <= size; offset += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + offset, sizeof(word));
+        hash = HashRound(hash, word);
+    }
+    if (offset < size)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + offset, size - offset);
+        hash = HashRound(hash, word);
+    }
+    return HashRound(hash, size);
+}
+
+SampleBuffer::SampleBuffer(uint32_t numFrames, uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample,
+                           Storage storage)
+    : channelStride_((static_cast<size_t>(numFrames) * GetBytesPerSample(storage) + kAlignment - 1) & ~(kAlignment - 1))
+    , numFrames_(numFrames)
+    , sampleRate_(sampleRate)
+    , channels_(channels)
+    , bitsPerSample_(bitsPerSample)
+    , storage_(storage)
+    , contentHash_(0)
+    , sealed_(false)
+{
+    size_t total = std::max<size_t>(kAlignment, channelStride_ * channels_);
+    ownedSamples_.reset(new (std::align_val_t(kAlignment)) uint8_t[total]);
+    samples_ = ownedSamples_.get();
+
+    // Padding is zeroed so whole-line SIMD reads past the last frame see silence
+    const size_t usedBytes = static_cast<size_t>(numFrames_) * GetBytesPerSample(storage_);
+    for (uint16_t ch = 0; ch < channels_; ++ch)
+    {
+        uint8_t* channel = GetWritableChannelBytes(ch);
+        std::fill(channel + usedBytes, channel + channelStride_, static_cast<uint8_t>(0));
+    }
+}
+
+SampleBuffer::SampleBuffer()
+    : samples_(nullptr)
+    , channelStride_(0)
+    , numFrames_(0)
+    , sampleRate_(0)
+    , channels_(0)
+    , bitsPerSample_(0)
+    , storage_(STORAGE_FLOAT32)
+    , contentHash_(0)
+    , sealed_(false)
+{
+}
+
+SampleBuffer::~SampleBuffer()
+{
+}
+
+std::unique_ptr<SampleBuffer> SampleBuffer::FromMapping(std::unique_ptr<MappedFile> mapping, uint64_t offset,
+                                                        size_t channelStride, uint32_t numFrames, uint32_t sampleRate,
+                                                        uint16_t channels, uint16_t bitsPerSample, Storage storage,
+                                                        uint64_t contentHash)
+{
+    // Compared by division, so a stride from a damaged file cannot wrap the product past the bounds test
+    const uint64_t size = mapping && mapping->IsOpen() ? mapping->GetSize() : 0;
+    if (!mapping || !mapping->IsOpen() || offset > size || (channels > 0 && channelStride > (size - offset) / channels) ||
+        offset % kAlignment != 0 || channelStride % kAlignment != 0 ||
+        channelStride < static_cast<uint64_t>(numFrames) * GetBytesPerSample(storage))
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<SampleBuffer> buffer(new SampleBuffer());
+    buffer->samples_ = const_cast<uint8_t*>(mapping->GetData() + offset);
+    buffer->mapping_ = std::move(mapping);
+    buffer->channelStride_ = channelStride;
+    buffer->numFrames_ = numFrames;
+    buffer->sampleRate_ = sampleRate;
+    buffer->channels_ = channels;
+    buffer->bitsPerSample_ = bitsPerSample;
+    buffer->storage_ = storage;
+    buffer->contentHash_ = contentHash;
+    buffer->sealed_ = true;
+    return buffer;
+}
+
+void SampleBuffer::Seal()
+{
+    if (sealed_)
+    {
+        return;
+    }
+
+    uint64_t hash = HashRound(kHashPrime1, (static_cast<uint64_t>(sampleRate_) << 32) |
+        (static_cast<uint64_t>(channels_) << 16) | bitsPerSample_);
+    hash = HashRound(hash, storage_);
+    const size_t channelBytes = static_cast<size_t>(numFrames_) * GetBytesPerSample(storage_);
+    for (uint16_t ch = 0; ch < channels_; ++ch)
+    {
+        hash = HashBytes(hash, GetChannelBytes(ch), channelBytes);
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= kHashPrime2;
+    hash ^= hash >> 29;
+    contentHash_ = hash;
+    sealed_ = true;
+}
+
+uint32_t SampleBuffer::ReadChannel(uint16_t channel, uint32_t startFrame, uint32_t numFrames, float* dest) const
+{
+    if (channel >= channels_ || startFrame >= numFrames_)
+    {
+        return 0;
+    }
+    numFrames = std::min(numFrames, numFrames_ - startFrame);
+
+    const size_t bytesPerSample = GetBytesPerSample(storage_);
+    SampleConvert::ToFloat(StorageFormat(storage_), GetChannelBytes(channel) + startFrame * bytesPerSample, dest, numFrames);
+    return numFrames;
+}
+
+float SampleBuffer::GetSample(uint32_t frame, uint16_t channel) const
+{
+    if (!IsCompact())
+    {
+        return GetChannelData(channel)[frame];
+    }
+
+    float sample = 0.0f;
+    ReadChannel(channel, frame, 1, &sample);
+    return sample;
+}
+
+uint32_t SampleBuffer::ReadInterleaved(uint32_t startFrame, uint32_t numFrames, float* dest) const
+{
+    if (startFrame >= numFrames_)
+    {
+        return 0;
+    }
+    numFrames = std::min(numFrames, numFrames_ - startFrame);
+
+    // Called from the render thread - channel pointers and scratch live on the stack, no allocation
+    if (!IsCompact())
+    {
+        const float* channels[kMaxInterleaveChannels];
+        for (uint16_t first = 0; first < channels_; first += kMaxInterleaveChannels)
+        {
+            uint16_t count = static_cast<uint16_t>(std::min<size_t>(kMaxInterleaveChannels, channels_ - first));
+            for (uint16_t ch = 0; ch < count; ++ch)
+            {
+                channels[ch] = GetChannelData(first + ch) + startFrame;
+            }
+            InterleaveGroup(channels, count, first, channels_, dest, numFrames);
+        }
+        return numFrames;
+    }
+
+    // Compact storage: decode one block per channel into L1, then interleave it
+    float scratch[kCompactGroupChannels * kDecodeBlockFrames];
+    const float* channels[kCompactGroupChannels];
+    for (uint32_t done = 0; done < numFrames; done += kDecodeBlockFrames)
+    {
+        uint32_t frames = std::min(kDecodeBlockFrames, numFrames - done);
+        float* blockDest = dest + static_cast<size_t>(done) * channels_;
+        for (uint16_t first = 0; first < channels_; first += kCompactGroupChannels)
+        {
+            uint16_t count = static_cast<uint16_t>(std::min<size_t>(kCompactGroupChannels, channels_ - first));
+            for (uint16_t ch = 0; ch < count; ++ch)
+            {
+                float* block = scratch + ch * kDecodeBlockFrames;
+                ReadChannel(first + ch, startFrame + done, frames, block);
+                channels[ch] = block;
+            }
+            InterleaveGroup(channels, count, first, channels_, blockDest, frames);
+        }
+    }
+    return numFrames;
+}
+
+bool SampleBuffer::HasSameContent(const SampleBuffer& other) const
+{
+    if (contentHash_ != other.contentHash_ || numFrames_ != other.numFrames_ || sampleRate_ != other.sampleRate_ ||
+        channels_ != other.channels_ || bitsPerSample_ != other.bitsPerSample_ || storage_ != other.storage_)
+    {
+        return false;
+    }
+
+    const size_t channelBytes = static_cast<size_t>(numFrames_) * GetBytesPerSample(storage_);
+    for (uint16_t ch = 0; ch < channels_; ++ch)
+    {
+        if (std::memcmp(GetChannelBytes(ch), other.GetChannelBytes(ch), channelBytes) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t SampleBuffer::GetBytesPerSample(Storage storage)
+{
+    switch (storage)
+    {
+    case STORAGE_INT16: return 2;
+    case STORAGE_INT24: return 3;
+    default: return sizeof(float);
+    }
+}
+
+const char* SampleBuffer::GetStorageName(Storage storage)
+{
+    switch (storage)
+    {
+    case STORAGE_INT16: return "Int16";
+    case STORAGE_INT24: return "Int24";
+    default: return "Float32";
+    }
+}
+
+std::vector<SampleBuffer::StorageBenchmarkResult> SampleBuffer::RunStorageBenchmark(uint32_t numFrames, uint16_t channels,
+                                                                                   int iterations)
+{
+    std::vector<StorageBenchmarkResult> results;
+    if (numFrames == 0 || channels == 0)
+    {
+        return results;
+    }
+
+    std::vector<float> interleaved(static_cast<size_t>(kDecodeBlockFrames) * channels);
+    const uint32_t numBlocks = (numFrames + kDecodeBlockFrames - 1) / kDecodeBlockFrames;
+    size_t floatBytes = 0;
+
+    const Storage storages[] = { STORAGE_FLOAT32, STORAGE_INT16, STORAGE_INT24 };
+    for (Storage storage : storages)
+    {
+        // Same deterministic 16-bit noise in every storage, so the decoded floats match
+        SampleBuffer buffer(numFrames, 48000, channels, 16, storage);
+        uint32_t seed = 0x12345678u;
+        for (uint16_t ch = 0; ch < channels; ++ch)
+        {
+            uint8_t* bytes = buffer.GetWritableChannelBytes(ch);
+            for (uint32_t i = 0; i < numFrames; ++i)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                int16_t value = static_cast<int16_t>(seed >> 16);
+                switch (storage)
+                {
+                case STORAGE_INT16:
+                    std::memcpy(bytes + i * 2, &value, 2);
+                    break;
+                case STORAGE_INT24:
+                    bytes[i * 3] = 0;
+                    std::memcpy(bytes + i * 3 + 1, &value, 2);
+                    break;
+                default:
+                    reinterpret_cast<float*>(bytes)[i] = value / 32768.0f;
+                    break;
+                }
+            }
+        }
+        buffer.Seal();
+
+        // Best of N - the first pass also warms caches and page tables
+        double bestPlayback = 1e30;
+        double bestPeakScan = 1e30;
+        float peak = 0.0f;
+        for (int iter = 0; iter < iterations; ++iter)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t block = 0; block < numBlocks; ++block)
+            {
+                buffer.ReadInterleaved(block * kDecodeBlockFrames, kDecodeBlockFrames, interleaved.data());
+            }
+            std::chrono::duration<double> playback = std::chrono::steady_clock::now() - start;
+            bestPlayback = std::min(bestPlayback, playback.count());
+
+            start = std::chrono::steady_clock::now();
+            for (uint16_t ch = 0; ch < channels; ++ch)
+            {
+                buffer.VisitChannel(ch, 0, numFrames, [&peak](const float* samples, size_t count)
+                {
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        peak = std::max(peak, std::abs(samples[i]));
+                    }
+                });
+            }
+            std::chrono::duration<double> peakScan = std::chrono::steady_clock::now() - start;
+            bestPeakScan = std::min(bestPeakScan, peakScan.count());
+        }
+
+        if (storage == STORAGE_FLOAT32)
+        {
+            floatBytes = buffer.GetSizeBytes();
+        }
+
+        StorageBenchmarkResult result;
+        result.storage = storage;
+        result.sizeBytes = buffer.GetSizeBytes();
+        result.memorySavedPercent = floatBytes ? 100.0 * (1.0 - static_cast<double>(result.sizeBytes) / floatBytes) : 0.0;
+        result.playbackNanosPerBlock = bestPlayback * 1e9 / numBlocks;
+        result.peakScanNanosPerBlock = bestPeakScan * 1e9 / numBlocks;
+        results.push_back(result);
+
+        // Keeps the scan from being optimized away
+        if (peak > 1.0f)
+        {
+            printf("Unexpected peak %f\n", peak);
+        }
+    }
+    return results;
+}
+
+void SampleBuffer::PrintStorageBenchmark(const std::vector<StorageBenchmarkResult>& results)
+{
+    printf("Sample storage benchmark (%u-frame blocks)\n", kDecodeBlockFrames);
+    printf("  %-8s %10s %8s %14s %14s\n", "Storage", "Size (MB)", "Saved", "Playback ns", "Peak scan ns");
+    for (const StorageBenchmarkResult& result : results)
+    {
+        printf("  %-8s %10.1f %7.1f%% %14.1f %14.1f\n", GetStorageName(result.storage),
+            result.sizeBytes / (1024.0 * 1024.0), result.memorySavedPercent,
+            result.playbackNanosPerBlock, result.peakScanNanosPerBlock);
+    }
+}
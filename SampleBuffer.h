@@ -0,0 +1,181 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class MappedFile;
+struct AudioAnalysis;
+
+// Read-only view of one channel's contiguous samples
+struct SampleSpan
+{
+    const float* data = nullptr;
+    size_t size = 0;
+
+    SampleSpan() {}
+    SampleSpan(const float* samples, size_t count) : data(samples), size(count) {}
+
+    const float* begin() const { return data; }
+    const float* end() const { return data + size; }
+    float operator[](size_t index) const { return data[index]; }
+    bool empty() const { return size == 0; }
+
+    SampleSpan SubSpan(size_t offset, size_t count) const
+    {
+        offset = offset < size ? offset : size;
+        return SampleSpan(data + offset, count < size - offset ? count : size - offset);
+    }
+};
+
+// Sample Buffer - planar samples, one 64-byte aligned array per channel.
+// Filled through GetWritableChannel() by whoever decodes it, then sealed and handed out
+// by SamplePool as shared_ptr<const SampleBuffer> so tracks, players and visualizers
+// share one copy.
+//
+// Storage is float by default. 16- and 24-bit sources can instead keep their native
+// integer samples (compact storage, half or three quarters of the memory); readers then
+// decode small cache-sized blocks to float on the fly through ReadChannel(),
+// VisitChannel() or ReadInterleaved().
+class SampleBuffer
+{
+public:
+    enum Storage
+    {
+        STORAGE_FLOAT32,  // Normalized float
+        STORAGE_INT16,    // Native 16-bit little-endian
+        STORAGE_INT24     // Packed 24-bit little-endian, 3 bytes per sample
+    };
+
+    static constexpr size_t kAlignment = 64;
+
+    // Frames decoded per block from compact storage - 1 KB of floats, stays in L1
+    static constexpr uint32_t kDecodeBlockFrames = 256;
+
+    SampleBuffer(uint32_t numFrames, uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample,
+                 Storage storage = STORAGE_FLOAT32);
+    ~SampleBuffer();
+
+    // Sealed buffer over samples that already sit in a mapped file in this class's layout
+    // (64-byte aligned channels, channelStride bytes apart). Nothing is copied or rehashed.
+    static std::unique_ptr<SampleBuffer> FromMapping(std::unique_ptr<MappedFile> mapping, uint64_t offset,
+                                                     size_t channelStride, uint32_t numFrames, uint32_t sampleRate,
+                                                     uint16_t channels, uint16_t bitsPerSample, Storage storage,
+                                                     uint64_t contentHash);
+
+    SampleBuffer(const SampleBuffer&) = delete;
+    SampleBuffer& operator=(const SampleBuffer&) = delete;
+
+    // Decode side - only valid before the buffer is sealed and shared.
+    // GetWritableChannel() is float storage only; GetWritableChannelBytes() takes any storage.
+    float* GetWritableChannel(uint16_t channel) { return reinterpret_cast<float*>(GetWritableChannelBytes(channel)); }
+    uint8_t* GetWritableChannelBytes(uint16_t channel) { return samples_ + channel * channelStride_; }
+    void Seal(); // No-op once sealed
+
+    // Derived analysis attached by the loader before the buffer is shared, nullptr if none
+    void SetAnalysis(std::shared_ptr<const AudioAnalysis> analysis) { analysis_ = std::move(analysis); }
+    const std::shared_ptr<const AudioAnalysis>& GetAnalysis() const { return analysis_; }
+
+    // Per-channel float access - each span starts on a 64-byte boundary.
+    // Empty (nullptr) for compact storage, which has no float copy to point at.
+    SampleSpan GetChannel(uint16_t channel) const
+    {
+        return SampleSpan(GetChannelData(channel), IsCompact() ? 0 : numFrames_);
+    }
+    const float* GetChannelData(uint16_t channel) const
+    {
+        return IsCompact() ? nullptr : reinterpret_cast<const float*>(samples_ + channel * channelStride_);
+    }
+
+    // Raw storage of one channel, in GetStorage() encoding
+    const uint8_t* GetChannelBytes(uint16_t channel) const { return samples_ + channel * channelStride_; }
+
+    // Float samples of one channel for any storage, returns frames copied
+    uint32_t ReadChannel(uint16_t channel, uint32_t startFrame, uint32_t numFrames, float* dest) const;
+    float GetSample(uint32_t frame, uint16_t channel) const;
+
+    // Call visitor(const float* samples, size_t count) over [startFrame, startFrame + numFrames) of
+    // one channel. Float storage is visited in place, compact storage a decoded block at a time.
+    template <typename Visitor>
+    void VisitChannel(uint16_t channel, uint32_t startFrame, uint32_t numFrames, Visitor&& visitor) const
+    {
+        if (startFrame >= numFrames_)
+        {
+            return;
+        }
+        numFrames = numFrames < numFrames_ - startFrame ? numFrames : numFrames_ - startFrame;
+        if (!IsCompact())
+        {
+            visitor(GetChannelData(channel) + startFrame, static_cast<size_t>(numFrames));
+            return;
+        }
+
+        float block[kDecodeBlockFrames];
+        for (uint32_t done = 0; done < numFrames; done += kDecodeBlockFrames)
+        {
+            uint32_t frames = ReadChannel(channel, startFrame + done,
+                numFrames - done < kDecodeBlockFrames ? numFrames - done : kDecodeBlockFrames, block);
+            visitor(static_cast<const float*>(block), static_cast<size_t>(frames));
+        }
+    }
+
+    // Interleave frames for a device or file, returns frames copied
+    uint32_t ReadInterleaved(uint32_t startFrame, uint32_t numFrames, float* dest) const;
+
+    uint32_t GetNumFrames() const { return numFrames_; }
+    size_t GetNumSamples() const { return static_cast<size_t>(numFrames_) * channels_; }
+    size_t GetSizeBytes() const { return channelStride_ * channels_; }
+    size_t GetChannelStride() const { return channelStride_; } // Bytes between channel starts
+    bool IsMapped() const { return mapping_ != nullptr; }       // Samples live in a cache file mapping
+
+    uint32_t GetSampleRate() const { return sampleRate_; }
+    uint16_t GetNumChannels() const { return channels_; }
+    uint16_t GetBitsPerSample() const { return bitsPerSample_; } // Of the source the samples were decoded from
+
+    Storage GetStorage() const { return storage_; }
+    bool IsCompact() const { return storage_ != STORAGE_FLOAT32; }
+    static size_t GetBytesPerSample(Storage storage);
+    static const char* GetStorageName(Storage storage);
+
+    // Hash of the samples and format, computed by Seal()
+    uint64_t GetContentHash() const { return contentHash_; }
+
+    // Same format, storage and bit-identical samples
+    bool HasSameContent(const SampleBuffer& other) const;
+
+    // Micro-benchmark: memory and float decode cost of each storage for the same audio
+    struct StorageBenchmarkResult
+    {
+        Storage storage;
+        size_t sizeBytes;
+        double memorySavedPercent;      // Against float storage
+        double playbackNanosPerBlock;   // ReadInterleaved of kDecodeBlockFrames frames
+        double peakScanNanosPerBlock;   // VisitChannel over kDecodeBlockFrames frames of every channel
+    };
+
+    static std::vector<StorageBenchmarkResult> RunStorageBenchmark(uint32_t numFrames = 1024 * 1024,
+                                                                   uint16_t channels = 2, int iterations = 5);
+    static void PrintStorageBenchmark(const std::vector<StorageBenchmarkResult>& results);
+
+private:
+    struct AlignedDelete
+    {
+        void operator()(uint8_t* samples) const { ::operator delete[](samples, std::align_val_t(kAlignment)); }
+    };
+
+    uint8_t* samples_;                                    // Into ownedSamples_ or mapping_
+    std::unique_ptr<uint8_t[], AlignedDelete> ownedSamples_;
+    std::unique_ptr<MappedFile> mapping_;
+    std::shared_ptr<const AudioAnalysis> analysis_;
+    size_t channelStride_; // Bytes, rounded up to a whole number of 64-byte lines
+    uint32_t numFrames_;
+    uint32_t sampleRate_;
+    uint16_t channels_;
+    uint16_t bitsPerSample_;
+    Storage storage_;
+    uint64_t contentHash_;
+    bool sealed_;
+
+    SampleBuffer(); // For FromMapping
+};
@@ -0,0 +1,928 @@
+#include "SampleConvert.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SAMPLECONVERT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC exposes every intrinsic regardless of /arch
+#define TARGET_SSE2
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#include <cpuid.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+#endif
+
+namespace SampleConvert
+{
+    namespace
+    {
+        const float kScaleU8 = 1.0f / 128.0f;
+        const float kScaleS16 = 1.0f / 32768.0f;
+        const float kScaleS24 = 1.0f / 8388608.0f;
+        const float kScaleS32 = 1.0f / 2147483648.0f;
+
+        // ---------------------------------------------------------------
+        // Scalar kernels - also used for the tails of the vector kernels
+        // ---------------------------------------------------------------
+
+        void ScalarU8(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                dest[i] = (static_cast<int32_t>(src[i]) - 128) * kScaleU8;
+            }
+        }
+
+        void ScalarS16(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                int16_t value;
+                std::memcpy(&value, src + i * 2, sizeof(value));
+                dest[i] = value * kScaleS16;
+            }
+        }
+
+        void ScalarS24(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                // Place the 3 bytes at the top of a 32-bit word, arithmetic shift sign-extends
+                const uint8_t* p = src + i * 3;
+                uint32_t packed = (static_cast<uint32_t>(p[2]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                    (static_cast<uint32_t>(p[0]) << 8);
+                dest[i] = (static_cast<int32_t>(packed) >> 8) * kScaleS24;
+            }
+        }
+
+        void ScalarS32(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                int32_t value;
+                std::memcpy(&value, src + i * 4, sizeof(value));
+                dest[i] = static_cast<float>(value) * kScaleS32;
+            }
+        }
+
+        void CopyFloat32(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            std::memcpy(dest, src, numSamples * sizeof(float));
+        }
+
+        void ScalarFloat32BE(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                const uint8_t* p = src + i * 4;
+                uint32_t bits = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                    (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+                std::memcpy(&dest[i], &bits, sizeof(bits));
+            }
+        }
+
+        void ScalarFloat64(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                double value;
+                std::memcpy(&value, src + i * 8, sizeof(value));
+                dest[i] = static_cast<float>(value);
+            }
+        }
+
+        // ---------------------------------------------------------------
+        // Layout kernels - interleaved frames <-> per-channel arrays
+        // ---------------------------------------------------------------
+
+        void ScalarDeinterleave(const float* src, float* const* dest, uint16_t channels, size_t numFrames)
+        {
+            for (uint16_t ch = 0; ch < channels; ++ch)
+            {
+                float* out = dest[ch];
+                for (size_t i = 0; i < numFrames; ++i)
+                {
+                    out[i] = src[i * channels + ch];
+                }
+            }
+        }
+
+        void ScalarInterleave(const float* const* src, float* dest, uint16_t channels, size_t numFrames)
+        {
+            for (uint16_t ch = 0; ch < channels; ++ch)
+            {
+                const float* in = src[ch];
+                for (size_t i = 0; i < numFrames; ++i)
+                {
+                    dest[i * channels + ch] = in[i];
+                }
+            }
+        }
+
+        // ---------------------------------------------------------------
+        // Peak kernels - running min, max and sum of squares for waveforms
+        // ---------------------------------------------------------------
+
+        void ScalarReducePeaks(const float* src, size_t numSamples, float* minValue, float* maxValue, float* sumSquares)
+        {
+            float minResult = *minValue;
+            float maxResult = *maxValue;
+            float sum = 0.0f;
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                minResult = std::min(minResult, src[i]);
+                maxResult = std::max(maxResult, src[i]);
+                sum += src[i] * src[i];
+            }
+            *minValue = minResult;
+            *maxValue = maxResult;
+            if (sumSquares)
+            {
+                *sumSquares += sum;
+            }
+        }
+
+        // Fold vector lanes into the running values, then finish the tail in scalar
+        void FinishReducePeaks(const float* lanes, size_t numLanes, const float* tail, size_t tailSamples,
+                               float* minValue, float* maxValue, float* sumSquares)
+        {
+            float sum = 0.0f;
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                *minValue = std::min(*minValue, lanes[lane]);
+                *maxValue = std::max(*maxValue, lanes[numLanes + lane]);
+                sum += lanes[numLanes * 2 + lane];
+            }
+            if (sumSquares)
+            {
+                *sumSquares += sum;
+            }
+            ScalarReducePeaks(tail, tailSamples, minValue, maxValue, sumSquares);
+        }
+
+#ifdef SAMPLECONVERT_X86
+        // ---------------------------------------------------------------
+        // SSE2 kernels
+        // ---------------------------------------------------------------
+
+        TARGET_SSE2 void Sse2U8(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bias = _mm_set1_epi32(128);
+            const __m128 scale = _mm_set1_ps(kScaleU8);
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i lo16 = _mm_unpacklo_epi8(bytes, zero);
+                __m128i hi16 = _mm_unpackhi_epi8(bytes, zero);
+                __m128i words[4] = {
+                    _mm_unpacklo_epi16(lo16, zero), _mm_unpackhi_epi16(lo16, zero),
+                    _mm_unpacklo_epi16(hi16, zero), _mm_unpackhi_epi16(hi16, zero) };
+                for (int k = 0; k < 4; ++k)
+                {
+                    __m128 value = _mm_cvtepi32_ps(_mm_sub_epi32(words[k], bias));
+                    _mm_storeu_ps(dest + i + k * 4, _mm_mul_ps(value, scale));
+                }
+            }
+            ScalarU8(src + i, dest + i, numSamples - i);
+        }
+
+        TARGET_SSE2 void Sse2S16(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m128 scale = _mm_set1_ps(kScaleS16);
+            size_t i = 0;
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+                // Unpack into the high half, arithmetic shift sign-extends
+                __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+                __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+                _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+                _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+            }
+            ScalarS16(src + i * 2, dest + i, numSamples - i);
+        }
+
+        TARGET_SSE2 void Sse2S24(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m128 scale = _mm_set1_ps(kScaleS24);
+            size_t i = 0;
+            // Each 4-byte load reads one byte past its sample - stay one sample clear of the end
+            for (; i + 5 <= numSamples; i += 4)
+            {
+                const uint8_t* p = src + i * 3;
+                int32_t w0, w1, w2, w3;
+                std::memcpy(&w0, p, 4);
+                std::memcpy(&w1, p + 3, 4);
+                std::memcpy(&w2, p + 6, 4);
+                std::memcpy(&w3, p + 9, 4);
+                __m128i packed = _mm_set_epi32(w3, w2, w1, w0);
+                __m128i value = _mm_srai_epi32(_mm_slli_epi32(packed, 8), 8);
+                _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(value), scale));
+            }
+            ScalarS24(src + i * 3, dest + i, numSamples - i);
+        }
+
+        TARGET_SSE2 void Sse2S32(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m128 scale = _mm_set1_ps(kScaleS32);
+            size_t i = 0;
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+                _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+                _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+            }
+            ScalarS32(src + i * 4, dest + i, numSamples - i);
+        }
+
+        TARGET_SSE2 void Sse2Float32BE(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            size_t i = 0;
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+                // Swap 16-bit halves, then the bytes within each half
+                x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+                x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+                x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), x);
+            }
+            ScalarFloat32BE(src + i * 4, dest + i, numSamples - i);
+        }
+
+        TARGET_SSE2 void Sse2Float64(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            size_t i = 0;
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<const double*>(src + i * 8)));
+                __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<const double*>(src + i * 8 + 16)));
+                _mm_storeu_ps(dest + i, _mm_movelh_ps(lo, hi));
+            }
+            ScalarFloat64(src + i * 8, dest + i, numSamples - i);
+        }
+
+        // Stereo is by far the most common layout, so it gets shuffles instead of strided loops
+        TARGET_SSE2 void Sse2DeinterleaveStereo(const float* src, float* left, float* right, size_t numFrames)
+        {
+            size_t i = 0;
+            for (; i + 4 <= numFrames; i += 4)
+            {
+                __m128 a = _mm_loadu_ps(src + i * 2);     // L0 R0 L1 R1
+                __m128 b = _mm_loadu_ps(src + i * 2 + 4); // L2 R2 L3 R3
+                _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+            }
+            for (; i < numFrames; ++i)
+            {
+                left[i] = src[i * 2];
+                right[i] = src[i * 2 + 1];
+            }
+        }
+
+        TARGET_SSE2 void Sse2InterleaveStereo(const float* left, const float* right, float* dest, size_t numFrames)
+        {
+            size_t i = 0;
+            for (; i + 4 <= numFrames; i += 4)
+            {
+                __m128 l = _mm_loadu_ps(left + i);
+                __m128 r = _mm_loadu_ps(right + i);
+                _mm_storeu_ps(dest + i * 2, _mm_unpacklo_ps(l, r));
+                _mm_storeu_ps(dest + i * 2 + 4, _mm_unpackhi_ps(l, r));
+            }
+            for (; i < numFrames; ++i)
+            {
+                dest[i * 2] = left[i];
+                dest[i * 2 + 1] = right[i];
+            }
+        }
+
+        // Two accumulators per value keep the dependent min/max/add chains from stalling
+        TARGET_SSE2 void Sse2ReducePeaks(const float* src, size_t numSamples, float* minValue, float* maxValue,
+                                         float* sumSquares)
+        {
+            __m128 min0 = _mm_set1_ps(*minValue);
+            __m128 max0 = _mm_set1_ps(*maxValue);
+            __m128 sum0 = _mm_setzero_ps();
+            __m128 min1 = min0;
+            __m128 max1 = max0;
+            __m128 sum1 = sum0;
+            size_t i = 0;
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                __m128 a = _mm_loadu_ps(src + i);
+                __m128 b = _mm_loadu_ps(src + i + 4);
+                min0 = _mm_min_ps(min0, a);
+                min1 = _mm_min_ps(min1, b);
+                max0 = _mm_max_ps(max0, a);
+                max1 = _mm_max_ps(max1, b);
+                sum0 = _mm_add_ps(sum0, _mm_mul_ps(a, a));
+                sum1 = _mm_add_ps(sum1, _mm_mul_ps(b, b));
+            }
+            float lanes[12];
+            _mm_storeu_ps(lanes, _mm_min_ps(min0, min1));
+            _mm_storeu_ps(lanes + 4, _mm_max_ps(max0, max1));
+            _mm_storeu_ps(lanes + 8, _mm_add_ps(sum0, sum1));
+            FinishReducePeaks(lanes, 4, src + i, numSamples - i, minValue, maxValue, sumSquares);
+        }
+
+        // ---------------------------------------------------------------
+        // AVX2 kernels
+        // ---------------------------------------------------------------
+
+        TARGET_AVX2 void Avx2U8(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m256i bias = _mm256_set1_epi32(128);
+            const __m256 scale = _mm256_set1_ps(kScaleU8);
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+                __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i + 8)));
+                _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(a, bias)), scale));
+                _mm256_storeu_ps(dest + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(b, bias)), scale));
+            }
+            ScalarU8(src + i, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX2 void Avx2S16(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m256 scale = _mm256_set1_ps(kScaleS16);
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m256i a = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2)));
+                __m256i b = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 16)));
+                _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(a), scale));
+                _mm256_storeu_ps(dest + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), scale));
+            }
+            ScalarS16(src + i * 2, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX2 void Avx2S24(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            // Per 128-bit lane: 4 packed samples -> bytes 1..3 of each int32, byte 0 zeroed
+            const __m256i shuffle = _mm256_setr_epi8(
+                -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            const __m256 scale = _mm256_set1_ps(kScaleS24);
+            size_t i = 0;
+            // The upper lane load reads 4 bytes past the 8 samples - keep 2 samples of slack
+            for (; i + 10 <= numSamples; i += 8)
+            {
+                const uint8_t* p = src + i * 3;
+                __m256i bytes = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+                __m256i value = _mm256_srai_epi32(_mm256_shuffle_epi8(bytes, shuffle), 8);
+                _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(value), scale));
+            }
+            ScalarS24(src + i * 3, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX2 void Avx2S32(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m256 scale = _mm256_set1_ps(kScaleS32);
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4 + 32));
+                _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(a), scale));
+                _mm256_storeu_ps(dest + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), scale));
+            }
+            ScalarS32(src + i * 4, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX2 void Avx2Float32BE(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m256i swap = _mm256_setr_epi8(
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+            size_t i = 0;
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_shuffle_epi8(x, swap));
+            }
+            ScalarFloat32BE(src + i * 4, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX2 void Avx2Float64(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            size_t i = 0;
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(reinterpret_cast<const double*>(src + i * 8)));
+                __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(reinterpret_cast<const double*>(src + i * 8 + 32)));
+                _mm256_storeu_ps(dest + i, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+            }
+            ScalarFloat64(src + i * 8, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX2 void Avx2ReducePeaks(const float* src, size_t numSamples, float* minValue, float* maxValue,
+                                         float* sumSquares)
+        {
+            __m256 min0 = _mm256_set1_ps(*minValue);
+            __m256 max0 = _mm256_set1_ps(*maxValue);
+            __m256 sum0 = _mm256_setzero_ps();
+            __m256 min1 = min0;
+            __m256 max1 = max0;
+            __m256 sum1 = sum0;
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m256 a = _mm256_loadu_ps(src + i);
+                __m256 b = _mm256_loadu_ps(src + i + 8);
+                min0 = _mm256_min_ps(min0, a);
+                min1 = _mm256_min_ps(min1, b);
+                max0 = _mm256_max_ps(max0, a);
+                max1 = _mm256_max_ps(max1, b);
+                sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(a, a));
+                sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(b, b));
+            }
+            float lanes[24];
+            _mm256_storeu_ps(lanes, _mm256_min_ps(min0, min1));
+            _mm256_storeu_ps(lanes + 8, _mm256_max_ps(max0, max1));
+            _mm256_storeu_ps(lanes + 16, _mm256_add_ps(sum0, sum1));
+            FinishReducePeaks(lanes, 8, src + i, numSamples - i, minValue, maxValue, sumSquares);
+        }
+
+        // ---------------------------------------------------------------
+        // AVX-512 (F + BW) kernels
+        // ---------------------------------------------------------------
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC's _mm512_undefined_* helpers trip -Wuninitialized inside target("avx512f") functions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+        TARGET_AVX512 void Avx512U8(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m512i bias = _mm512_set1_epi32(128);
+            const __m512 scale = _mm512_set1_ps(kScaleU8);
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m512i value = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+                _mm512_storeu_ps(dest + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_sub_epi32(value, bias)), scale));
+            }
+            ScalarU8(src + i, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX512 void Avx512S16(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m512 scale = _mm512_set1_ps(kScaleS16);
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m512i value = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2)));
+                _mm512_storeu_ps(dest + i, _mm512_mul_ps(_mm512_cvtepi32_ps(value), scale));
+            }
+            ScalarS16(src + i * 2, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX512 void Avx512S24(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m512i shuffle = _mm512_broadcast_i32x4(_mm_setr_epi8(
+                -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+            const __m512 scale = _mm512_set1_ps(kScaleS24);
+            size_t i = 0;
+            // The top lane load reads 4 bytes past the 16 samples - keep 2 samples of slack
+            for (; i + 18 <= numSamples; i += 16)
+            {
+                const uint8_t* p = src + i * 3;
+                __m512i bytes = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+                bytes = _mm512_inserti32x4(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+                bytes = _mm512_inserti32x4(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 24)), 2);
+                bytes = _mm512_inserti32x4(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 36)), 3);
+                __m512i value = _mm512_srai_epi32(_mm512_shuffle_epi8(bytes, shuffle), 8);
+                _mm512_storeu_ps(dest + i, _mm512_mul_ps(_mm512_cvtepi32_ps(value), scale));
+            }
+            ScalarS24(src + i * 3, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX512 void Avx512S32(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m512 scale = _mm512_set1_ps(kScaleS32);
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m512i value = _mm512_loadu_si512(src + i * 4);
+                _mm512_storeu_ps(dest + i, _mm512_mul_ps(_mm512_cvtepi32_ps(value), scale));
+            }
+            ScalarS32(src + i * 4, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX512 void Avx512Float32BE(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            const __m512i swap = _mm512_broadcast_i32x4(_mm_setr_epi8(
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m512i x = _mm512_loadu_si512(src + i * 4);
+                _mm512_storeu_si512(dest + i, _mm512_shuffle_epi8(x, swap));
+            }
+            ScalarFloat32BE(src + i * 4, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX512 void Avx512Float64(const uint8_t* src, float* dest, size_t numSamples)
+        {
+            size_t i = 0;
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                __m256 lo = _mm512_cvtpd_ps(_mm512_loadu_pd(src + i * 8));
+                __m256 hi = _mm512_cvtpd_ps(_mm512_loadu_pd(src + i * 8 + 64));
+                _mm256_storeu_ps(dest + i, lo);
+                _mm256_storeu_ps(dest + i + 8, hi);
+            }
+            ScalarFloat64(src + i * 8, dest + i, numSamples - i);
+        }
+
+        TARGET_AVX512 void Avx512ReducePeaks(const float* src, size_t numSamples, float* minValue, float* maxValue,
+                                             float* sumSquares)
+        {
+            __m512 min0 = _mm512_set1_ps(*minValue);
+            __m512 max0 = _mm512_set1_ps(*maxValue);
+            __m512 sum0 = _mm512_setzero_ps();
+            __m512 min1 = min0;
+            __m512 max1 = max0;
+            __m512 sum1 = sum0;
+            size_t i = 0;
+            for (; i + 32 <= numSamples; i += 32)
+            {
+                __m512 a = _mm512_loadu_ps(src + i);
+                __m512 b = _mm512_loadu_ps(src + i + 16);
+                min0 = _mm512_min_ps(min0, a);
+                min1 = _mm512_min_ps(min1, b);
+                max0 = _mm512_max_ps(max0, a);
+                max1 = _mm512_max_ps(max1, b);
+                sum0 = _mm512_add_ps(sum0, _mm512_mul_ps(a, a));
+                sum1 = _mm512_add_ps(sum1, _mm512_mul_ps(b, b));
+            }
+            float lanes[48];
+            _mm512_storeu_ps(lanes, _mm512_min_ps(min0, min1));
+            _mm512_storeu_ps(lanes + 16, _mm512_max_ps(max0, max1));
+            _mm512_storeu_ps(lanes + 32, _mm512_add_ps(sum0, sum1));
+            FinishReducePeaks(lanes, 16, src + i, numSamples - i, minValue, maxValue, sumSquares);
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+        // ---------------------------------------------------------------
+        // CPU feature detection
+        // ---------------------------------------------------------------
+
+        void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int i = 0; i < 4; ++i)
+            {
+                regs[i] = static_cast<uint32_t>(info[i]);
+            }
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        uint64_t ReadXcr0()
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            return _xgetbv(0);
+#else
+            uint32_t eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+        }
+
+        InstructionSet DetectInstructionSet()
+        {
+            uint32_t regs[4];
+            Cpuid(0, 0, regs);
+            const uint32_t maxLeaf = regs[0];
+
+            Cpuid(1, 0, regs);
+            const bool sse2 = (regs[3] & (1u << 26)) != 0;
+            const bool osxsave = (regs[2] & (1u << 27)) != 0;
+            const bool avx = (regs[2] & (1u << 28)) != 0;
+            if (!sse2)
+            {
+                return ISA_SCALAR;
+            }
+            if (!osxsave || !avx || maxLeaf < 7)
+            {
+                return ISA_SSE2;
+            }
+
+            // The OS must save YMM (and for AVX-512, opmask/ZMM) state across context switches
+            const uint64_t xcr0 = ReadXcr0();
+            Cpuid(7, 0, regs);
+            const bool avx2 = (regs[1] & (1u << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+            const bool avx512 = (regs[1] & (1u << 16)) != 0 && (regs[1] & (1u << 30)) != 0 && (xcr0 & 0xE6) == 0xE6;
+
+            if (avx2 && avx512)
+            {
+                return ISA_AVX512;
+            }
+            return avx2 ? ISA_AVX2 : ISA_SSE2;
+        }
+#else
+        InstructionSet DetectInstructionSet()
+        {
+            return ISA_SCALAR;
+        }
+#endif
+
+        ConvertFunc LookupKernel(Format format, InstructionSet isa)
+        {
+            static const ConvertFunc scalar[FORMAT_COUNT] = {
+                ScalarU8, ScalarS16, ScalarS24, ScalarS32, CopyFloat32, ScalarFloat32BE, ScalarFloat64 };
+#ifdef SAMPLECONVERT_X86
+            static const ConvertFunc sse2[FORMAT_COUNT] = {
+                Sse2U8, Sse2S16, Sse2S24, Sse2S32, CopyFloat32, Sse2Float32BE, Sse2Float64 };
+            static const ConvertFunc avx2[FORMAT_COUNT] = {
+                Avx2U8, Avx2S16, Avx2S24, Avx2S32, CopyFloat32, Avx2Float32BE, Avx2Float64 };
+            static const ConvertFunc avx512[FORMAT_COUNT] = {
+                Avx512U8, Avx512S16, Avx512S24, Avx512S32, CopyFloat32, Avx512Float32BE, Avx512Float64 };
+
+            switch (isa)
+            {
+            case ISA_SSE2: return sse2[format];
+            case ISA_AVX2: return avx2[format];
+            case ISA_AVX512: return avx512[format];
+            default: break;
+            }
+#endif
+            return isa == ISA_SCALAR ? scalar[format] : nullptr;
+        }
+
+        PeakFunc LookupPeakKernel(InstructionSet isa)
+        {
+#ifdef SAMPLECONVERT_X86
+            switch (isa)
+            {
+            case ISA_SSE2: return Sse2ReducePeaks;
+            case ISA_AVX2: return Avx2ReducePeaks;
+            case ISA_AVX512: return Avx512ReducePeaks;
+            default: break;
+            }
+#endif
+            return isa == ISA_SCALAR ? ScalarReducePeaks : nullptr;
+        }
+
+        struct DispatchTable
+        {
+            InstructionSet isa;
+            ConvertFunc kernels[FORMAT_COUNT];
+            PeakFunc peaks;
+
+            DispatchTable() : isa(DetectInstructionSet())
+            {
+                for (int f = 0; f < FORMAT_COUNT; ++f)
+                {
+                    kernels[f] = LookupKernel(static_cast<Format>(f), isa);
+                }
+                peaks = LookupPeakKernel(isa);
+            }
+        };
+
+        const DispatchTable& GetDispatchTable()
+        {
+            static const DispatchTable table;
+            return table;
+        }
+    }
+
+    void ToFloat(Format format, const uint8_t* src, float* dest, size_t numSamples)
+    {
+        if (format >= 0 && format < FORMAT_COUNT && numSamples > 0)
+        {
+            GetDispatchTable().kernels[format](src, dest, numSamples);
+        }
+    }
+
+    void ReducePeaks(const float* src, size_t numSamples, float* minValue, float* maxValue, float* sumSquares)
+    {
+        if (numSamples > 0)
+        {
+            GetDispatchTable().peaks(src, numSamples, minValue, maxValue, sumSquares);
+        }
+    }
+
+    void Deinterleave(const float* src, float* const* dest, uint16_t channels, size_t numFrames)
+    {
+#ifdef SAMPLECONVERT_X86
+        if (channels == 2 && GetDispatchTable().isa >= ISA_SSE2)
+        {
+            Sse2DeinterleaveStereo(src, dest[0], dest[1], numFrames);
+            return;
+        }
+#endif
+        ScalarDeinterleave(src, dest, channels, numFrames);
+    }
+
+    void Interleave(const float* const* src, float* dest, uint16_t channels, size_t numFrames)
+    {
+#ifdef SAMPLECONVERT_X86
+        if (channels == 2 && GetDispatchTable().isa >= ISA_SSE2)
+        {
+            Sse2InterleaveStereo(src[0], src[1], dest, numFrames);
+            return;
+        }
+#endif
+        ScalarInterleave(src, dest, channels, numFrames);
+    }
+
+    void DeinterleavePacked(const uint8_t* src, uint8_t* const* dest, uint16_t channels, size_t bytesPerSample,
+                            size_t numFrames)
+    {
+        const size_t frameBytes = bytesPerSample * channels;
+        for (uint16_t ch = 0; ch < channels; ++ch)
+        {
+            const uint8_t* in = src + ch * bytesPerSample;
+            uint8_t* out = dest[ch];
+
+            // Fixed sizes let the compiler turn each copy into a single load and store
+            switch (bytesPerSample)
+            {
+            case 2:
+                for (size_t i = 0; i < numFrames; ++i)
+                {
+                    std::memcpy(out + i * 2, in + i * frameBytes, 2);
+                }
+                break;
+            case 3:
+                for (size_t i = 0; i < numFrames; ++i)
+                {
+                    std::memcpy(out + i * 3, in + i * frameBytes, 3);
+                }
+                break;
+            default:
+                for (size_t i = 0; i < numFrames; ++i)
+                {
+                    std::memcpy(out + i * bytesPerSample, in + i * frameBytes, bytesPerSample);
+                }
+                break;
+            }
+        }
+    }
+
+    void ToFloatPlanar(Format format, const uint8_t* src, float* const* dest, uint16_t channels, size_t numFrames)
+    {
+        if (channels == 0 || numFrames == 0)
+        {
+            return;
+        }
+        if (channels == 1)
+        {
+            ToFloat(format, src, dest[0], numFrames);
+            return;
+        }
+
+        // Convert a cache-resident block at a time, then split it into the channel arrays
+        const size_t srcFrameBytes = GetBytesPerSample(format) * channels;
+        const size_t blockFrames = std::max<size_t>(1, kPlanarBlockSamples / channels);
+        std::vector<float> scratch(blockFrames * channels);
+        std::vector<float*> channelDest(dest, dest + channels);
+
+        for (size_t first = 0; first < numFrames; first += blockFrames)
+        {
+            size_t frames = std::min(blockFrames, numFrames - first);
+            ToFloat(format, src + first * srcFrameBytes, scratch.data(), frames * channels);
+            Deinterleave(scratch.data(), channelDest.data(), channels, frames);
+            for (uint16_t ch = 0; ch < channels; ++ch)
+            {
+                channelDest[ch] += frames;
+            }
+        }
+    }
+
+    size_t GetBytesPerSample(Format format)
+    {
+        switch (format)
+        {
+        case PCM_U8: return 1;
+        case PCM_S16: return 2;
+        case PCM_S24: return 3;
+        case PCM_S32:
+        case FLOAT32:
+        case FLOAT32_BE: return 4;
+        case FLOAT64: return 8;
+        default: return 0;
+        }
+    }
+
+    const char* GetFormatName(Format format)
+    {
+        static const char* names[FORMAT_COUNT] = {
+            "PCM u8", "PCM s16", "PCM s24", "PCM s32", "Float32", "Float32 BE", "Float64" };
+        return format >= 0 && format < FORMAT_COUNT ? names[format] : "Unknown";
+    }
+
+    const char* GetInstructionSetName(InstructionSet isa)
+    {
+        static const char* names[ISA_COUNT] = { "Scalar", "SSE2", "AVX2", "AVX-512" };
+        return isa >= 0 && isa < ISA_COUNT ? names[isa] : "Unknown";
+    }
+
+    bool IsSupported(InstructionSet isa)
+    {
+        return isa <= GetDispatchTable().isa;
+    }
+
+    InstructionSet GetActiveInstructionSet()
+    {
+        return GetDispatchTable().isa;
+    }
+
+    ConvertFunc GetKernel(Format format, InstructionSet isa)
+    {
+        if (format < 0 || format >= FORMAT_COUNT || !IsSupported(isa))
+        {
+            return nullptr;
+        }
+        return LookupKernel(format, isa);
+    }
+
+    PeakFunc GetPeakKernel(InstructionSet isa)
+    {
+        return IsSupported(isa) ? LookupPeakKernel(isa) : nullptr;
+    }
+
+    std::vector<BenchmarkResult> RunBenchmark(size_t numSamples, int iterations)
+    {
+        std::vector<BenchmarkResult> results;
+        std::vector<uint8_t> source(numSamples * 8);
+        std::vector<float> dest(numSamples);
+
+        // Deterministic noise so every kernel sees the same data
+        uint32_t seed = 0x12345678u;
+        for (uint8_t& byte : source)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            byte = static_cast<uint8_t>(seed >> 24);
+        }
+
+        for (int f = 0; f < FORMAT_COUNT; ++f)
+        {
+            Format format = static_cast<Format>(f);
+            for (int i = 0; i < ISA_COUNT; ++i)
+            {
+                InstructionSet isa = static_cast<InstructionSet>(i);
+                ConvertFunc kernel = GetKernel(format, isa);
+                if (!kernel)
+                {
+                    continue;
+                }
+
+                // Best of N - the first pass also warms caches and page tables
+                double bestSeconds = 1e30;
+                for (int iter = 0; iter < iterations; ++iter)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    kernel(source.data(), dest.data(), numSamples);
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    bestSeconds = std::min(bestSeconds, elapsed.count());
+                }
+
+                BenchmarkResult result;
+                result.format = format;
+                result.isa = isa;
+                result.gigabytesPerSecond = bestSeconds > 0.0 ?
+                    (numSamples * GetBytesPerSample(format)) / bestSeconds / 1e9 : 0.0;
+                results.push_back(result);
+            }
+        }
+        return results;
+    }
+
+    void PrintBenchmark(const std::vector<BenchmarkResult>& results)
+    {
+        printf("Sample conversion benchmark (active: %s)\n", GetInstructionSetName(GetActiveInstructionSet()));
+        for (const BenchmarkResult& result : results)
+        {
+            printf("  %-10s %-8s %8.2f GB/s\n", GetFormatName(result.format),
+                GetInstructionSetName(result.isa), result.gigabytesPerSecond);
+        }
+    }
+}
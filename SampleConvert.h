@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Sample format conversion kernels - packed file PCM to normalized float [-1.0, 1.0],
+// plus the min/max reduction behind waveform peaks.
+// Each has scalar, SSE2, AVX2 and AVX-512 kernels; the widest one the CPU
+// supports is picked at runtime the first time a kernel runs.
+namespace SampleConvert
+{
+    // Packed source encodings
+    enum Format
+    {
+        PCM_U8,       // 8-bit unsigned, 128 = center
+        PCM_S16,      // 16-bit signed little-endian
+        PCM_S24,      // 24-bit signed little-endian, 3 bytes per sample
+        PCM_S32,      // 32-bit signed little-endian
+        FLOAT32,      // IEEE float little-endian
+        FLOAT32_BE,   // IEEE float big-endian
+        FLOAT64,      // IEEE double little-endian
+        FORMAT_COUNT
+    };
+
+    enum InstructionSet
+    {
+        ISA_SCALAR,
+        ISA_SSE2,
+        ISA_AVX2,
+        ISA_AVX512,
+        ISA_COUNT
+    };
+
+    typedef void (*ConvertFunc)(const uint8_t* src, float* dest, size_t numSamples);
+    typedef void (*PeakFunc)(const float* src, size_t numSamples, float* minValue, float* maxValue, float* sumSquares);
+
+    // Convert numSamples packed samples with the dispatched kernel
+    void ToFloat(Format format, const uint8_t* src, float* dest, size_t numSamples);
+
+    // Convert numFrames interleaved packed frames into one float array per channel
+    void ToFloatPlanar(Format format, const uint8_t* src, float* const* dest, uint16_t channels, size_t numFrames);
+
+    // Waveform peak reduction - extend the running minValue, maxValue and sumSquares (may be nullptr)
+    // over numSamples contiguous floats of one planar channel
+    void ReducePeaks(const float* src, size_t numSamples, float* minValue, float* maxValue, float* sumSquares);
+
+    // Float layout changes - planar storage is interleaved only at device and file boundaries
+    void Deinterleave(const float* src, float* const* dest, uint16_t channels, size_t numFrames);
+    void Interleave(const float* const* src, float* dest, uint16_t channels, size_t numFrames);
+
+    // Split interleaved packed frames into one packed array per channel, samples unchanged
+    void DeinterleavePacked(const uint8_t* src, uint8_t* const* dest, uint16_t channels, size_t bytesPerSample,
+                            size_t numFrames);
+
+    // Interleaved scratch size used by ToFloatPlanar - small enough to stay in L1
+    const size_t kPlanarBlockSamples = 4096;
+
+    size_t GetBytesPerSample(Format format);
+    const char* GetFormatName(Format format);
+    const char* GetInstructionSetName(InstructionSet isa);
+
+    // Runtime CPU dispatch
+    bool IsSupported(InstructionSet isa);
+    InstructionSet GetActiveInstructionSet();
+    ConvertFunc GetKernel(Format format, InstructionSet isa); // nullptr if the CPU lacks the ISA
+    PeakFunc GetPeakKernel(InstructionSet isa);                // nullptr if the CPU lacks the ISA
+
+    // Micro-benchmark: source throughput of every supported kernel
+    struct BenchmarkResult
+    {
+        Format format;
+        InstructionSet isa;
+        double gigabytesPerSecond; // Packed source bytes consumed per second
+    };
+
+    std::vector<BenchmarkResult> RunBenchmark(size_t numSamples = 4 * 1024 * 1024, int iterations = 5);
+    void PrintBenchmark(const std::vector<BenchmarkResult>& results);
+}
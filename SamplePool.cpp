@@ -0,0 +1,181 @@
+#include "SamplePool.h"
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+// Inserts between sweeps of expired entries
+static const size_t kPruneInterval = 64;
+
+SamplePool& SamplePool::GetShared()
+{
+    static SamplePool pool;
+    return pool;
+}
+
+std::shared_ptr<const SampleBuffer> SamplePool::FindFile(const std::string& filePath, bool allowCompact)
+{
+    uint64_t fileSize;
+    int64_t modifiedTime;
+    if (!GetFileIdentity(filePath, fileSize, modifiedTime))
+    {
+        return nullptr;
+    }
+
+    // Compact first so a compact load shares the smaller buffer when both are live
+    static const SampleBuffer::Storage kSearchOrder[] =
+    {
+        SampleBuffer::STORAGE_INT16, SampleBuffer::STORAGE_INT24, SampleBuffer::STORAGE_FLOAT32
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (SampleBuffer::Storage storage : kSearchOrder)
+    {
+        auto it = files_[storage].find(filePath);
+        if (it == files_[storage].end() || it->second.fileSize != fileSize || it->second.modifiedTime != modifiedTime)
+        {
+            continue;
+        }
+
+        std::shared_ptr<const SampleBuffer> buffer = it->second.buffer.lock();
+        if (buffer && IsStorageAllowed(storage, buffer->GetBitsPerSample(), allowCompact))
+        {
+            ++fileHits_;
+            bytesShared_ += buffer->GetSizeBytes();
+            return buffer;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const SampleBuffer> SamplePool::Intern(std::unique_ptr<SampleBuffer> buffer,
+                                                       const std::string& filePath)
+{
+    // Hash outside the lock
+    buffer->Seal();
+    std::shared_ptr<const SampleBuffer> candidate(std::move(buffer));
+
+    uint64_t fileSize = 0;
+    int64_t modifiedTime = 0;
+    bool haveFile = !filePath.empty() && GetFileIdentity(filePath, fileSize, modifiedTime);
+
+    // Comparing a duplicate reads every sample of both buffers, possibly paging in a mapped
+    // cache entry, so only the candidate list is taken under the lock. Buffers with the same
+    // hash that another loader interns meanwhile are compared on the next pass.
+    const uint64_t hash = candidate->GetContentHash();
+    std::vector<std::shared_ptr<const SampleBuffer>> compared; // Held so addresses are not reused meanwhile
+    std::shared_ptr<const SampleBuffer> result;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        std::vector<std::shared_ptr<const SampleBuffer>> existing;
+        auto range = contents_.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            std::shared_ptr<const SampleBuffer> buffer = it->second.lock();
+            if (buffer && std::find(compared.begin(), compared.end(), buffer) == compared.end())
+            {
+                existing.push_back(std::move(buffer));
+            }
+        }
+        if (existing.empty())
+        {
+            result = candidate;
+            contents_.emplace(hash, result);
+            break;
+        }
+
+        lock.unlock();
+        for (const std::shared_ptr<const SampleBuffer>& buffer : existing)
+        {
+            compared.push_back(buffer);
+            if (buffer->HasSameContent(*candidate))
+            {
+                result = buffer;
+                break;
+            }
+        }
+        lock.lock();
+
+        if (result)
+        {
+            ++contentHits_;
+            bytesShared_ += result->GetSizeBytes();
+            break;
+        }
+    }
+
+    if (haveFile)
+    {
+        files_[result->GetStorage()][filePath] = FileEntry{ fileSize, modifiedTime, result };
+    }
+
+    if (++insertsSincePrune_ >= kPruneInterval)
+    {
+        PruneExpired();
+    }
+    return result;
+}
+
+SamplePool::Stats SamplePool::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Stats stats;
+    for (const auto& entry : contents_)
+    {
+        std::shared_ptr<const SampleBuffer> buffer = entry.second.lock();
+        if (buffer)
+        {
+            ++stats.liveBuffers;
+            stats.liveBytes += buffer->GetSizeBytes();
+        }
+    }
+    stats.fileHits = fileHits_;
+    stats.contentHits = contentHits_;
+    stats.bytesShared = bytesShared_;
+    return stats;
+}
+
+bool SamplePool::GetFileIdentity(const std::string& filePath, uint64_t& fileSize, int64_t& modifiedTime)
+{
+    std::error_code error;
+    fileSize = std::filesystem::file_size(filePath, error);
+    if (error)
+    {
+        return false;
+    }
+    auto writeTime = std::filesystem::last_write_time(filePath, error);
+    if (error)
+    {
+        return false;
+    }
+    modifiedTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+    return true;
+}
+
+bool SamplePool::IsStorageAllowed(SampleBuffer::Storage storage, uint16_t bitsPerSample, bool allowCompact)
+{
+    if (storage != SampleBuffer::STORAGE_FLOAT32)
+    {
+        return allowCompact;
+    }
+    return !allowCompact || (bitsPerSample != 16 && bitsPerSample != 24);
+}
+
+void SamplePool::PruneExpired()
+{
+    insertsSincePrune_ = 0;
+
+    for (auto it = contents_.begin(); it != contents_.end(); )
+    {
+        it = it->second.expired() ? contents_.erase(it) : std::next(it);
+    }
+    for (std::unordered_map<std::string, FileEntry>& files : files_)
+    {
+        for (auto it = files.begin(); it != files.end(); )
+        {
+            it = it->second.buffer.expired() ? files.erase(it) : std::next(it);
+        }
+    }
+}
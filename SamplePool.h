@@ -0,0 +1,66 @@
+#pragma once
+
+#include "SampleBuffer.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+// Sample Pool - process-wide registry of decoded sample buffers. Buffers are found by
+// source file (path, size, modification time and storage) or by content hash, so loading the
+// same sample on many tracks or channels shares one allocation. The pool only holds
+// weak references; a buffer is freed when its last user lets go of it.
+class SamplePool
+{
+public:
+    struct Stats
+    {
+        uint32_t liveBuffers = 0;
+        uint64_t liveBytes = 0;
+        uint64_t fileHits = 0;     // Loads answered without decoding
+        uint64_t contentHits = 0;  // Decoded buffers that turned out to duplicate a live one
+        uint64_t bytesShared = 0;  // Allocations avoided by the hits above
+    };
+
+    static SamplePool& GetShared();
+
+    // Buffer decoded earlier from filePath, if the file has not changed since. Compact
+    // storage is only returned when allowCompact is set, and then in preference to float.
+    std::shared_ptr<const SampleBuffer> FindFile(const std::string& filePath, bool allowCompact);
+
+    // Seal a freshly decoded buffer and return a live one with identical content if
+    // there is one, otherwise the buffer itself. A non-empty filePath registers the
+    // result for FindFile.
+    std::shared_ptr<const SampleBuffer> Intern(std::unique_ptr<SampleBuffer> buffer,
+                                               const std::string& filePath = std::string());
+
+    Stats GetStats() const;
+
+    // Size and modification time that identify one version of a file on disk
+    static bool GetFileIdentity(const std::string& filePath, uint64_t& fileSize, int64_t& modifiedTime);
+
+    // Whether a buffer decoded from a bitsPerSample source into storage can answer a load.
+    // Float only answers a compact load when the source has no compact storage (8-bit, float).
+    static bool IsStorageAllowed(SampleBuffer::Storage storage, uint16_t bitsPerSample, bool allowCompact);
+
+private:
+    struct FileEntry
+    {
+        uint64_t fileSize;
+        int64_t modifiedTime;
+        std::weak_ptr<const SampleBuffer> buffer;
+    };
+
+    static const int kNumStorages = SampleBuffer::STORAGE_INT24 + 1;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, FileEntry> files_[kNumStorages]; // By storage - loads of one file may differ
+    std::unordered_multimap<uint64_t, std::weak_ptr<const SampleBuffer>> contents_;
+    uint64_t fileHits_ = 0;
+    uint64_t contentHits_ = 0;
+    uint64_t bytesShared_ = 0;
+    size_t insertsSincePrune_ = 0;
+
+    void PruneExpired();
+};
@@ -2,7 +2,7 @@
 
 SequencerChannel::SequencerChannel(uint32_t channelId, const std::string& name, ChannelType type)
     : channelId_(channelId), channelName_(name), channelType_(type),
-   volume_(1.0f), pan_(0.0f), muted_(false), solo_(false)
+   volume_(1.0f), pan_(0.0f), mixGain_(1.0f), mixed_(false), muted_(false), solo_(false)
 {
 }
 
@@ -58,40 +58,40 @@ void SequencerChannel::RemoveAudioPlayer()
 
 void SequencerChannel::SetVolume(float volume)
 {
-    volume_ = volume > 1.0f ? 1.0f : (volume < 0.0f ? 0.0f : volume);
+    volume_.Set(volume > 1.0f ? 1.0f : (volume < 0.0f ? 0.0f : volume));
 }
 
 float SequencerChannel::GetVolume() const
 {
-    return volume_;
+    return volume_.GetTarget();
 }
 
 void SequencerChannel::SetPan(float pan)
 {
-    pan_ = pan > 1.0f ? 1.0f : (pan < -1.0f ? -1.0f : pan);
+    pan_.Set(pan > 1.0f ? 1.0f : (pan < -1.0f ? -1.0f : pan));
 }
 
 float SequencerChannel::GetPan() const
 {
-    return pan_;
+    return pan_.GetTarget();
 }
 
 void SequencerChannel::SetMuted(bool muted)
 {
-    muted_ = muted;
+    muted_.store(muted, std::memory_order_relaxed);
 }
 
 bool SequencerChannel::IsMuted() const
 {
-    return muted_;
+    return muted_.load(std::memory_order_relaxed);
 }
 
 void SequencerChannel::SetSolo(bool solo)
 {
-    solo_ = solo;
+    solo_.store(solo, std::memory_order_relaxed);
 }
 
 bool SequencerChannel::IsSolo() const
 {
-    return solo_;
+    return solo_.load(std::memory_order_relaxed);
 }
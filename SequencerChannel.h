@@ -1,7 +1,9 @@
 #pragma once
 
 #include "AudioPlayer.h"
+#include "SmoothedParameter.h"
 #include <memory>
+#include <atomic>
 
 // Sequencer Channel - Represents a track/channel in the DAW
 class SequencerChannel
@@ -29,7 +31,7 @@ SequencerChannel(uint32_t channelId, const std::string& name, ChannelType type =
     bool HasAudioPlayer() const;
     void RemoveAudioPlayer();
 
-    // Channel properties
+    // Channel properties - safe to set from the UI while the mix engine renders the channel
     void SetVolume(float volume);
     float GetVolume() const;
 
@@ -42,13 +44,22 @@ SequencerChannel(uint32_t channelId, const std::string& name, ChannelType type =
     void SetSolo(bool solo);
     bool IsSolo() const;
 
+    // Render side of volume and pan, and the mix engine's own fade for mute, solo and player volume
+    SmoothedParameter& GetVolumeParameter() { return volume_; }
+    SmoothedParameter& GetPanParameter() { return pan_; }
+    SmoothedParameter& GetMixGain() { return mixGain_; }
+    bool IsMixed() const { return mixed_; }   // Whether the mix engine has rendered the channel yet
+    void SetMixed() { mixed_ = true; }
+
 private:
     uint32_t channelId_;
     std::string channelName_;
     ChannelType channelType_;
     std::shared_ptr<AudioPlayer> audioPlayer_;
-    float volume_;
-    float pan_;
-    bool muted_;
-    bool solo_;
+    SmoothedParameter volume_;
+    SmoothedParameter pan_;
+    SmoothedParameter mixGain_; // Set and read by the mix engine only
+    bool mixed_;                // Render thread only
+    std::atomic<bool> muted_;
+    std::atomic<bool> solo_;
 };
@@ -0,0 +1,78 @@
+#include "SmoothedParameter.h"
+
+SmoothedParameter::SmoothedParameter(float value, uint32_t rampFrames)
+    : target_(value)
+    , current_(value)
+    , rampTarget_(value)
+    , step_(0.0f)
+    , remaining_(0)
+    , rampFrames_(rampFrames)
+{
+}
+
+void SmoothedParameter::Snap()
+{
+    rampTarget_ = target_.load(std::memory_order_relaxed);
+    current_ = rampTarget_;
+    remaining_ = 0;
+}
+
+bool SmoothedParameter::Follow()
+{
+    const float target = target_.load(std::memory_order_relaxed);
+    if (target == rampTarget_)
+    {
+        return remaining_ > 0;
+    }
+
+    // A change mid-ramp starts a full-length ramp from the value reached so far
+    rampTarget_ = target;
+    if (rampFrames_ == 0)
+    {
+        current_ = target;
+        remaining_ = 0;
+        return false;
+    }
+    step_ = (target - current_) / rampFrames_;
+    remaining_ = rampFrames_;
+    return true;
+}
+
+void SmoothedParameter::Advance(uint32_t numFrames, float& start, float& end)
+{
+    Follow();
+    start = current_;
+    if (remaining_ > numFrames)
+    {
+        current_ += step_ * numFrames;
+        remaining_ -= numFrames;
+    }
+    else
+    {
+        current_ = rampTarget_; // Land exactly, whatever rounding the steps picked up
+        remaining_ = 0;
+    }
+    end = current_;
+}
+
+void SmoothedParameter::Fill(float* values, uint32_t numFrames)
+{
+    Follow();
+    uint32_t i = 0;
+    for (; i < numFrames && remaining_ > 0; ++i)
+    {
+        values[i] = current_;
+        if (--remaining_ == 0)
+        {
+            current_ = rampTarget_;
+        }
+        else
+        {
+            current_ += step_;
+        }
+    }
+    for (; i < numFrames; ++i)
+    {
+        values[i] = current_;
+    }
+}
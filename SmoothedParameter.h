@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Smoothed Parameter - a float the UI sets and the render thread reads without locks.
+// The target is one atomic float, so the render thread never waits and never sees a torn
+// value. Instead of stepping to each new target, the render thread ramps linearly from
+// wherever it is over the ramp time, so gain and pan changes do not click.
+// Set() and GetTarget() may be called from any thread; the rest belongs to the one thread
+// that renders the parameter.
+class SmoothedParameter
+{
+public:
+    static constexpr uint32_t kDefaultRampFrames = 1024; // About 23 ms at 44.1 kHz
+
+    explicit SmoothedParameter(float value = 0.0f, uint32_t rampFrames = kDefaultRampFrames);
+
+    SmoothedParameter(const SmoothedParameter&) = delete;
+    SmoothedParameter& operator=(const SmoothedParameter&) = delete;
+
+    void Set(float value) { target_.store(value, std::memory_order_relaxed); }
+    float GetTarget() const { return target_.load(std::memory_order_relaxed); }
+
+    // Render thread
+    float GetCurrent() const { return current_; }
+    bool IsSmoothing() const { return remaining_ > 0; }
+    void Snap(); // Jump to the target, e.g. before the first block
+    bool Follow(); // Start a ramp if the target moved; true while one is running
+
+    // Per block: advance numFrames, reporting the values at the first frame and just past the last.
+    // Interpolating linearly between them is exact while a ramp spans the whole block.
+    void Advance(uint32_t numFrames, float& start, float& end);
+
+    // Per sample: write the value at each of numFrames frames and advance
+    void Fill(float* values, uint32_t numFrames);
+
+private:
+    std::atomic<float> target_;
+    float current_;
+    float rampTarget_;  // Target the current ramp heads for
+    float step_;        // Per frame
+    uint32_t remaining_;
+    uint32_t rampFrames_;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+// Fixed-capacity wait-free queue between one producer thread and one consumer thread.
+// Neither side ever blocks or allocates: TryPush() fails when the queue is full and TryPop()
+// when it is empty. T should be cheap to copy - a few words, no owning members.
+template <typename T>
+class SpscQueue
+{
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(uint32_t capacity)
+        : writeIndex_(0)
+        , readIndex_(0)
+    {
+        uint32_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    uint32_t GetCapacity() const { return mask_ + 1; }
+
+    // Either side - a snapshot that may be stale by the time it is used
+    uint32_t GetSize() const
+    {
+        return static_cast<uint32_t>(writeIndex_.load(std::memory_order_acquire) -
+                                     readIndex_.load(std::memory_order_acquire));
+    }
+    bool IsFull() const { return GetSize() > mask_; }
+
+    // Producer side
+    bool TryPush(const T& item)
+    {
+        const uint64_t write = writeIndex_.load(std::memory_order_relaxed);
+        if (write - readIndex_.load(std::memory_order_acquire) > mask_)
+        {
+            return false;
+        }
+        slots_[write & mask_] = item;
+        writeIndex_.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool TryPop(T& item)
+    {
+        const uint64_t read = readIndex_.load(std::memory_order_relaxed);
+        if (read == writeIndex_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = slots_[read & mask_];
+        readIndex_.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> slots_;
+    uint32_t mask_;
+
+    // Monotonic counters - the slot is index & mask_. Kept on separate cache lines so the
+    // producer and consumer do not invalidate each other on every operation.
+    alignas(64) std::atomic<uint64_t> writeIndex_;
+    alignas(64) std::atomic<uint64_t> readIndex_;
+};
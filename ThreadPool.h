@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <cstdint>
+
+// Thread Pool - fixed set of worker threads for decode and analysis jobs
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t numThreads = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool used by the loaders
+    static ThreadPool& GetShared();
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+    // Queue a task and get a future for its result
+    template <typename Func>
+    auto Submit(Func&& func) -> std::future<decltype(func())>
+    {
+        typedef decltype(func()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+        std::future<Result> result = task->get_future();
+        Enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    void Enqueue(std::function<void()> task);
+
+    // Run body(i) for every i in [0, count) and wait. The calling thread takes
+    // indices too, so ParallelFor from inside a pool task cannot deadlock.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable taskAvailable_;
+    bool stopping_;
+
+    void WorkerMain();
+};
@@ -0,0 +1,171 @@
+#include "WavWriter.h"
+#include "AudioTrack.h"
+#include <cstring>
+#include <cstdio>
+
+// RIFF header, fmt chunk and data chunk header
+static const uint32_t kHeaderBytes = sizeof(WAVHeader) + sizeof(WAVChunkHeader) + sizeof(WAVFormat) + sizeof(WAVChunkHeader);
+static const uint64_t kMaxDataBytes = 0xFFFFFFFFull - kHeaderBytes;
+
+static uint16_t GetBytesPerSample(WavWriter::SampleFormat format)
+{
+    return format == WavWriter::FORMAT_PCM16 ? 2 : (format == WavWriter::FORMAT_PCM24 ? 3 : 4);
+}
+
+// Round to nearest and clip, so overs saturate instead of wrapping
+static int32_t ToPCM(float sample, float scale, int32_t maxValue)
+{
+    float value = sample * scale;
+    value = value >= 0.0f ? value + 0.5f : value - 0.5f;
+    if (value >= static_cast<float>(maxValue))
+    {
+        return maxValue;
+    }
+    if (value <= static_cast<float>(-maxValue - 1))
+    {
+        return -maxValue - 1;
+    }
+    return static_cast<int32_t>(value);
+}
+
+WavWriter::WavWriter()
+    : format_(FORMAT_FLOAT32)
+    , channels_(0)
+    , framesWritten_(0)
+    , failed_(false)
+{
+}
+
+WavWriter::~WavWriter()
+{
+    Close();
+}
+
+bool WavWriter::Open(const std::string& filePath, uint32_t sampleRate, uint16_t channels, SampleFormat format)
+{
+    Close();
+    if (channels == 0 || sampleRate == 0)
+    {
+        return false;
+    }
+
+    file_.open(filePath, std::ios::binary | std::ios::trunc);
+    if (!file_)
+    {
+        printf("WAV writer: could not create %s\n", filePath.c_str());
+        return false;
+    }
+
+    filePath_ = filePath;
+    format_ = format;
+    channels_ = channels;
+    framesWritten_ = 0;
+    failed_ = false;
+
+    // Sizes are written as zero and patched by Close()
+    const uint16_t bytesPerSample = GetBytesPerSample(format);
+    WAVHeader header;
+    memcpy(header.riff, "RIFF", 4);
+    header.fileSize = 0;
+    memcpy(header.wave, "WAVE", 4);
+
+    WAVChunkHeader formatChunk;
+    memcpy(formatChunk.id, "fmt ", 4);
+    formatChunk.size = sizeof(WAVFormat);
+
+    WAVFormat waveFormat;
+    waveFormat.audioFormat = format == FORMAT_FLOAT32 ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    waveFormat.numChannels = channels;
+    waveFormat.sampleRate = sampleRate;
+    waveFormat.blockAlign = static_cast<uint16_t>(channels * bytesPerSample);
+    waveFormat.byteRate = sampleRate * waveFormat.blockAlign;
+    waveFormat.bitsPerSample = static_cast<uint16_t>(bytesPerSample * 8);
+
+    WAVChunkHeader dataChunk;
+    memcpy(dataChunk.id, "data", 4);
+    dataChunk.size = 0;
+
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_.write(reinterpret_cast<const char*>(&formatChunk), sizeof(formatChunk));
+    file_.write(reinterpret_cast<const char*>(&waveFormat), sizeof(waveFormat));
+    file_.write(reinterpret_cast<const char*>(&dataChunk), sizeof(dataChunk));
+    failed_ = !file_;
+    return !failed_;
+}
+
+bool WavWriter::Write(const float* frames, uint32_t numFrames)
+{
+    if (!file_.is_open() || failed_)
+    {
+        return false;
+    }
+
+    const uint16_t bytesPerSample = GetBytesPerSample(format_);
+    const size_t numSamples = static_cast<size_t>(numFrames) * channels_;
+    const uint64_t frameBytes = static_cast<uint64_t>(channels_) * bytesPerSample;
+    if ((framesWritten_ + numFrames) * frameBytes > kMaxDataBytes)
+    {
+        failed_ = true;
+        return false;
+    }
+
+    if (format_ == FORMAT_FLOAT32)
+    {
+        file_.write(reinterpret_cast<const char*>(frames), static_cast<std::streamsize>(numSamples * sizeof(float)));
+    }
+    else
+    {
+        packed_.resize(numSamples * bytesPerSample);
+        uint8_t* dest = packed_.data();
+        if (format_ == FORMAT_PCM16)
+        {
+            for (size_t i = 0; i < numSamples; ++i, dest += 2)
+            {
+                int32_t value = ToPCM(frames[i], 32768.0f, 32767);
+                dest[0] = static_cast<uint8_t>(value);
+                dest[1] = static_cast<uint8_t>(value >> 8);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < numSamples; ++i, dest += 3)
+            {
+                int32_t value = ToPCM(frames[i], 8388608.0f, 8388607);
+                dest[0] = static_cast<uint8_t>(value);
+                dest[1] = static_cast<uint8_t>(value >> 8);
+                dest[2] = static_cast<uint8_t>(value >> 16);
+            }
+        }
+        file_.write(reinterpret_cast<const char*>(packed_.data()), static_cast<std::streamsize>(packed_.size()));
+    }
+
+    failed_ = !file_;
+    if (!failed_)
+    {
+        framesWritten_ += numFrames;
+    }
+    return !failed_;
+}
+
+bool WavWriter::Close()
+{
+    if (!file_.is_open())
+    {
+        return false;
+    }
+
+    const uint32_t dataBytes = static_cast<uint32_t>(framesWritten_ * channels_ * GetBytesPerSample(format_));
+    const uint32_t riffSize = kHeaderBytes - 8 + dataBytes;
+    file_.seekp(4);
+    file_.write(reinterpret_cast<const char*>(&riffSize), sizeof(riffSize));
+    file_.seekp(kHeaderBytes - sizeof(uint32_t));
+    file_.write(reinterpret_cast<const char*>(&dataBytes), sizeof(dataBytes));
+    file_.close();
+
+    bool ok = !failed_ && !file_.fail();
+    if (!ok)
+    {
+        printf("WAV writer: could not finish %s\n", filePath_.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+// WAV Writer - streams interleaved float frames [-1.0, 1.0] into a WAV file as 16/24-bit PCM
+// or 32-bit float. The header's sizes are patched in when the file is closed.
+class WavWriter
+{
+public:
+    enum SampleFormat
+    {
+        FORMAT_PCM16,
+        FORMAT_PCM24,
+        FORMAT_FLOAT32
+    };
+
+    WavWriter();
+    ~WavWriter(); // Closes the file
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    bool Open(const std::string& filePath, uint32_t sampleRate, uint16_t channels, SampleFormat format = FORMAT_FLOAT32);
+    bool IsOpen() const { return file_.is_open(); }
+
+    // Append numFrames frames. Fails once the data chunk would pass the 4 GB RIFF limit.
+    bool Write(const float* frames, uint32_t numFrames);
+
+    // Patch the header and close; false if anything failed to reach the file
+    bool Close();
+
+    uint64_t GetFramesWritten() const { return framesWritten_; }
+    uint16_t GetNumChannels() const { return channels_; }
+
+private:
+    std::ofstream file_;
+    std::string filePath_;
+    SampleFormat format_;
+    uint16_t channels_;
+    uint64_t framesWritten_;
+    bool failed_;
+    std::vector<uint8_t> packed_; // Converted frames on their way to the file
+};
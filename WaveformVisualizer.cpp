@@ -1,9 +1,12 @@
 #include "WaveformVisualizer.h"
+#include "AudioAnalysis.h"
+#include "PeakPyramid.h"
 #include <algorithm>
 #include <cmath>
 
 WaveformVisualizer::WaveformVisualizer()
-    : zoomLevel_(1.0f), stereoDisplay_(true)
+    : zoomLevel_(1.0f), scrollPosition_(0), displayMode_(DISPLAY_CHANNELS), cacheKey_{ 0, 0.0f, 0, DISPLAY_MIXED },
+      cacheValid_(false)
 {
 }
 
@@ -14,54 +17,72 @@ WaveformVisualizer::~WaveformVisualizer()
 void WaveformVisualizer::SetAudioData(const AudioData& audioData)
 {
     audioData_ = audioData;
+    midSidePeaks_.reset();
+    cacheValid_ = false;
     CalculatePeakAmplitudes();
 }
 
 void WaveformVisualizer::ClearAudioData()
 {
-    audioData_.samples.clear();
+    audioData_.buffer.reset();
+    peaks_.reset();
+    midSidePeaks_.reset();
     waveformCache_.clear();
+    cacheValid_ = false;
 }
 
-std::vector<WaveformVisualizer::WaveformPoint> WaveformVisualizer::GenerateWaveformPoints(
+const std::vector<WaveformVisualizer::WaveformPoint>& WaveformVisualizer::GenerateWaveformPoints(
     uint32_t pixelWidth, uint32_t pixelHeight)
 {
+    if (cacheValid_ && cacheKey_.pixelWidth == pixelWidth && cacheKey_.zoomLevel == zoomLevel_ &&
+        cacheKey_.scrollPosition == scrollPosition_ && cacheKey_.displayMode == displayMode_)
+    {
+        return waveformCache_;
+    }
+
     waveformCache_.clear();
+    cacheKey_ = CacheKey{ pixelWidth, zoomLevel_, scrollPosition_, displayMode_ };
+    cacheValid_ = true;
 
-    if (audioData_.samples.empty() || pixelWidth == 0)
+    if (audioData_.GetNumSamples() == 0 || pixelWidth == 0)
     {
         return waveformCache_;
     }
 
-    uint32_t samplesPerPixel = static_cast<uint32_t>(
-        audioData_.samples.size() / (pixelWidth * zoomLevel_));
-    
-    if (samplesPerPixel == 0)
+    // Visible range - zoom 1 shows the whole file, scrolling moves its start
+    const uint32_t numFrames = audioData_.GetNumFrames();
+    const uint32_t startFrame = std::min(scrollPosition_, numFrames);
+    const uint64_t visibleFrames = std::max<uint64_t>(1, static_cast<uint64_t>(std::llround(static_cast<double>(numFrames) / zoomLevel_)));
+    const uint32_t endFrame = static_cast<uint32_t>(std::min<uint64_t>(startFrame + visibleFrames, UINT32_MAX));
+
+    // Mid/side has its own pyramid - its extremes cannot be derived from those of left and right
+    const uint16_t numLanes = GetNumLanes();
+    const bool midSide = displayMode_ == DISPLAY_MID_SIDE && numLanes == 2;
+    if (midSide && !midSidePeaks_)
     {
-        samplesPerPixel = 1;
+        midSidePeaks_ = PeakPyramid::Build(*audioData_.buffer, PeakPyramid::SOURCE_MID_SIDE);
     }
-
-    for (uint32_t x = 0; x < pixelWidth; ++x)
+    const PeakPyramid& peaks = midSide ? *midSidePeaks_ : *peaks_;
+
+    // Bins with fractional edges, from the pyramid plus the few samples at each bin edge.
+    // A lane costs the same as the mixed view, which reduces every channel too.
+    std::vector<float> minValues(pixelWidth);
+    std::vector<float> maxValues(pixelWidth);
+    waveformCache_.resize(static_cast<size_t>(pixelWidth) * numLanes);
+    for (uint16_t lane = 0; lane < numLanes; ++lane)
     {
-        uint32_t sampleStart = x * samplesPerPixel;
-        uint32_t sampleEnd = std::min(sampleStart + samplesPerPixel,
-      static_cast<uint32_t>(audioData_.samples.size()));
+        uint32_t channelMask = displayMode_ == DISPLAY_MIXED ? PeakPyramid::kAllChannels : 1u << lane;
+        peaks.GetRangePeaks(audioData_.buffer.get(), startFrame, endFrame, pixelWidth, channelMask,
+                            minValues.data(), maxValues.data());
 
-        float minAmplitude = 0.0f;
-     float maxAmplitude = 0.0f;
-
-        for (uint32_t i = sampleStart; i < sampleEnd; ++i)
+        WaveformPoint* points = waveformCache_.data() + static_cast<size_t>(lane) * pixelWidth;
+        for (uint32_t x = 0; x < pixelWidth; ++x)
         {
-     float sample = audioData_.samples[i];
-        minAmplitude = std::min(minAmplitude, sample);
-    maxAmplitude = std::max(maxAmplitude, sample);
+            points[x].x = static_cast<float>(x);
+            points[x].minAmplitude = minValues[x];
+            points[x].maxAmplitude = maxValues[x];
+            points[x].lane = lane;
         }
-
-     WaveformPoint point;
-        point.x = static_cast<float>(x);
-        point.minAmplitude = minAmplitude;
-        point.maxAmplitude = maxAmplitude;
-      waveformCache_.push_back(point);
     }
 
     return waveformCache_;
@@ -69,17 +90,30 @@ std::vector<WaveformVisualizer::WaveformPoint> WaveformVisualizer::GenerateWavef
 
 float WaveformVisualizer::GetPeakAmplitude() const
 {
-    float peak = 0.0f;
-    for (float sample : audioData_.samples)
+    if (!audioData_.buffer)
     {
-        peak = std::max(peak, std::abs(sample));
-}
-    return peak;
+        return 0.0f;
+    }
+    const std::shared_ptr<const AudioAnalysis>& analysis = audioData_.buffer->GetAnalysis();
+    if (analysis)
+    {
+        return analysis->peak;
+    }
+    return peaks_ ? peaks_->GetStatistics().peak : 0.0f;
 }
 
 float WaveformVisualizer::GetRMSAmplitude() const
 {
-    return CalculateRMS(audioData_.samples);
+    if (!audioData_.buffer)
+    {
+        return 0.0f;
+    }
+    const std::shared_ptr<const AudioAnalysis>& analysis = audioData_.buffer->GetAnalysis();
+    if (analysis)
+    {
+        return analysis->rms;
+    }
+    return peaks_ ? peaks_->GetStatistics().rms : 0.0f;
 }
 
 void WaveformVisualizer::SetZoomLevel(float zoomFactor)
@@ -95,34 +129,51 @@ float WaveformVisualizer::GetZoomLevel() const
     return zoomLevel_;
 }
 
-void WaveformVisualizer::SetDisplayMode(bool stereo)
+void WaveformVisualizer::SetScrollPosition(uint32_t startFrame)
 {
-    stereoDisplay_ = stereo;
+    scrollPosition_ = startFrame;
 }
 
-bool WaveformVisualizer::GetDisplayMode() const
+uint32_t WaveformVisualizer::GetScrollPosition() const
 {
-    return stereoDisplay_;
+    return scrollPosition_;
 }
 
-void WaveformVisualizer::CalculatePeakAmplitudes()
+void WaveformVisualizer::SetDisplayMode(DisplayMode mode)
+{
+    displayMode_ = mode;
+}
+
+WaveformVisualizer::DisplayMode WaveformVisualizer::GetDisplayMode() const
 {
-    // This method could cache peak values per pixel range
-    // for faster rendering in future calls
+    return displayMode_;
 }
 
-float WaveformVisualizer::CalculateRMS(const std::vector<float>& samples) const
+uint16_t WaveformVisualizer::GetNumLanes() const
 {
-    if (samples.empty())
+    const uint16_t channels = audioData_.buffer ? audioData_.buffer->GetNumChannels() : 0;
+    switch (displayMode_)
     {
-        return 0.0f;
+    case DISPLAY_CHANNELS: return channels > 0 ? channels : 1;
+    case DISPLAY_MID_SIDE: return channels >= 2 ? 2 : 1;
+    default: return 1;
     }
+}
 
-    float sumSquares = 0.0f;
-    for (float sample : samples)
-  {
-        sumSquares += sample * sample;
+void WaveformVisualizer::CalculatePeakAmplitudes()
+{
+    peaks_.reset();
+    if (!audioData_.buffer || audioData_.GetNumSamples() == 0)
+    {
+        return;
     }
 
-    return std::sqrt(sumSquares / samples.size());
+    // Buffers from the loader carry their pyramid; anything else gets one built here, once
+    const std::shared_ptr<const AudioAnalysis>& analysis = audioData_.buffer->GetAnalysis();
+    if (analysis && analysis->peaks && analysis->peaks->IsComplete())
+    {
+        peaks_ = analysis->peaks;
+        return;
+    }
+    peaks_ = PeakPyramid::Build(*audioData_.buffer);
 }
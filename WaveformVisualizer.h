@@ -2,6 +2,9 @@
 
 #include "AudioPlayer.h"
 #include <vector>
+#include <memory>
+
+class PeakPyramid;
 
 // Waveform Visualizer - Displays audio waveforms
 class WaveformVisualizer
@@ -12,6 +15,14 @@ public:
 float x;
      float minAmplitude;
   float maxAmplitude;
+        uint16_t lane;      // Channel, mid (0) / side (1), or 0 for the mixed view
+    };
+
+    enum DisplayMode
+    {
+        DISPLAY_MIXED,      // One lane, the envelope of every channel
+        DISPLAY_CHANNELS,   // One lane per channel
+        DISPLAY_MID_SIDE    // Mid and side lanes of the first two channels; mixed for mono
     };
 
     WaveformVisualizer();
@@ -21,10 +32,12 @@ float x;
     void SetAudioData(const AudioData& audioData);
     void ClearAudioData();
 
-    // Generate waveform points for rendering
-    std::vector<WaveformPoint> GenerateWaveformPoints(uint32_t pixelWidth, uint32_t pixelHeight);
+    // Waveform points for rendering, one per pixel of the visible range and lane, lane by lane.
+    // Served from a cache that is only rebuilt when the audio, width, zoom, scroll position or
+    // display mode changes; the reference stays valid until the next call or change of audio.
+    const std::vector<WaveformPoint>& GenerateWaveformPoints(uint32_t pixelWidth, uint32_t pixelHeight);
 
-    // Waveform statistics
+    // Waveform statistics, from the buffer's analysis or the top of the peak pyramid - no sample pass
     float GetPeakAmplitude() const;
   float GetRMSAmplitude() const;
    
@@ -32,16 +45,33 @@ float x;
     void SetZoomLevel(float zoomFactor);
     float GetZoomLevel() const;
 
-    void SetDisplayMode(bool stereo); // true for stereo view, false for mono
-    bool GetDisplayMode() const;
+    void SetScrollPosition(uint32_t startFrame); // First visible frame
+    uint32_t GetScrollPosition() const;
+
+    void SetDisplayMode(DisplayMode mode);
+    DisplayMode GetDisplayMode() const;
+    uint16_t GetNumLanes() const; // Lanes GenerateWaveformPoints() returns for the current audio and mode
 
 private:
     AudioData audioData_;
+    std::shared_ptr<const PeakPyramid> peaks_;         // Of audioData_, from its analysis or built for it
+    std::shared_ptr<const PeakPyramid> midSidePeaks_;  // Built the first time DISPLAY_MID_SIDE is drawn
     std::vector<WaveformPoint> waveformCache_;
     float zoomLevel_;
-    bool stereoDisplay_;
+    uint32_t scrollPosition_;
+    DisplayMode displayMode_;
+
+    // View waveformCache_ was built for
+    struct CacheKey
+    {
+        uint32_t pixelWidth;
+        float zoomLevel;
+        uint32_t scrollPosition;
+        DisplayMode displayMode;
+    };
+    CacheKey cacheKey_;
+    bool cacheValid_;
 
     // Helper functions
     void CalculatePeakAmplitudes();
-    float CalculateRMS(const std::vector<float>& samples) const;
 };